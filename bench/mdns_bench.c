@@ -0,0 +1,246 @@
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "hostdb.h"
+#include "mdns.h"
+#include "wire.h"
+
+// Microbenchmarks for the packet parse/build hot paths and service lookup.
+// Linked with -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc so every heap
+// allocation made by the measured code is counted.
+
+#define BENCH_MIN_NS 200000000ull  // run each case for at least 0.2 s
+
+static unsigned long long g_allocs = 0;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size) {
+    g_allocs++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+    g_allocs++;
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    g_allocs++;
+    return __real_realloc(ptr, size);
+}
+
+typedef int (*bench_fn)(void *arg);
+
+// Results are folded in here so the compiler cannot drop the measured calls
+static volatile int g_sink;
+
+static unsigned long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ull + (unsigned long long)ts.tv_nsec;
+}
+
+// Doubles the batch size until one batch takes BENCH_MIN_NS, then reports it
+static void run_bench(const char *name, bench_fn fn, void *arg) {
+    unsigned long long iterations = 1;
+
+    for (;;) {
+        unsigned long long allocs_before = g_allocs;
+        unsigned long long start = now_ns();
+        unsigned long long elapsed;
+        int sink = 0;
+
+        for (unsigned long long i = 0; i < iterations; i++) {
+            sink += fn(arg);
+        }
+        elapsed = now_ns() - start;
+        g_sink = sink;
+
+        if (elapsed >= BENCH_MIN_NS || iterations >= (1ull << 40)) {
+            printf("%-40s %12llu %12.1f %12.2f\n", name, iterations,
+                   (double)elapsed / (double)iterations,
+                   (double)(g_allocs - allocs_before) / (double)iterations);
+            return;
+        }
+        iterations *= 2;
+    }
+}
+
+typedef struct {
+    uint8_t packet[MDNS_MAX_PACKET];
+    size_t packet_len;
+    dns_question_t question;
+    host_record_t record;
+    mdns_service_t *service;
+    const char *name;
+    const char *service_type;
+} bench_ctx_t;
+
+static int bench_parse_query(void *arg) {
+    bench_ctx_t *ctx = arg;
+    dns_question_t question;
+    return mdns_parse_query(ctx->packet, ctx->packet_len, &question);
+}
+
+static int bench_build_response(void *arg) {
+    bench_ctx_t *ctx = arg;
+    uint8_t out[MDNS_MAX_PACKET];
+    return mdns_build_response(out, sizeof(out), &ctx->question, &ctx->record);
+}
+
+static int bench_build_service_response(void *arg) {
+    bench_ctx_t *ctx = arg;
+    uint8_t out[MDNS_MAX_PACKET];
+    return mdns_build_service_response(out, sizeof(out), &ctx->question, &ctx->service, 1);
+}
+
+static int bench_encode_name(void *arg) {
+    bench_ctx_t *ctx = arg;
+    uint8_t out[256];
+    size_t written = 0;
+    wire_encode_name(ctx->name, out, sizeof(out), &written);
+    return (int)written;
+}
+
+static int bench_find_by_fqdn(void *arg) {
+    bench_ctx_t *ctx = arg;
+    return mdns_find_service_by_fqdn(ctx->name) != NULL;
+}
+
+static int bench_find_by_type(void *arg) {
+    bench_ctx_t *ctx = arg;
+    mdns_service_t *found[16];
+    return (int)mdns_find_services_by_type(ctx->service_type, "local", found, 16);
+}
+
+static int register_services(size_t count) {
+    char instance[64];
+    mdns_service_t svc;
+
+    memset(&svc, 0, sizeof(svc));
+    svc.instance = instance;
+    svc.domain = "local";
+    svc.target_host = "bench.local";
+    svc.port = 8080;
+
+    for (size_t i = 0; i < count; i++) {
+        snprintf(instance, sizeof(instance), "Service %zu", i);
+        // Only the last 8 are _http._tcp, so a type lookup scans the whole list
+        svc.service_type = (i + 8 >= count) ? "_http._tcp" : "_other._tcp";
+        if (mdns_register_service(&svc) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// BENCH_MAX_SERVICES caps the registry sizes measured, as a quadratic
+// registration path can make the largest one impractical
+static int scale_enabled(size_t count) {
+    const char *max = getenv("BENCH_MAX_SERVICES");
+
+    return max == NULL || *max == '\0' || count <= strtoull(max, NULL, 10);
+}
+
+static void bench_lookup_scale(size_t count) {
+    bench_ctx_t ctx;
+    char label[64];
+    char fqdn[128];
+    unsigned long long allocs_before;
+    unsigned long long start;
+
+    if (!scale_enabled(count)) {
+        printf("service lookup (n=%zu) skipped by BENCH_MAX_SERVICES\n", count);
+        return;
+    }
+    mdns_cleanup_services();
+    allocs_before = g_allocs;
+    start = now_ns();
+    if (register_services(count) != 0) {
+        fprintf(stderr, "Failed to register %zu services\n", count);
+        exit(1);
+    }
+    snprintf(label, sizeof(label), "mdns_register_service (n=%zu)", count);
+    printf("%-40s %12zu %12.1f %12.2f\n", label, count, (double)(now_ns() - start) / (double)count,
+           (double)(g_allocs - allocs_before) / (double)count);
+
+    memset(&ctx, 0, sizeof(ctx));
+
+    // Last registered service: worst case for a linear scan
+    snprintf(fqdn, sizeof(fqdn), "Service %zu._http._tcp.local.", count - 1);
+    ctx.name = fqdn;
+    snprintf(label, sizeof(label), "find_service_by_fqdn (n=%zu)", count);
+    run_bench(label, bench_find_by_fqdn, &ctx);
+
+    ctx.service_type = "_http._tcp";
+    snprintf(label, sizeof(label), "find_services_by_type (n=%zu)", count);
+    run_bench(label, bench_find_by_type, &ctx);
+}
+
+int main(void) {
+    static const size_t scales[] = {10, 1000, 100000};
+    bench_ctx_t ctx;
+    dns_question_t query;
+    mdns_service_t service;
+    char *txt[] = {"path=/", "ver=1"};
+    int built;
+
+    memset(&ctx, 0, sizeof(ctx));
+    snprintf(ctx.record.hostname, sizeof(ctx.record.hostname), "bench.local");
+    inet_pton(AF_INET, "192.0.2.10", &ctx.record.ipv4);
+    ctx.record.has_ipv4 = 1;
+    inet_pton(AF_INET6, "2001:db8::10", &ctx.record.ipv6);
+    ctx.record.has_ipv6 = 1;
+    ctx.record.ttl = 120;
+
+    memset(&service, 0, sizeof(service));
+    service.instance = "My Web Server";
+    service.service_type = "_http._tcp";
+    service.domain = "local";
+    service.target_host = "bench.local";
+    service.port = 8080;
+    service.txt_kv = txt;
+    service.txt_kv_count = 2;
+    service.ttl = 120;
+    ctx.service = &service;
+
+    memset(&query, 0, sizeof(query));
+    snprintf(query.name, sizeof(query.name), "bench.local");
+    query.qtype = DNS_TYPE_A;
+    query.qclass = DNS_CLASS_IN;
+    built = mdns_build_query(ctx.packet, sizeof(ctx.packet), 0, &query, 1);
+    if (built < 0) {
+        fprintf(stderr, "Failed to build benchmark query\n");
+        return 1;
+    }
+    ctx.packet_len = (size_t)built;
+
+    printf("%-40s %12s %12s %12s\n", "benchmark", "iterations", "ns/op", "allocs/op");
+
+    run_bench("mdns_parse_query (A)", bench_parse_query, &ctx);
+
+    ctx.question = query;
+    run_bench("mdns_build_response (A)", bench_build_response, &ctx);
+    ctx.question.qtype = DNS_TYPE_ANY;
+    run_bench("mdns_build_response (ANY)", bench_build_response, &ctx);
+
+    snprintf(ctx.question.name, sizeof(ctx.question.name), "My Web Server._http._tcp.local");
+    ctx.question.qtype = DNS_TYPE_SRV;
+    run_bench("mdns_build_service_response (SRV)", bench_build_service_response, &ctx);
+
+    ctx.name = "My Web Server._http._tcp.local";
+    run_bench("wire_encode_name", bench_encode_name, &ctx);
+
+    for (size_t i = 0; i < sizeof(scales) / sizeof(scales[0]); i++) {
+        bench_lookup_scale(scales[i]);
+    }
+
+    mdns_cleanup_services();
+    return 0;
+}
@@ -0,0 +1,461 @@
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <getopt.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "mdns.h"
+#include "metrics.h"
+#include "wire.h"
+
+// Replays a query mix at a fixed rate against a responder and reports the
+// answered rate, loss and latency percentiles. Queries come from an
+// ephemeral port, so the server treats them as legacy unicast and echoes
+// each query ID, which is how responses are matched to queries.
+
+#define LOADGEN_DRAIN_MS 1000
+#define LOADGEN_MAX_KNOWN_ANSWERS 32
+
+enum {
+    MIX_A = 0,
+    MIX_AAAA,
+    MIX_SRV,
+    MIX_PTR,
+    MIX_COUNT
+};
+
+static const char *const mix_names[MIX_COUNT] = {"A", "AAAA", "SRV", "PTR"};
+static const uint16_t mix_qtypes[MIX_COUNT] = {DNS_TYPE_A, DNS_TYPE_AAAA, DNS_TYPE_SRV, DNS_TYPE_PTR};
+
+typedef struct {
+    const char *target;
+    const char *port;
+    double rate;
+    double duration;
+    unsigned mix[MIX_COUNT];
+    int questions;
+    int known_answers;
+    const char *host_name;
+    const char *srv_name;
+    const char *ptr_name;
+} loadgen_config_t;
+
+// In-flight queries are tracked by ID; an ID reused before its answer
+// arrived simply counts the earlier query as lost
+typedef struct {
+    uint64_t sent_ns;
+    uint8_t pending;
+} inflight_t;
+
+static inflight_t g_inflight[65536];
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void print_usage(const char *progname) {
+    fprintf(stderr,
+            "mDNS load generator - replay a query mix against a responder\n\n"
+            "Usage: %s [-t <addr>] [-p <port>] [-r <qps>] [-d <seconds>] [-m <mix>] [-q <n>] [-k <n>]\n"
+            "          [-H <hostname>] [-S <instance fqdn>] [-P <service type>]\n\n"
+            "Options:\n"
+            "  -t, --target         Responder IPv6 address, %%scope allowed (default: ::1)\n"
+            "  -p, --port           Responder port (default: 5353)\n"
+            "  -r, --rate           Queries per second (default: 1000)\n"
+            "  -d, --duration       Seconds to send for (default: 5)\n"
+            "  -m, --mix            Weighted qtype mix (default: A=4,AAAA=4,SRV=1,PTR=1)\n"
+            "  -q, --questions      Questions per query, QDCOUNT (default: 1)\n"
+            "  -k, --known-answers  Known-answer PTR records in queries with a PTR question (default: 0)\n"
+            "  -H, --host           Name for A/AAAA questions (default: <hostname>.local)\n"
+            "  -S, --srv            Name for SRV questions (default: My Web Server._http._tcp.local)\n"
+            "  -P, --ptr            Name for PTR questions (default: _http._tcp.local)\n"
+            "  -h, --help           Show this help\n",
+            progname);
+}
+
+static int parse_mix(const char *value, unsigned *mix) {
+    char buf[128];
+    char *saveptr = NULL;
+    unsigned total = 0;
+
+    if (strlen(value) >= sizeof(buf)) {
+        return -1;
+    }
+    strcpy(buf, value);
+    memset(mix, 0, sizeof(unsigned) * MIX_COUNT);
+
+    for (char *item = strtok_r(buf, ",", &saveptr); item != NULL; item = strtok_r(NULL, ",", &saveptr)) {
+        char *eq = strchr(item, '=');
+        int found = 0;
+
+        if (eq == NULL) {
+            return -1;
+        }
+        *eq = '\0';
+        for (int i = 0; i < MIX_COUNT; i++) {
+            if (strcasecmp(item, mix_names[i]) == 0) {
+                mix[i] = (unsigned)strtoul(eq + 1, NULL, 10);
+                total += mix[i];
+                found = 1;
+            }
+        }
+        if (!found) {
+            return -1;
+        }
+    }
+    return total > 0 ? 0 : -1;
+}
+
+static int parse_args(int argc, char **argv, loadgen_config_t *cfg) {
+    static struct option long_opts[] = {
+        {"target", required_argument, 0, 't'},
+        {"port", required_argument, 0, 'p'},
+        {"rate", required_argument, 0, 'r'},
+        {"duration", required_argument, 0, 'd'},
+        {"mix", required_argument, 0, 'm'},
+        {"questions", required_argument, 0, 'q'},
+        {"known-answers", required_argument, 0, 'k'},
+        {"host", required_argument, 0, 'H'},
+        {"srv", required_argument, 0, 'S'},
+        {"ptr", required_argument, 0, 'P'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+    int opt;
+
+    cfg->target = "::1";
+    cfg->port = "5353";
+    cfg->rate = 1000.0;
+    cfg->duration = 5.0;
+    parse_mix("A=4,AAAA=4,SRV=1,PTR=1", cfg->mix);
+    cfg->questions = 1;
+    cfg->known_answers = 0;
+    cfg->host_name = NULL;
+    cfg->srv_name = "My Web Server._http._tcp.local";
+    cfg->ptr_name = "_http._tcp.local";
+
+    while ((opt = getopt_long(argc, argv, "t:p:r:d:m:q:k:H:S:P:h", long_opts, NULL)) != -1) {
+        switch (opt) {
+            case 't':
+                cfg->target = optarg;
+                break;
+            case 'p':
+                cfg->port = optarg;
+                break;
+            case 'r':
+                cfg->rate = strtod(optarg, NULL);
+                break;
+            case 'd':
+                cfg->duration = strtod(optarg, NULL);
+                break;
+            case 'm':
+                if (parse_mix(optarg, cfg->mix) != 0) {
+                    fprintf(stderr, "Invalid mix: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'q':
+                cfg->questions = atoi(optarg);
+                break;
+            case 'k':
+                cfg->known_answers = atoi(optarg);
+                break;
+            case 'H':
+                cfg->host_name = optarg;
+                break;
+            case 'S':
+                cfg->srv_name = optarg;
+                break;
+            case 'P':
+                cfg->ptr_name = optarg;
+                break;
+            case 'h':
+                print_usage(argv[0]);
+                exit(0);
+            default:
+                return -1;
+        }
+    }
+
+    if (cfg->rate <= 0.0 || cfg->duration <= 0.0) {
+        fprintf(stderr, "Rate and duration must be positive\n");
+        return -1;
+    }
+    if (cfg->questions < 1 || cfg->questions > MDNS_MAX_QUESTIONS) {
+        fprintf(stderr, "Questions per query must be 1..%d\n", MDNS_MAX_QUESTIONS);
+        return -1;
+    }
+    if (cfg->known_answers < 0 || cfg->known_answers > LOADGEN_MAX_KNOWN_ANSWERS) {
+        fprintf(stderr, "Known answers must be 0..%d\n", LOADGEN_MAX_KNOWN_ANSWERS);
+        return -1;
+    }
+    return 0;
+}
+
+static int open_target(const loadgen_config_t *cfg, struct sockaddr_in6 *dest) {
+    struct addrinfo hints;
+    struct addrinfo *res = NULL;
+    int fd;
+    int rc;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET6;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags = AI_NUMERICHOST | AI_NUMERICSERV;
+
+    rc = getaddrinfo(cfg->target, cfg->port, &hints, &res);
+    if (rc != 0) {
+        fprintf(stderr, "Invalid target %s: %s\n", cfg->target, gai_strerror(rc));
+        return -1;
+    }
+    memcpy(dest, res->ai_addr, sizeof(*dest));
+    freeaddrinfo(res);
+
+    fd = socket(AF_INET6, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    return fd;
+}
+
+static int pick_type(const unsigned *mix, unsigned total, unsigned *seed) {
+    unsigned r = (unsigned)rand_r(seed) % total;
+
+    for (int i = 0; i < MIX_COUNT; i++) {
+        if (r < mix[i]) {
+            return i;
+        }
+        r -= mix[i];
+    }
+    return MIX_A;
+}
+
+// Append known-answer PTR records (RFC 6762 section 7.1) after the questions
+static int append_known_answers(uint8_t *packet, size_t packet_len, size_t out_len,
+                                const char *ptr_name, int count) {
+    wire_writer_t writer;
+
+    // Uncompressed, like the simplest real queriers
+    wire_writer_init(&writer, packet, out_len, 0);
+    writer.len = packet_len;
+
+    for (int i = 0; i < count; i++) {
+        char instance[300];
+        size_t rdlen_pos;
+
+        snprintf(instance, sizeof(instance), "Known %d.%s", i, ptr_name);
+        wire_begin_rr(&writer, ptr_name, DNS_TYPE_PTR, DNS_CLASS_IN, 4500, &rdlen_pos);
+        wire_put_name(&writer, instance);
+        if (wire_end_rr(&writer, rdlen_pos) != 0) {
+            return -1;
+        }
+    }
+
+    wire_patch_u16(&writer, 6, (uint16_t)count);
+    return wire_writer_finish(&writer);
+}
+
+typedef struct {
+    uint64_t sent[MIX_COUNT];
+    uint64_t answered[MIX_COUNT];
+    uint64_t queries_sent;
+    uint64_t queries_answered;
+    uint64_t responses;
+    uint64_t send_errors;
+    mdns_metrics_t latency;
+} loadgen_stats_t;
+
+static void drain_responses(int fd, loadgen_stats_t *stats) {
+    uint8_t buf[MDNS_MAX_PACKET];
+
+    for (;;) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        dns_question_t questions[MDNS_MAX_QUESTIONS];
+        int question_count;
+        uint16_t id;
+
+        if (n < 0) {
+            return;
+        }
+        if (n < 12) {
+            continue;
+        }
+
+        stats->responses++;
+        id = mdns_packet_id(buf, (size_t)n);
+        // Legacy replies repeat every question they answer
+        question_count = mdns_parse_questions(buf, (size_t)n, questions, MDNS_MAX_QUESTIONS);
+        for (int q = 0; q < question_count; q++) {
+            for (int i = 0; i < MIX_COUNT; i++) {
+                if (mix_qtypes[i] == questions[q].qtype) {
+                    stats->answered[i]++;
+                }
+            }
+        }
+        // A reply too big for one packet is split; time the first
+        if (g_inflight[id].pending) {
+            g_inflight[id].pending = 0;
+            stats->queries_answered++;
+            metrics_record_latency(&stats->latency, now_ns() - g_inflight[id].sent_ns);
+        }
+    }
+}
+
+static void wait_readable(int fd, uint64_t until_ns) {
+    uint64_t now = now_ns();
+    struct pollfd pfd;
+    int timeout_ms;
+
+    if (now >= until_ns) {
+        return;
+    }
+    // Sub-millisecond gaps are spun; poll() cannot sleep that precisely
+    timeout_ms = (int)((until_ns - now) / 1000000ull);
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    poll(&pfd, 1, timeout_ms);
+}
+
+static void print_report(const loadgen_config_t *cfg, const loadgen_stats_t *stats, double elapsed_s) {
+    double loss = stats->queries_sent > 0
+                      ? 100.0 * (double)(stats->queries_sent - stats->queries_answered) / (double)stats->queries_sent
+                      : 0.0;
+
+    printf("sent      %llu queries in %.2f s (%.1f qps, target %.1f)\n", (unsigned long long)stats->queries_sent,
+           elapsed_s, (double)stats->queries_sent / elapsed_s, cfg->rate);
+    printf("answered  %llu queries (%.1f qps), %llu responses, loss %.3f%%\n",
+           (unsigned long long)stats->queries_answered, (double)stats->queries_answered / elapsed_s,
+           (unsigned long long)stats->responses, loss);
+    if (stats->send_errors > 0) {
+        printf("errors    %llu sends failed\n", (unsigned long long)stats->send_errors);
+    }
+    printf("latency   p50 %.1f us  p99 %.1f us  p999 %.1f us\n",
+           (double)metrics_latency_quantile(&stats->latency, 0.5) / 1000.0,
+           (double)metrics_latency_quantile(&stats->latency, 0.99) / 1000.0,
+           (double)metrics_latency_quantile(&stats->latency, 0.999) / 1000.0);
+    for (int i = 0; i < MIX_COUNT; i++) {
+        if (stats->sent[i] > 0) {
+            printf("  %-5s questions %llu, answered %llu\n", mix_names[i], (unsigned long long)stats->sent[i],
+                   (unsigned long long)stats->answered[i]);
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    static loadgen_stats_t stats;
+    loadgen_config_t cfg;
+    struct sockaddr_in6 dest;
+    char host_name[300];
+    unsigned mix_total = 0;
+    unsigned seed = 1;
+    uint64_t interval_ns;
+    uint64_t start;
+    uint64_t end;
+    uint16_t next_id = 1;
+    int fd;
+
+    if (parse_args(argc, argv, &cfg) != 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    if (cfg.host_name == NULL) {
+        char local[256];
+        if (gethostname(local, sizeof(local)) != 0) {
+            perror("gethostname");
+            return 1;
+        }
+        local[sizeof(local) - 1] = '\0';
+        snprintf(host_name, sizeof(host_name), "%s.local", local);
+        cfg.host_name = host_name;
+    }
+
+    for (int i = 0; i < MIX_COUNT; i++) {
+        mix_total += cfg.mix[i];
+    }
+
+    fd = open_target(&cfg, &dest);
+    if (fd < 0) {
+        return 1;
+    }
+
+    interval_ns = (uint64_t)(1e9 / cfg.rate);
+    start = now_ns();
+    end = start + (uint64_t)(cfg.duration * 1e9);
+
+    for (uint64_t n = 0;; n++) {
+        uint64_t due = start + n * interval_ns;
+        dns_question_t questions[MDNS_MAX_QUESTIONS];
+        uint8_t packet[MDNS_MAX_PACKET];
+        int has_ptr = 0;
+        int len;
+
+        if (due >= end) {
+            break;
+        }
+        // Collect answers until this query is due
+        while (now_ns() < due) {
+            drain_responses(fd, &stats);
+            wait_readable(fd, due);
+        }
+
+        memset(questions, 0, sizeof(questions));
+        for (int q = 0; q < cfg.questions; q++) {
+            int type = pick_type(cfg.mix, mix_total, &seed);
+            const char *name = type == MIX_SRV ? cfg.srv_name : type == MIX_PTR ? cfg.ptr_name : cfg.host_name;
+            snprintf(questions[q].name, sizeof(questions[q].name), "%s", name);
+            questions[q].qtype = mix_qtypes[type];
+            questions[q].qclass = DNS_CLASS_IN;
+            stats.sent[type]++;
+            has_ptr |= type == MIX_PTR;
+        }
+
+        len = mdns_build_query(packet, sizeof(packet), next_id, questions, (size_t)cfg.questions);
+        if (len > 0 && has_ptr && cfg.known_answers > 0) {
+            len = append_known_answers(packet, (size_t)len, sizeof(packet), cfg.ptr_name, cfg.known_answers);
+        }
+        if (len < 0) {
+            fprintf(stderr, "Failed to build query (names too long?)\n");
+            close(fd);
+            return 1;
+        }
+
+        g_inflight[next_id].sent_ns = now_ns();
+        g_inflight[next_id].pending = 1;
+        if (sendto(fd, packet, (size_t)len, 0, (const struct sockaddr *)&dest, sizeof(dest)) < 0) {
+            if (errno != EAGAIN && errno != ENOBUFS) {
+                perror("sendto");
+                close(fd);
+                return 1;
+            }
+            g_inflight[next_id].pending = 0;
+            stats.send_errors++;
+        }
+        stats.queries_sent++;
+        next_id = (uint16_t)(next_id + 1);
+    }
+
+    // Give late answers a chance before counting the rest as lost
+    end = now_ns();
+    while (now_ns() < end + LOADGEN_DRAIN_MS * 1000000ull) {
+        drain_responses(fd, &stats);
+        wait_readable(fd, end + LOADGEN_DRAIN_MS * 1000000ull);
+    }
+
+    print_report(&cfg, &stats, (double)(end - start) / 1e9);
+    close(fd);
+    return 0;
+}
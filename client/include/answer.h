@@ -0,0 +1,56 @@
+#ifndef ANSWER_H
+#define ANSWER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "wire.h"
+
+// Decoded resource records of an mDNS response, for mdns_client. Records of
+// types the client does not print and ones with malformed rdata are skipped.
+
+typedef enum {
+    ANSWER_SECTION_ANSWER,
+    ANSWER_SECTION_AUTHORITY,
+    ANSWER_SECTION_ADDITIONAL
+} answer_section_t;
+
+typedef struct {
+    answer_section_t section;
+    char name[WIRE_NAME_TEXT_MAX];
+    uint16_t type;
+    int cache_flush;
+    uint32_t ttl;
+    uint8_t address[16];              // A and AAAA
+    size_t address_len;
+    uint16_t priority;                // SRV
+    uint16_t weight;
+    uint16_t port;
+    char target[WIRE_NAME_TEXT_MAX];  // SRV target, PTR name or NSEC next name
+    const uint8_t *txt;               // TXT rdata, still in the packet
+    uint16_t txt_len;
+    const uint8_t *bitmap;            // NSEC type bitmaps, still in the packet
+    uint16_t bitmap_len;
+} mdns_answer_t;
+
+// Return nonzero to stop the walk
+typedef int (*answer_fn)(void *user, const mdns_answer_t *answer);
+
+// Hand every A, AAAA, PTR, SRV, TXT and NSEC record of a response to fn.
+// Returns the number of records decoded, or -1 if the packet is malformed
+// or not a response.
+int answer_parse_response(const uint8_t *packet, size_t packet_len, answer_fn fn, void *user);
+
+// Decode a record whose rdata is stored uncompressed (as in the record
+// cache); answer->txt then points into rdata. 0, or -1 if it does not fit the type.
+int answer_from_rdata(const char *name, uint16_t type, uint32_t ttl, const uint8_t *rdata,
+                      uint16_t rdlen, mdns_answer_t *answer);
+
+// Uncompressed rdata of a decoded record, for caching; its length or -1
+int answer_rdata(const mdns_answer_t *answer, uint8_t *out, size_t out_len);
+
+// "A 192.0.2.1", "SRV host.local:80 priority=0 weight=0", "TXT \"a=1\" \"b\"",
+// "NSEC host.local types=A,AAAA", ...
+int answer_format(const mdns_answer_t *answer, char *out, size_t out_len);
+
+#endif
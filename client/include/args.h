@@ -18,6 +18,9 @@ typedef struct {
     log_level_t verbosity;
     int ipv4_only;
     int ipv6_only;
+    int first;       // stop at the first response that answers the query
+    const char *batch_file;      // names to resolve, "-" for stdin (optional)
+    const char *socket_path;     // mdns_resolverd socket to ask first (optional)
 } client_config_t;
 
 int parse_args(int argc, char **argv, client_config_t *cfg);
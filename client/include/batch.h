@@ -0,0 +1,47 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Outstanding names of a mdns_client batch run. Names are kept in input
+// order with an open-addressing hash index, so matching a received record
+// costs O(1). A name is asked again only while it has no answer: each
+// retransmission waits twice as long as the one before, and a name gives up
+// BATCH_GIVE_UP_MS after its last attempt.
+
+#define BATCH_RETRY_MS 1000
+#define BATCH_MAX_ATTEMPTS 3
+#define BATCH_GIVE_UP_MS 1000
+
+typedef struct batch batch_t;
+
+// qtypes are asked for every name (A and AAAA for a dual-stack lookup)
+batch_t *batch_create(const uint16_t *qtypes, size_t qtype_count);
+void batch_destroy(batch_t *batch);
+
+// Add a name (a trailing dot is dropped); 1 if it was already there, 0 if
+// added, -1 if invalid or out of memory
+int batch_add(batch_t *batch, const char *name);
+
+size_t batch_count(const batch_t *batch);
+
+// Names neither answered nor given up
+size_t batch_pending(const batch_t *batch);
+
+// Build one query with as many due names as fit in out_len bytes and
+// MDNS_MAX_QUESTIONS questions, counting an attempt for each. Returns the
+// packet length, 0 if no name is due, or -1.
+int batch_build_query(batch_t *batch, uint64_t now_ms, uint8_t *out, size_t out_len);
+
+// An answer-section record (or NSEC) arrived; 1 if it answered a pending name
+int batch_note_answer(batch_t *batch, const char *name, uint16_t type);
+
+// Give up on names whose last attempt has run out. Returns the time of the
+// next retransmission or give-up, or UINT64_MAX if nothing is pending.
+uint64_t batch_expire(batch_t *batch, uint64_t now_ms);
+
+// Call fn for every name that was never answered, in input order
+void batch_for_each_unanswered(const batch_t *batch, void (*fn)(void *user, const char *name), void *user);
+
+#endif
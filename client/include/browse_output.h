@@ -0,0 +1,66 @@
+#ifndef BROWSE_OUTPUT_H
+#define BROWSE_OUTPUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "resolver.h"
+
+// Machine-readable mdns_browse output: one JSON object per line, or
+// length-prefixed binary frames. Everything goes through one buffer that is
+// written out when full or on browse_output_flush(), so a burst of records
+// costs one write() instead of a printf() per field.
+//
+// Binary frame (all integers big-endian):
+//   u16 body length, then the body
+//   record:   u8 1, u8 event, u16 rrtype, u32 ttl, u8 source length (0, 4
+//             or 16), source address, u8 name length, name,
+//             u16 rdlength, rdata (names uncompressed)
+//   instance: u8 2, u8 event, u8 name length, name, u8 host length, host,
+//             u16 port, u8 address count, per address u8 length (4 or 16)
+//             and the address, u16 TXT rdlength, TXT rdata
+
+#define BROWSE_OUTPUT_BUFFER 65536
+
+typedef enum {
+    BROWSE_FORMAT_TEXT,
+    BROWSE_FORMAT_JSONL,
+    BROWSE_FORMAT_BINARY
+} browse_format_t;
+
+typedef enum {
+    OUTPUT_RECORD_SEEN = 0,      // one-shot mode: as received
+    OUTPUT_RECORD_ADDED = 1,
+    OUTPUT_RECORD_REMOVED = 2,
+    OUTPUT_RECORD_CHANGED = 3
+} output_record_event_t;
+
+typedef enum {
+    OUTPUT_INSTANCE_RESOLVED = 0,
+    OUTPUT_INSTANCE_CHANGED = 1,
+    OUTPUT_INSTANCE_REMOVED = 2,
+    OUTPUT_INSTANCE_UNRESOLVED = 3   // srv/txt may be NULL
+} output_instance_event_t;
+
+typedef struct {
+    browse_format_t format;
+    int fd;
+    int failed;                  // a write failed; later output is dropped
+    size_t len;
+    uint8_t buf[BROWSE_OUTPUT_BUFFER];
+} browse_output_t;
+
+void browse_output_init(browse_output_t *out, browse_format_t format, int fd);
+
+// source is the responder's address (4 or 16 bytes), or NULL
+void browse_output_record(browse_output_t *out, output_record_event_t event, const uint8_t *source,
+                          size_t source_len, const char *name, uint16_t type, uint32_t ttl,
+                          const uint8_t *rdata, uint16_t rdlen);
+
+void browse_output_instance(browse_output_t *out, output_instance_event_t event,
+                            const resolved_instance_t *resolved);
+
+// Write out whatever is buffered; 0 or -1 once any write has failed
+int browse_output_flush(browse_output_t *out);
+
+#endif
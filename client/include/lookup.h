@@ -0,0 +1,24 @@
+#ifndef LOOKUP_H
+#define LOOKUP_H
+
+// Unix datagram protocol between mdns_resolverd and its clients.
+//
+// Request, one datagram of text: "<TYPE> <name>", where TYPE is A, AAAA,
+// ADDR (A and AAAA), SRV, TXT or PTR. The client socket must be bound
+// (autobind is enough) so the reply can come back.
+//
+// Reply, one datagram: a status line, then one record per line in
+// mdns_client's format, "<name> <TYPE> <value> ttl=<seconds left>".
+// Records the answer implies (the addresses of an SRV target) end in
+// " (additional)".
+//   OK         cached records, or ones that arrived after asking the network
+//   NONE       an NSEC record says the name has none of the asked types,
+//              or nothing arrived within LOOKUP_TIMEOUT_MS of asking
+//   ERR <why>  malformed request or the daemon is overloaded
+
+#define LOOKUP_DEFAULT_SOCKET "/run/mdns_resolverd.sock"
+#define LOOKUP_REQUEST_MAX 300
+#define LOOKUP_REPLY_MAX 8192
+#define LOOKUP_TIMEOUT_MS 1000
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef RECORD_CACHE_H
+#define RECORD_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// TTL-aware cache of received resource records, keyed by (name, type, rdata).
+// Owner names compare case-insensitively; rdata compares byte for byte, so
+// callers must store it without compression pointers. Expiry runs on a
+// hashed timer wheel, so record_cache_expire() costs O(due timers) per tick
+// regardless of how many records are cached.
+
+#define RECORD_CACHE_BUCKETS 1024
+#define RECORD_CACHE_TICK_MS 250
+#define RECORD_CACHE_WHEEL_SLOTS 256   // one revolution covers 64 s
+
+typedef struct cached_record {
+    char name[256];
+    uint16_t type;
+    uint32_t ttl;
+    uint64_t received_ms;
+    uint64_t expires_ms;
+    // cache bookkeeping
+    uint64_t deadline_ms;
+    int refresh_stage;      // refresh points already reported (0-4)
+    uint32_t hash;
+    struct cached_record *bucket_next;
+    struct cached_record *timer_prev;
+    struct cached_record *timer_next;
+    uint16_t rdlen;
+    uint8_t rdata[];
+} cached_record_t;
+
+typedef enum {
+    RECORD_ADDED,
+    RECORD_CHANGED,    // previous is the record it replaced (cache-flush)
+    RECORD_REMOVED,    // TTL expired, goodbye (TTL 0) or flushed
+    RECORD_REFRESH     // 80/85/90/95% of the TTL has passed: query again to keep it
+} record_event_t;
+
+// Called for every state change; records are only valid during the call
+typedef void (*record_event_fn)(void *user, record_event_t event, const cached_record_t *record,
+                                const cached_record_t *previous);
+
+typedef struct record_cache record_cache_t;
+
+record_cache_t *record_cache_create(record_event_fn on_event, void *user, uint64_t now_ms);
+void record_cache_destroy(record_cache_t *cache);
+
+// Apply one received record. A new (name, type, rdata) is ADDED; a known one
+// only gets its TTL renewed. cache_flush (the top bit of the rrclass) marks a
+// unique record: other rdata for the same name and type received more than a
+// second ago is replaced (CHANGED) or dropped (REMOVED), whether this rdata
+// is new or a renewal. TTL 0 removes.
+// Returns 0, or -1 on allocation failure or an over-long name.
+int record_cache_update(record_cache_t *cache, const char *name, uint16_t type, int cache_flush,
+                        const uint8_t *rdata, uint16_t rdlen, uint32_t ttl, uint64_t now_ms);
+
+// Run every timer due by now_ms: REFRESH at 80, 85, 90 and 95% of the TTL
+// (plus 0-2% random variation, RFC 6762 section 5.2), REMOVED at expiry
+void record_cache_expire(record_cache_t *cache, uint64_t now_ms);
+
+// Store up to max cached records for (name, type) in out; returns the count
+size_t record_cache_lookup(const record_cache_t *cache, const char *name, uint16_t type,
+                           const cached_record_t **out, size_t max);
+
+size_t record_cache_count(const record_cache_t *cache);
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mdns.h"
+#include "record_cache.h"
+
+// Service instance resolver for mdns_browse: PTR -> SRV/TXT -> A/AAAA.
+// Instances found by browsing are resolved from the record cache; whatever
+// the responders did not volunteer (usually in the additional section) is
+// asked for with follow-up questions, which the caller batches into as few
+// packets as possible.
+
+#define RESOLVER_RETRY_MS 1000
+#define RESOLVER_MAX_ATTEMPTS 3
+#define RESOLVER_MAX_ADDRESSES 8
+
+typedef struct {
+    const char *instance;
+    const cached_record_t *srv;   // NULL while missing
+    const cached_record_t *txt;
+    const cached_record_t *addresses[RESOLVER_MAX_ADDRESSES];   // A and AAAA of the SRV target
+    size_t address_count;
+    char target[256];             // SRV target host, "" while the SRV is missing
+    int complete;                 // SRV, TXT and at least one address known
+} resolved_instance_t;
+
+// State: 0 first complete, 1 changed since last reported, -1 removed/unresolved
+typedef void (*resolver_report_fn)(void *user, int state, const resolved_instance_t *instance);
+
+typedef struct resolver resolver_t;
+
+resolver_t *resolver_create(const record_cache_t *cache);
+void resolver_destroy(resolver_t *resolver);
+
+// Track an instance name (from a browse PTR record); 0 or -1 on allocation failure
+int resolver_add_instance(resolver_t *resolver, const char *instance);
+
+// Forget an instance whose PTR record went away; reported as removed if it
+// had been reported complete
+void resolver_remove_instance(resolver_t *resolver, const char *instance, resolver_report_fn fn,
+                              void *user);
+
+// Append up to max follow-up questions (skipping ones already in out[0..count))
+// for instances still missing SRV/TXT or addresses. Each instance is asked at
+// most every RESOLVER_RETRY_MS, RESOLVER_MAX_ATTEMPTS times until it changes.
+// Returns the new question count.
+size_t resolver_collect_questions(resolver_t *resolver, uint64_t now_ms, dns_question_t *out,
+                                  size_t count, size_t max);
+
+// Report every complete instance that is new or changed since the last call
+void resolver_report(resolver_t *resolver, resolver_report_fn fn, void *user);
+
+// Report instances that never became complete (state -1); for end of run
+void resolver_report_unresolved(resolver_t *resolver, resolver_report_fn fn, void *user);
+
+#endif
@@ -0,0 +1,278 @@
+#include "answer.h"
+
+#include <arpa/inet.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "mdns.h"
+
+#define DNS_FLAG_QR 0x8000
+
+// Fill in the type-specific fields; -1 if the rdata does not fit the type
+static int decode_rdata(const uint8_t *packet, size_t packet_len, const wire_rr_t *rr, mdns_answer_t *answer) {
+    const uint8_t *rdata = &packet[rr->rdata_offset];
+    size_t next;
+
+    switch (rr->type) {
+        case DNS_TYPE_A:
+        case DNS_TYPE_AAAA:
+            if (rr->rdlen != (rr->type == DNS_TYPE_A ? 4 : 16)) {
+                return -1;
+            }
+            memcpy(answer->address, rdata, rr->rdlen);
+            answer->address_len = rr->rdlen;
+            return 0;
+        case DNS_TYPE_PTR:
+            return wire_decode_name(packet, packet_len, rr->rdata_offset, answer->target,
+                                    sizeof(answer->target), &next) < 0 ? -1 : 0;
+        case DNS_TYPE_SRV:
+            if (rr->rdlen < 7 || wire_decode_name(packet, packet_len, rr->rdata_offset + 6, answer->target,
+                                                  sizeof(answer->target), &next) < 0) {
+                return -1;
+            }
+            answer->priority = wire_read_u16(rdata);
+            answer->weight = wire_read_u16(rdata + 2);
+            answer->port = wire_read_u16(rdata + 4);
+            return 0;
+        case DNS_TYPE_TXT:
+            answer->txt = rdata;
+            answer->txt_len = rr->rdlen;
+            return 0;
+        case DNS_TYPE_NSEC:
+            if (wire_decode_name(packet, packet_len, rr->rdata_offset, answer->target, sizeof(answer->target),
+                                 &next) < 0 || next > rr->rdata_offset + rr->rdlen) {
+                return -1;
+            }
+            answer->bitmap = &packet[next];
+            answer->bitmap_len = (uint16_t)(rr->rdata_offset + rr->rdlen - next);
+            return 0;
+        default:
+            return -1;
+    }
+}
+
+int answer_parse_response(const uint8_t *packet, size_t packet_len, answer_fn fn, void *user) {
+    wire_reader_t reader;
+    wire_header_t header;
+    uint16_t counts[3];
+    mdns_answer_t answer;
+    int decoded = 0;
+
+    if (packet == NULL || fn == NULL) {
+        return -1;
+    }
+    wire_reader_init(&reader, packet, packet_len);
+    if (wire_read_header(&reader, &header) != 0 || (header.flags & DNS_FLAG_QR) == 0) {
+        return -1;
+    }
+
+    // Legacy unicast replies echo the question
+    for (uint16_t i = 0; i < header.qdcount; i++) {
+        size_t name_offset;
+        uint16_t qtype;
+        uint16_t qclass;
+
+        if (wire_read_question(&reader, &name_offset, &qtype, &qclass) != 0) {
+            return -1;
+        }
+    }
+
+    counts[ANSWER_SECTION_ANSWER] = header.ancount;
+    counts[ANSWER_SECTION_AUTHORITY] = header.nscount;
+    counts[ANSWER_SECTION_ADDITIONAL] = header.arcount;
+    for (int section = ANSWER_SECTION_ANSWER; section <= ANSWER_SECTION_ADDITIONAL; section++) {
+        for (uint16_t i = 0; i < counts[section]; i++) {
+            wire_rr_t rr;
+
+            if (wire_read_rr(&reader, &rr) != 0) {
+                return -1;
+            }
+            memset(&answer, 0, sizeof(answer));
+            if (decode_rdata(packet, packet_len, &rr, &answer) != 0 ||
+                wire_decode_name(packet, packet_len, rr.name_offset, answer.name, sizeof(answer.name), NULL) < 0) {
+                continue;
+            }
+            answer.section = (answer_section_t)section;
+            answer.type = rr.type;
+            answer.cache_flush = (rr.rrclass & DNS_CLASS_CACHE_FLUSH) != 0;
+            answer.ttl = rr.ttl;
+            decoded++;
+            if (fn(user, &answer) != 0) {
+                return decoded;
+            }
+        }
+    }
+    return decoded;
+}
+
+int answer_from_rdata(const char *name, uint16_t type, uint32_t ttl, const uint8_t *rdata,
+                      uint16_t rdlen, mdns_answer_t *answer) {
+    wire_rr_t rr;
+
+    memset(answer, 0, sizeof(*answer));
+    if (strlen(name) >= sizeof(answer->name)) {
+        return -1;
+    }
+    rr.type = type;
+    rr.rdlen = rdlen;
+    rr.rdata_offset = 0;
+    if (decode_rdata(rdata, rdlen, &rr, answer) != 0) {
+        return -1;
+    }
+    strcpy(answer->name, name);
+    answer->type = type;
+    answer->ttl = ttl;
+    return 0;
+}
+
+// The root name has no labels for wire_encode_name() to write
+static int encode_target(const char *target, uint8_t *out, size_t out_len, size_t *written) {
+    if (strcmp(target, ".") == 0 && out_len > 0) {
+        out[0] = 0;
+        *written = 1;
+        return 0;
+    }
+    return wire_encode_name(target, out, out_len, written);
+}
+
+int answer_rdata(const mdns_answer_t *answer, uint8_t *out, size_t out_len) {
+    size_t written;
+
+    switch (answer->type) {
+        case DNS_TYPE_A:
+        case DNS_TYPE_AAAA:
+            if (answer->address_len > out_len) {
+                return -1;
+            }
+            memcpy(out, answer->address, answer->address_len);
+            return (int)answer->address_len;
+        case DNS_TYPE_PTR:
+            return encode_target(answer->target, out, out_len, &written) == 0 ? (int)written : -1;
+        case DNS_TYPE_SRV:
+            if (out_len < 6 || encode_target(answer->target, out + 6, out_len - 6, &written) != 0) {
+                return -1;
+            }
+            wire_write_u16(out, answer->priority);
+            wire_write_u16(out + 2, answer->weight);
+            wire_write_u16(out + 4, answer->port);
+            return (int)(written + 6);
+        case DNS_TYPE_TXT:
+            if (answer->txt_len > out_len) {
+                return -1;
+            }
+            memcpy(out, answer->txt, answer->txt_len);
+            return (int)answer->txt_len;
+        case DNS_TYPE_NSEC:
+            if (encode_target(answer->target, out, out_len, &written) != 0 ||
+                answer->bitmap_len > out_len - written) {
+                return -1;
+            }
+            memcpy(out + written, answer->bitmap, answer->bitmap_len);
+            return (int)(written + answer->bitmap_len);
+        default:
+            return -1;
+    }
+}
+
+// Each string quoted, space separated
+static int format_txt(const uint8_t *txt, size_t txt_len, char *out, size_t out_len) {
+    size_t pos = 0;
+    size_t used = 0;
+
+    while (pos < txt_len) {
+        uint8_t len = txt[pos++];
+        int n;
+
+        if (pos + len > txt_len) {
+            break;
+        }
+        n = snprintf(&out[used], out_len - used, " \"%.*s\"", (int)len, (const char *)&txt[pos]);
+        if (n < 0 || (size_t)n >= out_len - used) {
+            return -1;
+        }
+        used += (size_t)n;
+        pos += len;
+    }
+    return 0;
+}
+
+// The types an NSEC bitmap lists, comma separated ("types=A,AAAA")
+static int format_nsec_types(const uint8_t *bitmap, size_t bitmap_len, char *out, size_t out_len) {
+    size_t pos = 0;
+    size_t used;
+    char sep = '=';
+    int n;
+
+    n = snprintf(out, out_len, " types");
+    if (n < 0 || (size_t)n >= out_len) {
+        return -1;
+    }
+    used = (size_t)n;
+    while (pos + 2 <= bitmap_len) {
+        uint8_t window = bitmap[pos];
+        uint8_t len = bitmap[pos + 1];
+
+        pos += 2;
+        if (len > 32 || pos + len > bitmap_len) {
+            break;
+        }
+        for (unsigned int bit = 0; bit < (unsigned int)len * 8; bit++) {
+            uint16_t type = (uint16_t)(window * 256 + bit);
+            const char *name = mdns_type_name(type);
+
+            if ((bitmap[pos + bit / 8] & (0x80 >> (bit % 8))) == 0) {
+                continue;
+            }
+            n = name != NULL ? snprintf(&out[used], out_len - used, "%c%s", sep, name)
+                             : snprintf(&out[used], out_len - used, "%cTYPE%" PRIu16, sep, type);
+            if (n < 0 || (size_t)n >= out_len - used) {
+                return -1;
+            }
+            used += (size_t)n;
+            sep = ',';
+        }
+        pos += len;
+    }
+    return 0;
+}
+
+int answer_format(const mdns_answer_t *answer, char *out, size_t out_len) {
+    char addr[INET6_ADDRSTRLEN];
+    int n;
+
+    switch (answer->type) {
+        case DNS_TYPE_A:
+        case DNS_TYPE_AAAA:
+            if (inet_ntop(answer->type == DNS_TYPE_A ? AF_INET : AF_INET6, answer->address, addr,
+                          sizeof(addr)) == NULL) {
+                return -1;
+            }
+            n = snprintf(out, out_len, "%s %s", answer->type == DNS_TYPE_A ? "A" : "AAAA", addr);
+            break;
+        case DNS_TYPE_PTR:
+            n = snprintf(out, out_len, "PTR %s", answer->target);
+            break;
+        case DNS_TYPE_SRV:
+            n = snprintf(out, out_len, "SRV %s:%" PRIu16 " priority=%" PRIu16 " weight=%" PRIu16,
+                         answer->target, answer->port, answer->priority, answer->weight);
+            break;
+        case DNS_TYPE_TXT:
+            n = snprintf(out, out_len, "TXT");
+            if (n > 0 && (size_t)n < out_len &&
+                format_txt(answer->txt, answer->txt_len, out + n, out_len - (size_t)n) != 0) {
+                return -1;
+            }
+            break;
+        case DNS_TYPE_NSEC:
+            n = snprintf(out, out_len, "NSEC %s", answer->target);
+            if (n > 0 && (size_t)n < out_len &&
+                format_nsec_types(answer->bitmap, answer->bitmap_len, out + n, out_len - (size_t)n) != 0) {
+                return -1;
+            }
+            break;
+        default:
+            return -1;
+    }
+    return n < 0 || (size_t)n >= out_len ? -1 : 0;
+}
@@ -5,20 +5,26 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "lookup.h"
+
 void print_usage(const char *progname) {
     fprintf(stderr,
             "mDNS Client - Query mDNS for hostnames and services\n\n"
             "Usage: %s [options] <query>\n"
-            "       %s -t service <service-type> [-4|-6] [-v]\n\n"
+            "       %s -t service <service-type> [-4|-6] [-v]\n"
+            "       %s -b <file|-> [-t <type>] [-4|-6] [-v]\n\n"
             "Options:\n"
             "  <query>           Hostname or service FQDN to resolve (default: A/AAAA lookup)\n"
             "  -t, --type        Query type: hostname|service|ipv4|ipv6 (default: hostname)\n"
             "  -i, --interface   Network interface name (optional)\n"
             "  -4, --ipv4        IPv4 only (A records)\n"
             "  -6, --ipv6        IPv6 only (AAAA records)\n"
+            "  -f, --first       Exit after the first response that answers the query\n"
+            "  -b, --batch       Resolve the names in a file (- for stdin), one per line\n"
+            "  -s, --socket      Ask mdns_resolverd on this socket first, e.g. " LOOKUP_DEFAULT_SOCKET "\n"
             "  -v, --verbose     Verbose output\n"
             "  -h, --help        Show this help\n",
-            progname, progname);
+            progname, progname, progname);
 }
 
 int parse_args(int argc, char **argv, client_config_t *cfg) {
@@ -27,6 +33,9 @@ int parse_args(int argc, char **argv, client_config_t *cfg) {
         {"interface", required_argument, 0, 'i'},
         {"ipv4", no_argument, 0, '4'},
         {"ipv6", no_argument, 0, '6'},
+        {"first", no_argument, 0, 'f'},
+        {"batch", required_argument, 0, 'b'},
+        {"socket", required_argument, 0, 's'},
         {"verbose", no_argument, 0, 'v'},
         {"help", no_argument, 0, 'h'},
         {0, 0, 0, 0}
@@ -46,8 +55,11 @@ int parse_args(int argc, char **argv, client_config_t *cfg) {
     cfg->verbosity = APP_LOG_WARN;
     cfg->ipv4_only = 0;
     cfg->ipv6_only = 0;
+    cfg->first = 0;
+    cfg->batch_file = NULL;
+    cfg->socket_path = NULL;
 
-    while ((opt = getopt_long(argc, argv, "t:i:46vh", long_opts, NULL)) != -1) {
+    while ((opt = getopt_long(argc, argv, "t:i:46fb:s:vh", long_opts, NULL)) != -1) {
         switch (opt) {
             case 't':
                 if (strcmp(optarg, "hostname") == 0) {
@@ -72,6 +84,15 @@ int parse_args(int argc, char **argv, client_config_t *cfg) {
             case '6':
                 cfg->ipv6_only = 1;
                 break;
+            case 'f':
+                cfg->first = 1;
+                break;
+            case 'b':
+                cfg->batch_file = optarg;
+                break;
+            case 's':
+                cfg->socket_path = optarg;
+                break;
             case 'v':
                 cfg->verbose = 1;
                 cfg->verbosity = APP_LOG_DEBUG;
@@ -85,7 +106,16 @@ int parse_args(int argc, char **argv, client_config_t *cfg) {
     }
 
     // Get the query target (positional argument)
-    if (optind < argc) {
+    if (cfg->batch_file != NULL) {
+        if (optind < argc) {
+            fprintf(stderr, "Cannot combine -b with a query target\n");
+            return -1;
+        }
+        if (cfg->socket_path != NULL) {
+            fprintf(stderr, "Cannot combine -b with -s\n");
+            return -1;
+        }
+    } else if (optind < argc) {
         cfg->query_target = argv[optind];
     } else if (cfg->query_type != QUERY_TYPE_SERVICE || optind + 1 >= argc) {
         fprintf(stderr, "Missing query target\n");
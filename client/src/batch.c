@@ -0,0 +1,269 @@
+#include "batch.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "mdns.h"
+#include "wire.h"
+
+#define BATCH_MAX_QTYPES 2
+
+typedef enum {
+    NAME_PENDING,
+    NAME_ANSWERED,
+    NAME_GAVE_UP
+} name_state_t;
+
+typedef struct {
+    char name[WIRE_NAME_TEXT_MAX];
+    uint32_t hash;
+    name_state_t state;
+    int attempts;
+    uint64_t deadline_ms;   // next retransmission, or giving up after the last
+} batch_name_t;
+
+struct batch {
+    uint16_t qtypes[BATCH_MAX_QTYPES];
+    size_t qtype_count;
+    batch_name_t *names;
+    size_t count;
+    size_t capacity;
+    size_t pending;
+    size_t first_pending;   // no name before this one is pending
+    uint32_t *index;        // position in names + 1, 0 for an empty slot
+    size_t index_capacity;
+};
+
+// Case-insensitive FNV-1a, as answers may change the case of a name
+static uint32_t name_hash(const char *name) {
+    uint32_t hash = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *)name; *p != '\0'; p++) {
+        hash ^= (uint32_t)tolower(*p);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Slot holding name, or the empty slot where it would go
+static size_t index_probe(const batch_t *batch, const char *name, uint32_t hash) {
+    size_t mask = batch->index_capacity - 1;
+    size_t slot = hash & mask;
+
+    while (batch->index[slot] != 0) {
+        const batch_name_t *entry = &batch->names[batch->index[slot] - 1];
+        if (entry->hash == hash && strcasecmp(entry->name, name) == 0) {
+            break;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+// Double the index, rehashing every name, so it stays at most half full
+static int index_grow(batch_t *batch) {
+    size_t new_capacity = batch->index_capacity == 0 ? 64 : batch->index_capacity * 2;
+    uint32_t *new_index = calloc(new_capacity, sizeof(*new_index));
+
+    if (new_index == NULL) {
+        return -1;
+    }
+    for (size_t i = 0; i < batch->count; i++) {
+        size_t slot = batch->names[i].hash & (new_capacity - 1);
+        while (new_index[slot] != 0) {
+            slot = (slot + 1) & (new_capacity - 1);
+        }
+        new_index[slot] = (uint32_t)(i + 1);
+    }
+    free(batch->index);
+    batch->index = new_index;
+    batch->index_capacity = new_capacity;
+    return 0;
+}
+
+batch_t *batch_create(const uint16_t *qtypes, size_t qtype_count) {
+    batch_t *batch;
+
+    if (qtypes == NULL || qtype_count == 0 || qtype_count > BATCH_MAX_QTYPES) {
+        return NULL;
+    }
+    batch = calloc(1, sizeof(*batch));
+    if (batch == NULL) {
+        return NULL;
+    }
+    memcpy(batch->qtypes, qtypes, qtype_count * sizeof(*qtypes));
+    batch->qtype_count = qtype_count;
+    return batch;
+}
+
+void batch_destroy(batch_t *batch) {
+    if (batch == NULL) {
+        return;
+    }
+    free(batch->names);
+    free(batch->index);
+    free(batch);
+}
+
+int batch_add(batch_t *batch, const char *name) {
+    uint8_t wire[WIRE_NAME_MAX + 1];
+    size_t wire_len;
+    size_t len = strlen(name);
+    batch_name_t *entry;
+    uint32_t hash;
+    size_t slot;
+
+    if (len > 0 && name[len - 1] == '.') {
+        len--;
+    }
+    if (len == 0 || len >= sizeof(entry->name) - 1) {
+        return -1;
+    }
+    if ((batch->count + 1) * 2 > batch->index_capacity && index_grow(batch) != 0) {
+        return -1;
+    }
+    if (batch->count == batch->capacity) {
+        size_t new_capacity = batch->capacity == 0 ? 64 : batch->capacity * 2;
+        batch_name_t *names = realloc(batch->names, new_capacity * sizeof(*names));
+        if (names == NULL) {
+            return -1;
+        }
+        batch->names = names;
+        batch->capacity = new_capacity;
+    }
+
+    entry = &batch->names[batch->count];
+    memcpy(entry->name, name, len);
+    entry->name[len] = '\0';
+    // Labels must be 1-63 bytes and the whole name fit the wire format
+    if (wire_encode_name(entry->name, wire, sizeof(wire), &wire_len) != 0) {
+        return -1;
+    }
+
+    hash = name_hash(entry->name);
+    slot = index_probe(batch, entry->name, hash);
+    if (batch->index[slot] != 0) {
+        return 1;
+    }
+    entry->hash = hash;
+    entry->state = NAME_PENDING;
+    entry->attempts = 0;
+    entry->deadline_ms = 0;
+    batch->index[slot] = (uint32_t)(batch->count + 1);
+    batch->count++;
+    batch->pending++;
+    return 0;
+}
+
+size_t batch_count(const batch_t *batch) {
+    return batch->count;
+}
+
+size_t batch_pending(const batch_t *batch) {
+    return batch->pending;
+}
+
+int batch_build_query(batch_t *batch, uint64_t now_ms, uint8_t *out, size_t out_len) {
+    wire_writer_t writer;
+    size_t questions = 0;
+
+    wire_writer_init(&writer, out, out_len, 1);
+    if (wire_put_header(&writer, 0, 0) != 0) {
+        return -1;
+    }
+
+    while (batch->first_pending < batch->count && batch->names[batch->first_pending].state != NAME_PENDING) {
+        batch->first_pending++;
+    }
+    for (size_t i = batch->first_pending;
+         i < batch->count && questions + batch->qtype_count <= MDNS_MAX_QUESTIONS; i++) {
+        batch_name_t *entry = &batch->names[i];
+        wire_mark_t mark;
+
+        if (entry->state != NAME_PENDING || entry->attempts >= BATCH_MAX_ATTEMPTS ||
+            entry->deadline_ms > now_ms) {
+            continue;
+        }
+        mark = wire_writer_mark(&writer);
+        for (size_t q = 0; q < batch->qtype_count; q++) {
+            wire_put_question(&writer, entry->name, batch->qtypes[q], DNS_CLASS_IN);
+        }
+        if (writer.failed) {
+            wire_writer_rewind(&writer, mark);
+            break;
+        }
+        questions += batch->qtype_count;
+
+        entry->attempts++;
+        if (entry->attempts < BATCH_MAX_ATTEMPTS) {
+            entry->deadline_ms = now_ms + ((uint64_t)BATCH_RETRY_MS << (entry->attempts - 1));
+        } else {
+            entry->deadline_ms = now_ms + BATCH_GIVE_UP_MS;
+        }
+    }
+
+    if (questions == 0) {
+        return 0;
+    }
+    wire_patch_u16(&writer, 4, (uint16_t)questions);
+    return wire_writer_finish(&writer);
+}
+
+int batch_note_answer(batch_t *batch, const char *name, uint16_t type) {
+    uint32_t hash;
+    size_t slot;
+    batch_name_t *entry;
+    int asked;
+
+    // An NSEC settles the name as well: it has none of the asked types
+    asked = type == DNS_TYPE_NSEC;
+    for (size_t q = 0; q < batch->qtype_count; q++) {
+        asked |= batch->qtypes[q] == type;
+    }
+    if (!asked || batch->count == 0) {
+        return 0;
+    }
+
+    hash = name_hash(name);
+    slot = index_probe(batch, name, hash);
+    if (batch->index[slot] == 0) {
+        return 0;
+    }
+    entry = &batch->names[batch->index[slot] - 1];
+    if (entry->state != NAME_PENDING) {
+        return 0;
+    }
+    entry->state = NAME_ANSWERED;
+    batch->pending--;
+    return 1;
+}
+
+uint64_t batch_expire(batch_t *batch, uint64_t now_ms) {
+    uint64_t next = UINT64_MAX;
+
+    for (size_t i = batch->first_pending; i < batch->count; i++) {
+        batch_name_t *entry = &batch->names[i];
+
+        if (entry->state != NAME_PENDING) {
+            continue;
+        }
+        if (entry->attempts >= BATCH_MAX_ATTEMPTS && entry->deadline_ms <= now_ms) {
+            entry->state = NAME_GAVE_UP;
+            batch->pending--;
+            continue;
+        }
+        if (entry->deadline_ms < next) {
+            next = entry->deadline_ms;
+        }
+    }
+    return next;
+}
+
+void batch_for_each_unanswered(const batch_t *batch, void (*fn)(void *user, const char *name), void *user) {
+    for (size_t i = 0; i < batch->count; i++) {
+        if (batch->names[i].state != NAME_ANSWERED) {
+            fn(user, batch->names[i].name);
+        }
+    }
+}
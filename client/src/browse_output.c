@@ -0,0 +1,345 @@
+#include "browse_output.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "mdns.h"
+#include "wire.h"
+
+static const char *const record_events[] = {"seen", "added", "removed", "changed"};
+static const char *const instance_events[] = {"resolved", "changed", "removed", "unresolved"};
+
+static int write_all(int fd, const uint8_t *data, size_t len) {
+    while (len > 0) {
+        ssize_t written = write(fd, data, len);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        data += written;
+        len -= (size_t)written;
+    }
+    return 0;
+}
+
+void browse_output_init(browse_output_t *out, browse_format_t format, int fd) {
+    out->format = format;
+    out->fd = fd;
+    out->failed = 0;
+    out->len = 0;
+}
+
+int browse_output_flush(browse_output_t *out) {
+    if (out->len > 0 && !out->failed && write_all(out->fd, out->buf, out->len) != 0) {
+        out->failed = 1;
+    }
+    out->len = 0;
+    return out->failed ? -1 : 0;
+}
+
+static void put(browse_output_t *out, const void *data, size_t len) {
+    if (len == 0) {
+        return;
+    }
+    if (out->len + len > sizeof(out->buf)) {
+        browse_output_flush(out);
+        if (len > sizeof(out->buf)) {
+            if (!out->failed && write_all(out->fd, data, len) != 0) {
+                out->failed = 1;
+            }
+            return;
+        }
+    }
+    memcpy(&out->buf[out->len], data, len);
+    out->len += len;
+}
+
+static void put_str(browse_output_t *out, const char *text) {
+    put(out, text, strlen(text));
+}
+
+static void put_u8(browse_output_t *out, uint8_t value) {
+    put(out, &value, 1);
+}
+
+static void put_u16(browse_output_t *out, uint16_t value) {
+    uint8_t bytes[2] = {(uint8_t)(value >> 8), (uint8_t)value};
+    put(out, bytes, sizeof(bytes));
+}
+
+static void put_u32(browse_output_t *out, uint32_t value) {
+    uint8_t bytes[4] = {(uint8_t)(value >> 24), (uint8_t)(value >> 16), (uint8_t)(value >> 8), (uint8_t)value};
+    put(out, bytes, sizeof(bytes));
+}
+
+static void put_decimal(browse_output_t *out, uint32_t value) {
+    char digits[10];
+    size_t n = sizeof(digits);
+
+    do {
+        digits[--n] = (char)('0' + value % 10u);
+        value /= 10u;
+    } while (value != 0);
+    put(out, &digits[n], sizeof(digits) - n);
+}
+
+// Quoted JSON string; bytes from 0x80 up pass through as UTF-8
+static void put_json_bytes(browse_output_t *out, const uint8_t *text, size_t len) {
+    static const char hex[] = "0123456789abcdef";
+    size_t start = 0;
+
+    put(out, "\"", 1);
+    for (size_t i = 0; i < len; i++) {
+        uint8_t c = text[i];
+        char escape[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0x0F]};
+
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        put(out, &text[start], i - start);
+        start = i + 1;
+        if (c == '"' || c == '\\') {
+            escape[1] = (char)c;
+            put(out, escape, 2);
+        } else {
+            put(out, escape, sizeof(escape));
+        }
+    }
+    put(out, &text[start], len - start);
+    put(out, "\"", 1);
+}
+
+static void put_json_string(browse_output_t *out, const char *text) {
+    put_json_bytes(out, (const uint8_t *)text, strlen(text));
+}
+
+// ,"key":
+static void put_key(browse_output_t *out, const char *key) {
+    put(out, ",\"", 2);
+    put_str(out, key);
+    put(out, "\":", 2);
+}
+
+static void put_json_name(browse_output_t *out, const char *key, const uint8_t *wire, size_t wire_len) {
+    char text[256];
+
+    put_key(out, key);
+    if (wire_name_to_text(wire, wire_len, text, sizeof(text)) == 0) {
+        put_json_string(out, text);
+    } else {
+        put_str(out, "null");
+    }
+}
+
+static void put_json_txt(browse_output_t *out, const uint8_t *rdata, size_t rdlen) {
+    size_t pos = 0;
+
+    put_key(out, "txt");
+    put(out, "[", 1);
+    while (pos < rdlen) {
+        uint8_t len = rdata[pos++];
+        if (pos + len > rdlen) {
+            break;
+        }
+        if (pos > 1) {
+            put(out, ",", 1);
+        }
+        put_json_bytes(out, &rdata[pos], len);
+        pos += len;
+    }
+    put(out, "]", 1);
+}
+
+static void put_json_address(browse_output_t *out, const uint8_t *addr, size_t len) {
+    char text[INET6_ADDRSTRLEN];
+
+    if (inet_ntop(len == 4 ? AF_INET : AF_INET6, addr, text, sizeof(text)) == NULL) {
+        put_str(out, "null");
+        return;
+    }
+    put(out, "\"", 1);
+    put_str(out, text);
+    put(out, "\"", 1);
+}
+
+// {"event":..,"type":..,"name":..,"ttl":..,"source":.., then per-type fields}
+static void json_record(browse_output_t *out, output_record_event_t event, const uint8_t *source,
+                        size_t source_len, const char *name, uint16_t type, uint32_t ttl,
+                        const uint8_t *rdata, uint16_t rdlen) {
+    const char *type_text = mdns_type_name(type);
+
+    put_str(out, "{\"event\":\"");
+    put_str(out, record_events[event]);
+    put(out, "\"", 1);
+    put_key(out, "type");
+    if (type_text != NULL) {
+        put_json_string(out, type_text);
+    } else {
+        put_decimal(out, type);
+    }
+    put_key(out, "name");
+    put_json_string(out, name);
+    put_key(out, "ttl");
+    put_decimal(out, ttl);
+    if (source != NULL) {
+        put_key(out, "source");
+        put_json_address(out, source, source_len);
+    }
+
+    switch (type) {
+        case DNS_TYPE_PTR:
+            put_json_name(out, "target", rdata, rdlen);
+            break;
+        case DNS_TYPE_SRV:
+            if (rdlen < 7) {
+                break;
+            }
+            put_key(out, "priority");
+            put_decimal(out, wire_read_u16(rdata));
+            put_key(out, "weight");
+            put_decimal(out, wire_read_u16(rdata + 2));
+            put_key(out, "port");
+            put_decimal(out, wire_read_u16(rdata + 4));
+            put_json_name(out, "target", rdata + 6, rdlen - 6u);
+            break;
+        case DNS_TYPE_TXT:
+            put_json_txt(out, rdata, rdlen);
+            break;
+        case DNS_TYPE_A:
+        case DNS_TYPE_AAAA:
+            if (rdlen == 4 || rdlen == 16) {
+                put_key(out, "address");
+                put_json_address(out, rdata, rdlen);
+            }
+            break;
+        default:
+            break;
+    }
+    put(out, "}\n", 2);
+}
+
+static void binary_record(browse_output_t *out, output_record_event_t event, const uint8_t *source,
+                          size_t source_len, const char *name, uint16_t type, uint32_t ttl,
+                          const uint8_t *rdata, uint16_t rdlen) {
+    size_t name_len = strlen(name);
+
+    if (source == NULL) {
+        source_len = 0;
+    }
+    put_u16(out, (uint16_t)(1 + 1 + 2 + 4 + 1 + source_len + 1 + name_len + 2 + rdlen));
+    put_u8(out, 1);
+    put_u8(out, (uint8_t)event);
+    put_u16(out, type);
+    put_u32(out, ttl);
+    put_u8(out, (uint8_t)source_len);
+    put(out, source, source_len);
+    put_u8(out, (uint8_t)name_len);
+    put(out, name, name_len);
+    put_u16(out, rdlen);
+    put(out, rdata, rdlen);
+}
+
+void browse_output_record(browse_output_t *out, output_record_event_t event, const uint8_t *source,
+                          size_t source_len, const char *name, uint16_t type, uint32_t ttl,
+                          const uint8_t *rdata, uint16_t rdlen) {
+    if (out->format == BROWSE_FORMAT_JSONL) {
+        json_record(out, event, source, source_len, name, type, ttl, rdata, rdlen);
+    } else if (out->format == BROWSE_FORMAT_BINARY) {
+        binary_record(out, event, source, source_len, name, type, ttl, rdata, rdlen);
+    }
+}
+
+static void json_instance(browse_output_t *out, output_instance_event_t event,
+                          const resolved_instance_t *resolved) {
+    put_str(out, "{\"event\":\"");
+    put_str(out, instance_events[event]);
+    put(out, "\"", 1);
+    put_key(out, "instance");
+    put_json_string(out, resolved->instance);
+
+    if (event == OUTPUT_INSTANCE_UNRESOLVED) {
+        const char *separator = "";
+
+        put_key(out, "missing");
+        put(out, "[", 1);
+        if (resolved->srv == NULL) {
+            put_str(out, "\"SRV\"");
+            separator = ",";
+        }
+        if (resolved->txt == NULL) {
+            put_str(out, separator);
+            put_str(out, "\"TXT\"");
+            separator = ",";
+        }
+        if (resolved->srv != NULL && resolved->address_count == 0) {
+            put_str(out, separator);
+            put_str(out, "\"address\"");
+        }
+        put(out, "]", 1);
+    }
+    if (resolved->srv != NULL) {
+        put_key(out, "host");
+        put_json_string(out, resolved->target);
+        put_key(out, "port");
+        put_decimal(out, wire_read_u16(resolved->srv->rdata + 4));
+    }
+    if (resolved->address_count > 0) {
+        put_key(out, "addresses");
+        put(out, "[", 1);
+        for (size_t i = 0; i < resolved->address_count; i++) {
+            if (i != 0) {
+                put(out, ",", 1);
+            }
+            put_json_address(out, resolved->addresses[i]->rdata, resolved->addresses[i]->rdlen);
+        }
+        put(out, "]", 1);
+    }
+    if (resolved->txt != NULL) {
+        put_json_txt(out, resolved->txt->rdata, resolved->txt->rdlen);
+    }
+    put(out, "}\n", 2);
+}
+
+static void binary_instance(browse_output_t *out, output_instance_event_t event,
+                            const resolved_instance_t *resolved) {
+    size_t name_len = strlen(resolved->instance);
+    size_t host_len = strlen(resolved->target);
+    size_t body_len = 1 + 1 + 1 + name_len + 1 + host_len + 2 + 1 + 2;
+    uint16_t txt_len = resolved->txt != NULL ? resolved->txt->rdlen : 0;
+
+    for (size_t i = 0; i < resolved->address_count; i++) {
+        body_len += 1u + resolved->addresses[i]->rdlen;
+    }
+    body_len += txt_len;
+
+    put_u16(out, (uint16_t)body_len);
+    put_u8(out, 2);
+    put_u8(out, (uint8_t)event);
+    put_u8(out, (uint8_t)name_len);
+    put(out, resolved->instance, name_len);
+    put_u8(out, (uint8_t)host_len);
+    put(out, resolved->target, host_len);
+    put_u16(out, resolved->srv != NULL ? wire_read_u16(resolved->srv->rdata + 4) : 0);
+    put_u8(out, (uint8_t)resolved->address_count);
+    for (size_t i = 0; i < resolved->address_count; i++) {
+        put_u8(out, (uint8_t)resolved->addresses[i]->rdlen);
+        put(out, resolved->addresses[i]->rdata, resolved->addresses[i]->rdlen);
+    }
+    put_u16(out, txt_len);
+    if (txt_len > 0) {
+        put(out, resolved->txt->rdata, txt_len);
+    }
+}
+
+void browse_output_instance(browse_output_t *out, output_instance_event_t event,
+                            const resolved_instance_t *resolved) {
+    if (out->format == BROWSE_FORMAT_JSONL) {
+        json_instance(out, event, resolved);
+    } else if (out->format == BROWSE_FORMAT_BINARY) {
+        binary_instance(out, event, resolved);
+    }
+}
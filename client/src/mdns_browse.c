@@ -13,20 +13,35 @@
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
+#include <signal.h>
 #include <sys/select.h>
 #include <sys/socket.h>
-#include <sys/time.h>
+#include <time.h>
 #include <unistd.h>
 
+#include "browse_output.h"
 #include "log.h"
 #include "mdns.h"
+#include "record_cache.h"
+#include "resolver.h"
+#include "wire.h"
+
+#define BROWSE_MAX_TYPE_ARGS 64
+
+// DNS-SD service type enumeration (RFC 6763 section 9)
+#define SERVICE_ENUMERATION_NAME "_services._dns-sd._udp.local"
 
 typedef struct {
-    const char *service_type;
+    const char *service_types[BROWSE_MAX_TYPE_ARGS];   // -s arguments, each may be a comma list
+    size_t service_type_count;
+    int all_types;
     int timeout_seconds;
     const char *interface_name;
     int protocol_mode;
     int verbose;
+    int watch;
+    int resolve;
+    browse_format_t format;
     log_level_t verbosity;
 } browse_config_t;
 
@@ -36,31 +51,32 @@ enum {
     BROWSE_PROTOCOL_BOTH = 3
 };
 
-static uint16_t read_u16(const uint8_t *ptr) {
-    return (uint16_t)((ptr[0] << 8) | ptr[1]);
-}
-
-static uint32_t read_u32(const uint8_t *ptr) {
-    return ((uint32_t)ptr[0] << 24) | ((uint32_t)ptr[1] << 16) | ((uint32_t)ptr[2] << 8) | (uint32_t)ptr[3];
-}
-
+// Monotonic, so TTL timers survive wall-clock steps in watch mode
 static long now_ms(void) {
-    struct timeval tv;
-    if (gettimeofday(&tv, NULL) != 0) {
+    struct timespec ts;
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0) {
         return 0;
     }
-    return (long)(tv.tv_sec * 1000L) + (long)(tv.tv_usec / 1000L);
+    return (long)(ts.tv_sec * 1000L) + (long)(ts.tv_nsec / 1000000L);
 }
 
 static void print_usage(const char *progname) {
     fprintf(stderr,
             "mDNS Browser - Browse service instances by type\n\n"
-            "Usage: %s -s <service-type> [-w <seconds>] [-i <interface>] [-p ipv4|ipv6|both] [-v]\n\n"
+            "Usage: %s -s <service-type>[,<service-type>...] | -a [-w <seconds>] [-i <interface>]\n"
+            "       [-p ipv4|ipv6|both] [-W] [-r] [-f text|jsonl|binary] [-v]\n\n"
             "Options:\n"
-            "  -s, --service   Service type to browse (e.g. _http._tcp.local) [required]\n"
+            "  -s, --service   Service type(s) to browse (e.g. _http._tcp.local); repeat or\n"
+            "                  separate with commas, all are asked in one query packet\n"
+            "  -a, --all       Enumerate service types (_services._dns-sd._udp.local) and\n"
+            "                  browse every type found\n"
             "  -w, --timeout   Seconds to wait for responses (default: 2)\n"
             "  -i, --interface Network interface name (optional, e.g. eth0)\n"
             "  -p, --protocol  Browse protocol: ipv4|ipv6|both (default: both)\n"
+            "  -W, --watch     Keep running and print record add/remove/change events\n"
+            "                  (TTL-aware cache, RFC 6762 query schedule; -w is ignored)\n"
+            "  -r, --resolve   Follow up with SRV/TXT/A/AAAA queries and print resolved instances\n"
+            "  -f, --format    Output format: text|jsonl|binary (default: text)\n"
             "  -v, --verbose   Verbose output\n"
             "  -h, --help      Show this help\n",
             progname);
@@ -69,9 +85,13 @@ static void print_usage(const char *progname) {
 static int parse_args(int argc, char **argv, browse_config_t *cfg) {
     static struct option long_opts[] = {
         {"service", required_argument, 0, 's'},
+        {"all", no_argument, 0, 'a'},
         {"timeout", required_argument, 0, 'w'},
         {"interface", required_argument, 0, 'i'},
         {"protocol", required_argument, 0, 'p'},
+        {"watch", no_argument, 0, 'W'},
+        {"resolve", no_argument, 0, 'r'},
+        {"format", required_argument, 0, 'f'},
         {"verbose", no_argument, 0, 'v'},
         {"help", no_argument, 0, 'h'},
         {0, 0, 0, 0}
@@ -82,17 +102,28 @@ static int parse_args(int argc, char **argv, browse_config_t *cfg) {
         return -1;
     }
 
-    cfg->service_type = NULL;
+    cfg->service_type_count = 0;
+    cfg->all_types = 0;
     cfg->timeout_seconds = 2;
     cfg->interface_name = NULL;
     cfg->protocol_mode = BROWSE_PROTOCOL_BOTH;
     cfg->verbose = 0;
+    cfg->watch = 0;
+    cfg->resolve = 0;
+    cfg->format = BROWSE_FORMAT_TEXT;
     cfg->verbosity = APP_LOG_WARN;
 
-    while ((opt = getopt_long(argc, argv, "s:w:i:p:vh", long_opts, NULL)) != -1) {
+    while ((opt = getopt_long(argc, argv, "s:aw:i:p:Wrf:vh", long_opts, NULL)) != -1) {
         switch (opt) {
             case 's':
-                cfg->service_type = optarg;
+                if (cfg->service_type_count == BROWSE_MAX_TYPE_ARGS) {
+                    fprintf(stderr, "Too many -s options (max %d)\n", BROWSE_MAX_TYPE_ARGS);
+                    return -1;
+                }
+                cfg->service_types[cfg->service_type_count++] = optarg;
+                break;
+            case 'a':
+                cfg->all_types = 1;
                 break;
             case 'w': {
                 char *endptr = NULL;
@@ -119,6 +150,24 @@ static int parse_args(int argc, char **argv, browse_config_t *cfg) {
                     return -1;
                 }
                 break;
+            case 'W':
+                cfg->watch = 1;
+                break;
+            case 'r':
+                cfg->resolve = 1;
+                break;
+            case 'f':
+                if (strcmp(optarg, "text") == 0) {
+                    cfg->format = BROWSE_FORMAT_TEXT;
+                } else if (strcmp(optarg, "jsonl") == 0) {
+                    cfg->format = BROWSE_FORMAT_JSONL;
+                } else if (strcmp(optarg, "binary") == 0) {
+                    cfg->format = BROWSE_FORMAT_BINARY;
+                } else {
+                    fprintf(stderr, "Invalid format: %s\n", optarg);
+                    return -1;
+                }
+                break;
             case 'v':
                 cfg->verbose = 1;
                 cfg->verbosity = APP_LOG_DEBUG;
@@ -131,8 +180,8 @@ static int parse_args(int argc, char **argv, browse_config_t *cfg) {
         }
     }
 
-    if (cfg->service_type == NULL) {
-        fprintf(stderr, "Missing required service type\n");
+    if (cfg->service_type_count == 0 && !cfg->all_types) {
+        fprintf(stderr, "Missing required service type (or --all)\n");
         return -1;
     }
 
@@ -163,113 +212,113 @@ static int build_fqdn_service_type(const char *input, char *output, size_t outpu
     return 0;
 }
 
-static int encode_qname(const char *name, uint8_t *out, size_t out_len, size_t *written_out) {
-    const char *cursor = name;
-    size_t written = 0;
-
-    while (*cursor != '\0') {
-        const char *dot = strchr(cursor, '.');
-        size_t label_len = dot ? (size_t)(dot - cursor) : strlen(cursor);
+// Service types being browsed. With --all the list grows as the
+// enumeration PTR records name new types; queried marks how far the list
+// has been asked for.
+typedef struct {
+    char name[256];
+    uint8_t wire[256];      // uncompressed wire form, for matching owner names
+    size_t wire_len;
+} browse_type_t;
 
-        if (label_len == 0 || label_len > 63) {
-            return -1;
+typedef struct {
+    browse_type_t *entries;
+    size_t count;
+    size_t capacity;
+    size_t queried;
+} browse_types_t;
+
+static int find_browse_type_wire(const browse_types_t *types, const uint8_t *wire, size_t wire_len) {
+    for (size_t i = 0; i < types->count; i++) {
+        if (wire_names_equal(types->entries[i].wire, types->entries[i].wire_len, wire, wire_len)) {
+            return (int)i;
         }
-        if (written + 1 + label_len >= out_len) {
-            return -1;
+    }
+    return -1;
+}
+
+static int find_browse_type(const browse_types_t *types, const char *name) {
+    for (size_t i = 0; i < types->count; i++) {
+        if (strcasecmp(types->entries[i].name, name) == 0) {
+            return (int)i;
         }
+    }
+    return -1;
+}
 
-        out[written++] = (uint8_t)label_len;
-        memcpy(&out[written], cursor, label_len);
-        written += label_len;
+// Returns 1 if added, 0 if already present, -1 on error
+static int add_browse_type(browse_types_t *types, const char *name) {
+    browse_type_t *entry;
 
-        if (dot == NULL) {
-            break;
+    if (strlen(name) >= sizeof(entry->name)) {
+        return -1;
+    }
+    if (find_browse_type(types, name) >= 0) {
+        return 0;
+    }
+    if (types->count == types->capacity) {
+        size_t new_capacity = types->capacity == 0 ? 16 : types->capacity * 2;
+        browse_type_t *new_entries = realloc(types->entries, new_capacity * sizeof(browse_type_t));
+        if (new_entries == NULL) {
+            return -1;
         }
-        cursor = dot + 1;
+        types->entries = new_entries;
+        types->capacity = new_capacity;
     }
-
-    if (written >= out_len) {
+    entry = &types->entries[types->count];
+    if (wire_encode_name(name, entry->wire, sizeof(entry->wire), &entry->wire_len) != 0) {
         return -1;
     }
-
-    out[written++] = 0;
-    *written_out = written;
-    return 0;
+    snprintf(entry->name, sizeof(entry->name), "%s", name);
+    types->count++;
+    return 1;
 }
 
-static int decode_name(const uint8_t *packet, size_t packet_len, size_t offset,
-                       char *out, size_t out_len, size_t *next_offset) {
-    size_t pos = offset;
-    size_t out_pos = 0;
-    size_t jumps = 0;
-    int jumped = 0;
-    size_t local_next = offset;
-
-    if (packet == NULL || out == NULL || out_len == 0 || next_offset == NULL) {
+// Split each -s argument on commas into fully qualified types
+static int add_config_types(browse_types_t *types, const browse_config_t *cfg) {
+    if (cfg->all_types && add_browse_type(types, SERVICE_ENUMERATION_NAME) < 0) {
         return -1;
     }
+    for (size_t i = 0; i < cfg->service_type_count; i++) {
+        char list[1024];
+        char *saveptr = NULL;
 
-    while (pos < packet_len) {
-        uint8_t len = packet[pos];
-
-        if (len == 0) {
-            if (out_pos == 0) {
-                if (out_len < 2) {
-                    return -1;
-                }
-                out[0] = '.';
-                out[1] = '\0';
-            } else {
-                out[out_pos - 1] = '\0';
-            }
-
-            if (!jumped) {
-                local_next = pos + 1;
-            }
-            *next_offset = local_next;
-            return 0;
+        if (snprintf(list, sizeof(list), "%s", cfg->service_types[i]) >= (int)sizeof(list)) {
+            fprintf(stderr, "Service type list too long: %s\n", cfg->service_types[i]);
+            return -1;
         }
+        for (char *token = strtok_r(list, ",", &saveptr); token != NULL; token = strtok_r(NULL, ",", &saveptr)) {
+            char fqdn[256];
 
-        if ((len & 0xC0) == 0xC0) {
-            size_t ptr;
-            if (pos + 1 >= packet_len) {
+            if (build_fqdn_service_type(token, fqdn, sizeof(fqdn)) != 0 || add_browse_type(types, fqdn) < 0) {
+                fprintf(stderr, "Invalid service type: %s\n", token);
                 return -1;
             }
-            ptr = (size_t)(((len & 0x3F) << 8) | packet[pos + 1]);
-            if (ptr >= packet_len || jumps++ > packet_len) {
-                return -1;
-            }
-            if (!jumped) {
-                local_next = pos + 2;
-            }
-            pos = ptr;
-            jumped = 1;
-            continue;
-        }
-
-        if ((len & 0xC0) != 0) {
-            return -1;
-        }
-
-        pos++;
-        if (pos + len > packet_len) {
-            return -1;
-        }
-        if (out_pos + len + 1 >= out_len) {
-            return -1;
         }
+    }
+    if (types->count == 0) {
+        fprintf(stderr, "Missing required service type (or --all)\n");
+        return -1;
+    }
+    return 0;
+}
 
-        memcpy(&out[out_pos], &packet[pos], len);
-        out_pos += len;
-        out[out_pos++] = '.';
-        pos += len;
+// "a, b, c" for messages, cut short if it does not fit
+static const char *format_type_list(const browse_types_t *types, char *out, size_t out_len) {
+    size_t pos = 0;
 
-        if (!jumped) {
-            local_next = pos;
+    out[0] = '\0';
+    for (size_t i = 0; i < types->count; i++) {
+        int n = snprintf(&out[pos], out_len - pos, "%s%s", i == 0 ? "" : ", ", types->entries[i].name);
+        if (n < 0 || (size_t)n >= out_len - pos) {
+            if (out_len > 4) {
+                memcpy(&out[out_len - 4], "...", 4);
+            }
+            break;
         }
+        pos += (size_t)n;
     }
-
-    return -1;
+    return out;
 }
 
 static int open_browse_socket(const char *ifname, unsigned int *ifindex_out) {
@@ -441,29 +490,85 @@ static int open_browse_socket_v4(const char *ifname, unsigned int *ifindex_out)
     return fd;
 }
 
-static int send_ptr_query(int sockfd, const char *service_type_fqdn, unsigned int ifindex) {
-    uint8_t query_buf[MDNS_MAX_PACKET];
-    struct sockaddr_in6 mcast_addr;
-    size_t offset = 12;
-    size_t qname_len;
-
-    memset(query_buf, 0, sizeof(query_buf));
-    query_buf[4] = 0;
-    query_buf[5] = 1;
-
-    if (encode_qname(service_type_fqdn, &query_buf[offset], sizeof(query_buf) - offset, &qname_len) != 0) {
+// Largest query we send: one Ethernet frame after IPv6 and UDP headers
+#define BROWSE_QUERY_MAX (MDNS_MAX_PACKET - 48)
+#define BROWSE_MAX_QUESTIONS 64
+#define BROWSE_BATCH_MAX 256      // questions gathered per tick before packing
+#define KNOWN_ANSWERS_PER_QUESTION 64
+
+// Append one known answer; returns -1 (and leaves the writer as it was) if
+// it does not fit
+static int append_known_answer(wire_writer_t *writer, const cached_record_t *record, uint64_t now_ms) {
+    wire_mark_t mark = wire_writer_mark(writer);
+    uint32_t remaining = (uint32_t)((record->expires_ms - now_ms) / 1000u);
+    size_t rdlen_pos;
+
+    // The owner name compresses against its question; cached rdata is
+    // already uncompressed wire format
+    wire_begin_rr(writer, record->name, record->type, DNS_CLASS_IN, remaining, &rdlen_pos);
+    wire_put_bytes(writer, record->rdata, record->rdlen);
+    if (wire_end_rr(writer, rdlen_pos) != 0) {
+        wire_writer_rewind(writer, mark);
         return -1;
     }
-    offset += qname_len;
+    return 0;
+}
+
+// Build one query from the front of the question list, packing in as many
+// questions as fit; *used gets how many. With a cache, every cached answer
+// to them that still has more than half its TTL left goes in the answer
+// section (RFC 6762 section 7.1), so responders skip what we already know.
+// Names are compressed, so types sharing "_tcp.local" and known answers
+// owned by a question name cost a pointer each. Known answers that do not
+// fit are left out; those records are re-sent.
+// Returns the packet length or -1.
+static int build_browse_query(uint8_t *buf, const dns_question_t *questions, size_t count, size_t *used,
+                              const record_cache_t *cache, uint64_t now_ms) {
+    wire_writer_t writer;
+    uint16_t ancount = 0;
+    size_t packed = 0;
+
+    wire_writer_init(&writer, buf, BROWSE_QUERY_MAX, 1);
+    wire_put_header(&writer, 0, 0);
+
+    while (packed < count) {
+        wire_mark_t mark = wire_writer_mark(&writer);
+
+        if (wire_put_question(&writer, questions[packed].name, questions[packed].qtype, DNS_CLASS_IN) != 0) {
+            if (packed == 0) {
+                return -1;
+            }
+            wire_writer_rewind(&writer, mark);
+            break;
+        }
+        packed++;
+    }
+    wire_patch_u16(&writer, 4, (uint16_t)packed);
+    *used = packed;
 
-    if (offset + 4 > sizeof(query_buf)) {
-        return -1;
+    for (size_t i = 0; cache != NULL && i < packed; i++) {
+        const cached_record_t *known[KNOWN_ANSWERS_PER_QUESTION];
+        size_t known_count = record_cache_lookup(cache, questions[i].name, questions[i].qtype, known,
+                                                 KNOWN_ANSWERS_PER_QUESTION);
+
+        for (size_t k = 0; k < known_count; k++) {
+            if (known[k]->expires_ms <= now_ms ||
+                (known[k]->expires_ms - now_ms) * 2u <= (uint64_t)known[k]->ttl * 1000u) {
+                continue;
+            }
+            if (append_known_answer(&writer, known[k], now_ms) != 0) {
+                break;
+            }
+            ancount++;
+        }
     }
 
-    query_buf[offset++] = 0;
-    query_buf[offset++] = DNS_TYPE_PTR;
-    query_buf[offset++] = 0;
-    query_buf[offset++] = DNS_CLASS_IN;
+    wire_patch_u16(&writer, 6, ancount);
+    return wire_writer_finish(&writer);
+}
+
+static int send_query(int sockfd, const uint8_t *packet, size_t len, unsigned int ifindex) {
+    struct sockaddr_in6 mcast_addr;
 
     memset(&mcast_addr, 0, sizeof(mcast_addr));
     mcast_addr.sin6_family = AF_INET6;
@@ -473,36 +578,15 @@ static int send_ptr_query(int sockfd, const char *service_type_fqdn, unsigned in
         return -1;
     }
 
-    if (sendto(sockfd, query_buf, offset, 0, (struct sockaddr *)&mcast_addr, sizeof(mcast_addr)) < 0) {
+    if (sendto(sockfd, packet, len, 0, (struct sockaddr *)&mcast_addr, sizeof(mcast_addr)) < 0) {
         return -1;
     }
 
     return 0;
 }
 
-static int send_ptr_query_v4(int sockfd, const char *service_type_fqdn) {
-    uint8_t query_buf[MDNS_MAX_PACKET];
+static int send_query_v4(int sockfd, const uint8_t *packet, size_t len) {
     struct sockaddr_in mcast_addr;
-    size_t offset = 12;
-    size_t qname_len;
-
-    memset(query_buf, 0, sizeof(query_buf));
-    query_buf[4] = 0;
-    query_buf[5] = 1;
-
-    if (encode_qname(service_type_fqdn, &query_buf[offset], sizeof(query_buf) - offset, &qname_len) != 0) {
-        return -1;
-    }
-    offset += qname_len;
-
-    if (offset + 4 > sizeof(query_buf)) {
-        return -1;
-    }
-
-    query_buf[offset++] = 0;
-    query_buf[offset++] = DNS_TYPE_PTR;
-    query_buf[offset++] = 0;
-    query_buf[offset++] = DNS_CLASS_IN;
 
     memset(&mcast_addr, 0, sizeof(mcast_addr));
     mcast_addr.sin_family = AF_INET;
@@ -511,7 +595,7 @@ static int send_ptr_query_v4(int sockfd, const char *service_type_fqdn) {
         return -1;
     }
 
-    if (sendto(sockfd, query_buf, offset, 0, (struct sockaddr *)&mcast_addr, sizeof(mcast_addr)) < 0) {
+    if (sendto(sockfd, packet, len, 0, (struct sockaddr *)&mcast_addr, sizeof(mcast_addr)) < 0) {
         return -1;
     }
 
@@ -547,122 +631,510 @@ static int parse_txt_strings(const uint8_t *rdata, size_t rdlen, char *out, size
     return 0;
 }
 
-static int print_response_records(const uint8_t *packet, size_t packet_len,
-                                  const char *src_ip,
-                                  const char *service_type_fqdn) {
-    uint16_t qdcount;
-    uint16_t ancount;
-    uint16_t nscount;
-    uint16_t arcount;
-    size_t offset = 12;
+// One record from a response, with compression pointers in its rdata
+// expanded so equal records compare equal byte for byte
+typedef struct {
+    char name[256];
+    uint16_t type;
+    int cache_flush;
+    uint32_t ttl;
+    uint16_t rdlen;
+    uint8_t rdata[MDNS_MAX_PACKET];
+} browse_record_t;
+
+// Returns 1 if the record was used, 0 if it was skipped
+typedef int (*record_fn)(void *user, const browse_record_t *record);
+
+static const char *record_type_name(uint16_t type) {
+    const char *name = mdns_type_name(type);
+    return name != NULL ? name : "?";
+}
+
+// Render the rdata of a browse record (as stored by walk_response_records)
+static int format_record_value(uint16_t type, const uint8_t *rdata, uint16_t rdlen,
+                               char *out, size_t out_len) {
+    char text[1024];
+    size_t ignored_next = 0;
+
+    switch (type) {
+        case DNS_TYPE_PTR:
+            if (wire_decode_name(rdata, rdlen, 0, text, sizeof(text), &ignored_next) < 0) {
+                return -1;
+            }
+            snprintf(out, out_len, "-> %s", text);
+            return 0;
+        case DNS_TYPE_SRV:
+            if (wire_decode_name(rdata, rdlen, 6, text, sizeof(text), &ignored_next) < 0) {
+                return -1;
+            }
+            snprintf(out, out_len, "port=%" PRIu16 " priority=%" PRIu16 " weight=%" PRIu16 " target=%s",
+                     wire_read_u16(rdata + 4), wire_read_u16(rdata), wire_read_u16(rdata + 2), text);
+            return 0;
+        case DNS_TYPE_TXT:
+            if (parse_txt_strings(rdata, rdlen, text, sizeof(text)) != 0) {
+                return -1;
+            }
+            snprintf(out, out_len, "\"%s\"", text);
+            return 0;
+        case DNS_TYPE_A:
+            return inet_ntop(AF_INET, rdata, out, (socklen_t)out_len) != NULL ? 0 : -1;
+        case DNS_TYPE_AAAA:
+            return inet_ntop(AF_INET6, rdata, out, (socklen_t)out_len) != NULL ? 0 : -1;
+        default:
+            return -1;
+    }
+}
+
+// Walk every resource record of a response once and hand the
+// browse-relevant ones (PTR for any browsed type, any SRV/TXT/A/AAAA) to fn.
+// Other records are skipped without decoding their names, and PTR owners
+// are matched in wire form; only records passed on get a text owner name.
+// Returns the number of records fn used, or -1 on a malformed packet.
+static int walk_response_records(const uint8_t *packet, size_t packet_len,
+                                 const browse_types_t *types, record_fn fn, void *user) {
+    // The browser is single-threaded; the memo table is reused across packets
+    static wire_name_decoder_t decoder;
+    wire_reader_t reader;
+    wire_header_t header;
     uint32_t rr_total;
-    uint32_t printed = 0;
-    if (packet == NULL || src_ip == NULL || service_type_fqdn == NULL || packet_len < 12) {
+    int used = 0;
+    browse_record_t record;
+
+    if (packet == NULL || types == NULL || wire_name_decoder_reset(&decoder, packet, packet_len) != 0) {
         return -1;
     }
 
-    qdcount = read_u16(&packet[4]);
-    ancount = read_u16(&packet[6]);
-    nscount = read_u16(&packet[8]);
-    arcount = read_u16(&packet[10]);
+    wire_reader_init(&reader, packet, packet_len);
+    if (wire_read_header(&reader, &header) != 0) {
+        return -1;
+    }
+    rr_total = (uint32_t)header.ancount + header.nscount + header.arcount;
 
-    for (uint16_t i = 0; i < qdcount; i++) {
-        char qname[256];
-        size_t next_offset;
-        if (decode_name(packet, packet_len, offset, qname, sizeof(qname), &next_offset) != 0) {
-            return -1;
-        }
-        if (next_offset + 4 > packet_len) {
+    for (uint16_t i = 0; i < header.qdcount; i++) {
+        size_t name_offset;
+        uint16_t qtype;
+        uint16_t qclass;
+
+        if (wire_read_question(&reader, &name_offset, &qtype, &qclass) != 0) {
             return -1;
         }
-        offset = next_offset + 4;
     }
 
-    rr_total = (uint32_t)ancount + (uint32_t)nscount + (uint32_t)arcount;
     for (uint32_t i = 0; i < rr_total; i++) {
-        char name[256];
-        size_t next_offset;
-        uint16_t type;
-        uint32_t ttl;
-        uint16_t rdlen;
-        const uint8_t *rdata;
-
-        if (decode_name(packet, packet_len, offset, name, sizeof(name), &next_offset) != 0) {
+        wire_rr_t rr;
+        uint8_t owner[WIRE_NAME_MAX];
+        size_t owner_len = 0;
+        size_t written = 0;
+        int keep = 0;
+
+        if (wire_read_rr(&reader, &rr) != 0) {
             return -1;
         }
-        if (next_offset + 10 > packet_len) {
+        if (rr.type != DNS_TYPE_PTR && rr.type != DNS_TYPE_SRV && rr.type != DNS_TYPE_TXT &&
+            rr.type != DNS_TYPE_A && rr.type != DNS_TYPE_AAAA) {
+            continue;
+        }
+        if (wire_name_decoder_expand(&decoder, rr.name_offset, owner, &owner_len) != 0) {
             return -1;
         }
 
-        type = read_u16(&packet[next_offset]);
-        ttl = read_u32(&packet[next_offset + 4]);
-        rdlen = read_u16(&packet[next_offset + 8]);
-        offset = next_offset + 10;
+        if (rr.type == DNS_TYPE_PTR) {
+            keep = find_browse_type_wire(types, owner, owner_len) >= 0 &&
+                   wire_name_decoder_expand(&decoder, rr.rdata_offset, record.rdata, &written) == 0;
+        } else if (rr.type == DNS_TYPE_SRV && rr.rdlen >= 6) {
+            memcpy(record.rdata, &packet[rr.rdata_offset], 6);
+            keep = wire_name_decoder_expand(&decoder, rr.rdata_offset + 6, record.rdata + 6, &written) == 0;
+            written += 6;
+        } else if (rr.type == DNS_TYPE_TXT || (rr.type == DNS_TYPE_A && rr.rdlen == 4) ||
+                   (rr.type == DNS_TYPE_AAAA && rr.rdlen == 16)) {
+            memcpy(record.rdata, &packet[rr.rdata_offset], rr.rdlen);
+            written = rr.rdlen;
+            keep = 1;
+        }
 
-        if (offset + rdlen > packet_len) {
-            return -1;
+        if (keep && wire_name_to_text(owner, owner_len, record.name, sizeof(record.name)) == 0) {
+            record.type = rr.type;
+            record.cache_flush = (rr.rrclass & DNS_CLASS_CACHE_FLUSH) != 0;
+            record.ttl = rr.ttl;
+            record.rdlen = (uint16_t)written;
+            used += fn(user, &record);
         }
+    }
 
-        rdata = &packet[offset];
+    return used;
+}
 
-        if (type == DNS_TYPE_PTR) {
-            char ptr_name[256];
-            size_t ignored_next = 0;
-            if (decode_name(packet, packet_len, offset, ptr_name, sizeof(ptr_name), &ignored_next) == 0 &&
-                strcasecmp(name, service_type_fqdn) == 0) {
-                if (printed == 0) {
-                    printf("Response from %s\n", src_ip);
-                }
-                printf("  PTR %s -> %s (ttl=%" PRIu32 ")\n", name, ptr_name, ttl);
-                printed++;
-            }
-        } else if (type == DNS_TYPE_SRV && rdlen >= 6) {
-            uint16_t priority = read_u16(rdata);
-            uint16_t weight = read_u16(rdata + 2);
-            uint16_t port = read_u16(rdata + 4);
-            char target[256];
-            size_t ignored_next = 0;
-            if (decode_name(packet, packet_len, offset + 6, target, sizeof(target), &ignored_next) == 0) {
-                if (printed == 0) {
-                    printf("Response from %s\n", src_ip);
-                }
-                printf("  SRV %s port=%" PRIu16 " priority=%" PRIu16 " weight=%" PRIu16 " target=%s (ttl=%" PRIu32 ")\n",
-                       name, port, priority, weight, target, ttl);
-                printed++;
-            }
-        } else if (type == DNS_TYPE_TXT) {
-            char txt_buf[1024];
-            if (parse_txt_strings(rdata, rdlen, txt_buf, sizeof(txt_buf)) == 0) {
-                if (printed == 0) {
-                    printf("Response from %s\n", src_ip);
-                }
-                printf("  TXT %s \"%s\" (ttl=%" PRIu32 ")\n", name, txt_buf, ttl);
-                printed++;
-            }
-        } else if (type == DNS_TYPE_A && rdlen == 4) {
-            char ip[INET_ADDRSTRLEN];
-            if (inet_ntop(AF_INET, rdata, ip, sizeof(ip)) != NULL) {
-                if (printed == 0) {
-                    printf("Response from %s\n", src_ip);
-                }
-                printf("  A %s %s (ttl=%" PRIu32 ")\n", name, ip, ttl);
-                printed++;
-            }
-        } else if (type == DNS_TYPE_AAAA && rdlen == 16) {
-            char ip6[INET6_ADDRSTRLEN];
-            if (inet_ntop(AF_INET6, rdata, ip6, sizeof(ip6)) != NULL) {
-                if (printed == 0) {
-                    printf("Response from %s\n", src_ip);
-                }
-                printf("  AAAA %s %s (ttl=%" PRIu32 ")\n", name, ip6, ttl);
-                printed++;
+// With --all, an enumeration PTR names a service type to browse next.
+// Returns 1 if the type is new, 0 if not an enumeration record or known,
+// -1 on error.
+static int note_service_type(browse_types_t *types, const char *owner, uint16_t type,
+                             const uint8_t *rdata, uint16_t rdlen) {
+    char service_type[256];
+    size_t ignored_next = 0;
+
+    if (type != DNS_TYPE_PTR || strcasecmp(owner, SERVICE_ENUMERATION_NAME) != 0) {
+        return 0;
+    }
+    if (wire_decode_name(rdata, rdlen, 0, service_type, sizeof(service_type), &ignored_next) < 0) {
+        return 0;
+    }
+    return add_browse_type(types, service_type);
+}
+
+// One-shot printing of a single response
+typedef struct {
+    const char *src_ip;
+    const uint8_t *source;         // src_ip as 4 or 16 address bytes
+    size_t source_len;
+    int printed;
+    browse_types_t *types;
+    browse_output_t *output;       // NULL for text
+    int enumerate;                 // --all: learn types from enumeration PTRs
+    int failed;
+} print_ctx_t;
+
+static int print_record(void *user, const browse_record_t *record) {
+    print_ctx_t *ctx = user;
+    char value[1100];
+
+    if (format_record_value(record->type, record->rdata, record->rdlen, value, sizeof(value)) != 0) {
+        return 0;
+    }
+    if (ctx->output != NULL) {
+        browse_output_record(ctx->output, OUTPUT_RECORD_SEEN, ctx->source, ctx->source_len, record->name,
+                             record->type, record->ttl, record->rdata, record->rdlen);
+    } else {
+        if (ctx->printed++ == 0) {
+            printf("Response from %s\n", ctx->src_ip);
+        }
+        printf("  %s %s %s (ttl=%" PRIu32 ")\n", record_type_name(record->type), record->name, value,
+               record->ttl);
+    }
+    if (ctx->enumerate &&
+        note_service_type(ctx->types, record->name, record->type, record->rdata, record->rdlen) < 0) {
+        ctx->failed = 1;
+    }
+    return 1;
+}
+
+// RFC 6762 section 5.2: continuous querying starts one second apart and
+// doubles up to one hour
+#define QUERY_INTERVAL_FIRST_MS 1000
+#define QUERY_INTERVAL_MAX_MS 3600000
+
+// Follow-up questions wait until responses have been quiet this long (or a
+// tick has passed), so one burst of answers yields one batch of questions
+#define BROWSE_SETTLE_MS 20
+
+// Browse state; the cache is only used in watch and resolve modes
+typedef struct {
+    record_cache_t *cache;         // NULL for one-shot printing
+    resolver_t *resolver;          // NULL unless resolving
+    browse_types_t types;
+    int enumerate;                 // --all
+    browse_output_t *output;       // NULL for text output
+    int watch;
+    uint64_t now_ms;
+    int failed;
+    int need_ptr;                  // every browse PTR question is due
+    dns_question_t pending[BROWSE_MAX_QUESTIONS];   // other records to refresh
+    size_t pending_count;
+    uint64_t next_query_ms;
+    uint64_t query_interval_ms;
+    int resolved;                  // instances reported complete
+    dns_question_t batch[BROWSE_BATCH_MAX];
+} browse_ctx_t;
+
+// Queue a refresh question for a cached record (deduplicated)
+static void queue_refresh(browse_ctx_t *ctx, const cached_record_t *record) {
+    for (size_t i = 0; i < ctx->pending_count; i++) {
+        if (ctx->pending[i].qtype == record->type && strcasecmp(ctx->pending[i].name, record->name) == 0) {
+            return;
+        }
+    }
+    // Out of room: re-ask every browse question instead
+    if (ctx->pending_count == BROWSE_MAX_QUESTIONS) {
+        ctx->need_ptr = 1;
+        return;
+    }
+    snprintf(ctx->pending[ctx->pending_count].name, sizeof(ctx->pending[0].name), "%s", record->name);
+    ctx->pending[ctx->pending_count].qtype = record->type;
+    ctx->pending[ctx->pending_count].qclass = DNS_CLASS_IN;
+    ctx->pending_count++;
+}
+
+static int cache_record(void *user, const browse_record_t *record) {
+    browse_ctx_t *ctx = user;
+
+    if (record_cache_update(ctx->cache, record->name, record->type, record->cache_flush,
+                            record->rdata, record->rdlen, record->ttl, ctx->now_ms) != 0) {
+        ctx->failed = 1;
+        return 0;
+    }
+    return 1;
+}
+
+// "<instance> host=<target> port=<port> addresses=<a,b> txt=<"...">"
+static void print_instance(const char *prefix, const resolved_instance_t *resolved) {
+    char value[1100];
+    char address[INET6_ADDRSTRLEN];
+
+    printf("%s%s host=%s port=%" PRIu16 " addresses=", prefix, resolved->instance, resolved->target,
+           wire_read_u16(resolved->srv->rdata + 4));
+    for (size_t i = 0; i < resolved->address_count; i++) {
+        const cached_record_t *record = resolved->addresses[i];
+        if (format_record_value(record->type, record->rdata, record->rdlen, address, sizeof(address)) == 0) {
+            printf("%s%s", i == 0 ? "" : ",", address);
+        }
+    }
+    if (format_record_value(DNS_TYPE_TXT, resolved->txt->rdata, resolved->txt->rdlen, value, sizeof(value)) != 0) {
+        value[0] = '\0';
+    }
+    printf(" txt=%s\n", value);
+}
+
+static void on_instance_report(void *user, int state, const resolved_instance_t *resolved) {
+    browse_ctx_t *ctx = user;
+
+    if (state == 0) {
+        ctx->resolved++;
+    }
+    if (ctx->output != NULL) {
+        output_instance_event_t event = state == 0   ? OUTPUT_INSTANCE_RESOLVED
+                                        : state == 1 ? OUTPUT_INSTANCE_CHANGED
+                                        : ctx->watch ? OUTPUT_INSTANCE_REMOVED
+                                                     : OUTPUT_INSTANCE_UNRESOLVED;
+        browse_output_instance(ctx->output, event, resolved);
+        return;
+    }
+
+    if (state >= 0) {
+        print_instance(!ctx->watch ? "Resolved " : state == 0 ? "+ " : "~ ", resolved);
+        return;
+    }
+
+    if (ctx->watch) {
+        printf("- %s\n", resolved->instance);
+    } else {
+        printf("Unresolved %s (missing%s%s%s)\n", resolved->instance,
+               resolved->srv == NULL ? " SRV" : "", resolved->txt == NULL ? " TXT" : "",
+               resolved->srv != NULL && resolved->address_count == 0 ? " address" : "");
+    }
+}
+
+// Browse PTR records name the instances the resolver follows
+static void track_instance(browse_ctx_t *ctx, record_event_t event, const cached_record_t *record) {
+    char instance[256];
+    size_t ignored_next = 0;
+
+    if (record->type != DNS_TYPE_PTR || find_browse_type(&ctx->types, record->name) < 0 ||
+        strcasecmp(record->name, SERVICE_ENUMERATION_NAME) == 0 ||
+        wire_decode_name(record->rdata, record->rdlen, 0, instance, sizeof(instance), &ignored_next) < 0) {
+        return;
+    }
+    if (event == RECORD_REMOVED) {
+        resolver_remove_instance(ctx->resolver, instance, ctx->watch ? on_instance_report : NULL, ctx);
+    } else if (resolver_add_instance(ctx->resolver, instance) != 0) {
+        ctx->failed = 1;
+    }
+}
+
+// Watch mode prints state changes only: "+" added, "-" removed, "~" changed
+static void on_record_event(void *user, record_event_t event, const cached_record_t *record,
+                            const cached_record_t *previous) {
+    browse_ctx_t *ctx = user;
+    char value[1100];
+    char old_value[1100];
+
+    if (event == RECORD_REFRESH) {
+        if (ctx->watch) {
+            queue_refresh(ctx, record);
+        }
+        return;
+    }
+
+    if (ctx->enumerate && event != RECORD_REMOVED &&
+        note_service_type(&ctx->types, record->name, record->type, record->rdata, record->rdlen) < 0) {
+        ctx->failed = 1;
+    }
+
+    if (ctx->resolver != NULL) {
+        if (event == RECORD_CHANGED) {
+            track_instance(ctx, RECORD_REMOVED, previous);
+        }
+        track_instance(ctx, event, record);
+        return;
+    }
+
+    if (ctx->output != NULL) {
+        output_record_event_t output_event = event == RECORD_ADDED     ? OUTPUT_RECORD_ADDED
+                                             : event == RECORD_REMOVED ? OUTPUT_RECORD_REMOVED
+                                                                       : OUTPUT_RECORD_CHANGED;
+        browse_output_record(ctx->output, output_event, NULL, 0, record->name, record->type, record->ttl,
+                             record->rdata, record->rdlen);
+        return;
+    }
+
+    if (format_record_value(record->type, record->rdata, record->rdlen, value, sizeof(value)) != 0) {
+        snprintf(value, sizeof(value), "<%" PRIu16 " bytes>", record->rdlen);
+    }
+
+    switch (event) {
+        case RECORD_ADDED:
+            printf("+ %s %s %s (ttl=%" PRIu32 ")\n", record_type_name(record->type), record->name,
+                   value, record->ttl);
+            break;
+        case RECORD_REMOVED:
+            printf("- %s %s %s\n", record_type_name(record->type), record->name, value);
+            break;
+        case RECORD_CHANGED:
+            if (format_record_value(previous->type, previous->rdata, previous->rdlen, old_value,
+                                    sizeof(old_value)) != 0) {
+                snprintf(old_value, sizeof(old_value), "<%" PRIu16 " bytes>", previous->rdlen);
             }
+            printf("~ %s %s %s (ttl=%" PRIu32 ", was %s)\n", record_type_name(record->type),
+                   record->name, value, record->ttl, old_value);
+            break;
+        default:
+            break;
+    }
+}
+
+static volatile sig_atomic_t g_running = 1;
+
+static void on_signal(int signo) {
+    (void)signo;
+    g_running = 0;
+}
+
+// Send the questions on every open socket, as few packets as they fit in
+static int send_browse_queries(int sockfd4, int sockfd6, unsigned int ifindex6,
+                               const dns_question_t *questions, size_t count,
+                               const record_cache_t *cache, uint64_t now_ms) {
+    uint8_t packet[BROWSE_QUERY_MAX];
+    size_t sent = 0;
+
+    while (sent < count) {
+        size_t used = 0;
+        int len = build_browse_query(packet, &questions[sent], count - sent, &used, cache, now_ms);
+
+        if (len < 0) {
+            log_error("Failed to build query for %s", questions[sent].name);
+            return -1;
+        }
+
+        if (sockfd4 >= 0 && send_query_v4(sockfd4, packet, (size_t)len) != 0) {
+            log_error("Failed to send IPv4 query: %s", strerror(errno));
+            return -1;
         }
 
-        offset += rdlen;
+        if (sockfd6 >= 0 && send_query(sockfd6, packet, (size_t)len, ifindex6) != 0) {
+            log_error("Failed to send IPv6 query: %s", strerror(errno));
+            return -1;
+        }
+        sent += used;
     }
 
-    return (int)printed;
+    return 0;
+}
+
+// Send whatever is due this tick in one batch: the PTR question of every
+// browsed type on the continuous-query backoff, of types --all just found,
+// per-record refresh questions, and the resolver's SRV/TXT/address follow-ups
+static int send_due_queries(browse_ctx_t *ctx, int sockfd4, int sockfd6, unsigned int ifindex6) {
+    dns_question_t *questions = ctx->batch;
+    size_t count = 0;
+    size_t i;
+
+    if (ctx->watch && ctx->now_ms >= ctx->next_query_ms) {
+        ctx->need_ptr = 1;
+        ctx->next_query_ms = ctx->now_ms + ctx->query_interval_ms;
+        ctx->query_interval_ms *= 2;
+        if (ctx->query_interval_ms > QUERY_INTERVAL_MAX_MS) {
+            ctx->query_interval_ms = QUERY_INTERVAL_MAX_MS;
+        }
+    }
+
+    if (ctx->need_ptr) {
+        ctx->types.queried = 0;
+    }
+    // Types that do not fit wait for the next tick
+    for (i = ctx->types.queried; i < ctx->types.count && count < BROWSE_BATCH_MAX - BROWSE_MAX_QUESTIONS; i++) {
+        snprintf(questions[count].name, sizeof(questions[count].name), "%s", ctx->types.entries[i].name);
+        questions[count].qtype = DNS_TYPE_PTR;
+        questions[count].qclass = DNS_CLASS_IN;
+        count++;
+    }
+    ctx->types.queried = i;
+    memcpy(&questions[count], ctx->pending, ctx->pending_count * sizeof(ctx->pending[0]));
+    count += ctx->pending_count;
+    ctx->need_ptr = 0;
+    ctx->pending_count = 0;
+
+    for (;;) {
+        if (ctx->resolver != NULL) {
+            count = resolver_collect_questions(ctx->resolver, ctx->now_ms, questions, count, BROWSE_BATCH_MAX);
+        }
+        if (count == 0) {
+            return 0;
+        }
+        log_debug("Sending %zu question(s), %zu record(s) cached", count,
+                  ctx->cache != NULL ? record_cache_count(ctx->cache) : 0u);
+        if (send_browse_queries(sockfd4, sockfd6, ifindex6, questions, count, ctx->cache, ctx->now_ms) != 0) {
+            return -1;
+        }
+        // A full batch may have left instances waiting
+        if (count < BROWSE_BATCH_MAX - 4) {
+            return 0;
+        }
+        count = 0;
+    }
+}
+
+// Read one datagram and print it, or feed it to the record cache.
+// Returns the number of records used, 0 on a read error.
+static int handle_datagram(int sockfd, int family, browse_ctx_t *ctx) {
+    uint8_t packet[MDNS_MAX_PACKET];
+    struct sockaddr_storage src_addr;
+    socklen_t src_len = sizeof(src_addr);
+    ssize_t nread;
+    int used;
+    char src_ip[INET6_ADDRSTRLEN];
+    const void *addr;
+    print_ctx_t print_ctx;
+
+    nread = recvfrom(sockfd, packet, sizeof(packet), 0, (struct sockaddr *)&src_addr, &src_len);
+    if (nread < 0) {
+        log_warn("recvfrom() failed: %s", strerror(errno));
+        return 0;
+    }
+
+    if (ctx->cache != NULL) {
+        ctx->now_ms = (uint64_t)now_ms();
+        used = walk_response_records(packet, (size_t)nread, &ctx->types, cache_record, ctx);
+        return used > 0 ? used : 0;
+    }
+
+    addr = family == AF_INET ? (const void *)&((const struct sockaddr_in *)&src_addr)->sin_addr
+                             : (const void *)&((const struct sockaddr_in6 *)&src_addr)->sin6_addr;
+    if (inet_ntop(family, addr, src_ip, sizeof(src_ip)) == NULL) {
+        strncpy(src_ip, "<unknown>", sizeof(src_ip));
+        src_ip[sizeof(src_ip) - 1] = '\0';
+    }
+
+    print_ctx.src_ip = src_ip;
+    print_ctx.source = addr;
+    print_ctx.source_len = family == AF_INET ? 4u : 16u;
+    print_ctx.printed = 0;
+    print_ctx.types = &ctx->types;
+    print_ctx.output = ctx->output;
+    print_ctx.enumerate = ctx->enumerate;
+    print_ctx.failed = 0;
+    used = walk_response_records(packet, (size_t)nread, &ctx->types, print_record, &print_ctx);
+    if (print_ctx.failed) {
+        ctx->failed = 1;
+    }
+    return used > 0 ? used : 0;
 }
 
 int main(int argc, char **argv) {
@@ -671,25 +1143,61 @@ int main(int argc, char **argv) {
     int sockfd6 = -1;
     unsigned int ifindex4 = 0;
     unsigned int ifindex6 = 0;
-    char service_type_fqdn[256];
+    char type_list[512];
     long deadline_ms;
+    long next_batch_ms = 0;
+    long next_flush_ms = 0;
+    int batch_pending = 0;
     int total_records = 0;
+    int exit_code = 1;
+    browse_ctx_t ctx;
+    static browse_output_t output;
 
     if (parse_args(argc, argv, &cfg) != 0) {
         print_usage(argv[0]);
         return 1;
     }
 
-    if (build_fqdn_service_type(cfg.service_type, service_type_fqdn, sizeof(service_type_fqdn)) != 0) {
-        fprintf(stderr, "Invalid service type: %s\n", cfg.service_type);
+    memset(&ctx, 0, sizeof(ctx));
+    if (add_config_types(&ctx.types, &cfg) != 0) {
+        free(ctx.types.entries);
         return 1;
     }
+    format_type_list(&ctx.types, type_list, sizeof(type_list));
 
     if (log_init(cfg.verbosity, 0) != 0) {
         fprintf(stderr, "Failed to initialize logging\n");
+        free(ctx.types.entries);
         return 1;
     }
 
+    ctx.enumerate = cfg.all_types;
+    if (cfg.format != BROWSE_FORMAT_TEXT) {
+        browse_output_init(&output, cfg.format, STDOUT_FILENO);
+        ctx.output = &output;
+    }
+    ctx.watch = cfg.watch;
+    ctx.query_interval_ms = QUERY_INTERVAL_FIRST_MS;
+    if (cfg.watch || cfg.resolve) {
+        ctx.cache = record_cache_create(on_record_event, &ctx, (uint64_t)now_ms());
+        if (ctx.cache == NULL || (cfg.resolve && (ctx.resolver = resolver_create(ctx.cache)) == NULL)) {
+            log_error("Failed to allocate record cache");
+            goto cleanup;
+        }
+    }
+    if (cfg.watch) {
+        struct sigaction sa;
+
+        srand((unsigned int)getpid() ^ (unsigned int)now_ms());
+
+        // No SA_RESTART: select() returns EINTR and the loop sees g_running
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = on_signal;
+        sigemptyset(&sa.sa_mask);
+        sigaction(SIGINT, &sa, NULL);
+        sigaction(SIGTERM, &sa, NULL);
+    }
+
     if (cfg.protocol_mode == BROWSE_PROTOCOL_IPV4 || cfg.protocol_mode == BROWSE_PROTOCOL_BOTH) {
         sockfd4 = open_browse_socket_v4(cfg.interface_name, &ifindex4);
         if (sockfd4 < 0) {
@@ -698,8 +1206,7 @@ int main(int argc, char **argv) {
             } else {
                 log_error("Failed to open IPv4 browse socket");
             }
-            log_close();
-            return 1;
+            goto cleanup;
         }
     }
 
@@ -711,67 +1218,64 @@ int main(int argc, char **argv) {
             } else {
                 log_error("Failed to open IPv6 browse socket (try --interface <ifname>)");
             }
-            if (sockfd4 >= 0) {
-                close(sockfd4);
-            }
-            log_close();
-            return 1;
+            goto cleanup;
         }
     }
 
     if (cfg.verbose) {
-        if (cfg.interface_name != NULL) {
-            log_info("Browsing service type %s on interface %s for %d second(s)",
-                     service_type_fqdn, cfg.interface_name, cfg.timeout_seconds);
+        if (cfg.watch) {
+            log_info("Watching service type(s) %s%s%s until interrupted", type_list,
+                     cfg.interface_name != NULL ? " on interface " : "",
+                     cfg.interface_name != NULL ? cfg.interface_name : "");
+        } else if (cfg.interface_name != NULL) {
+            log_info("Browsing service type(s) %s on interface %s for %d second(s)",
+                     type_list, cfg.interface_name, cfg.timeout_seconds);
         } else {
-            log_info("Browsing service type %s for %d second(s)",
-                     service_type_fqdn, cfg.timeout_seconds);
+            log_info("Browsing service type(s) %s for %d second(s)",
+                     type_list, cfg.timeout_seconds);
         }
     }
 
-    if (sockfd4 >= 0 && send_ptr_query_v4(sockfd4, service_type_fqdn) != 0) {
-        log_error("Failed to send IPv4 PTR query: %s", strerror(errno));
-        if (sockfd4 >= 0) {
-            close(sockfd4);
-        }
-        if (sockfd6 >= 0) {
-            close(sockfd6);
-        }
-        log_close();
-        return 1;
+    // Every PTR question goes out together, in as few packets as fit
+    ctx.now_ms = (uint64_t)now_ms();
+    if (send_due_queries(&ctx, sockfd4, sockfd6, ifindex6) != 0) {
+        goto cleanup;
     }
 
-    if (sockfd6 >= 0 && send_ptr_query(sockfd6, service_type_fqdn, ifindex6) != 0) {
-        log_error("Failed to send IPv6 PTR query: %s", strerror(errno));
-        if (sockfd4 >= 0) {
-            close(sockfd4);
-        }
-        if (sockfd6 >= 0) {
-            close(sockfd6);
+    // Machine formats carry records only
+    if (ctx.output == NULL) {
+        if (cfg.protocol_mode == BROWSE_PROTOCOL_IPV4) {
+            printf("Query sent (IPv4): PTR %s\n", type_list);
+        } else if (cfg.protocol_mode == BROWSE_PROTOCOL_IPV6) {
+            printf("Query sent (IPv6): PTR %s\n", type_list);
+        } else {
+            printf("Query sent (IPv4+IPv6): PTR %s\n", type_list);
         }
-        log_close();
-        return 1;
-    }
-
-    if (cfg.protocol_mode == BROWSE_PROTOCOL_IPV4) {
-        printf("Query sent (IPv4): PTR %s\n", service_type_fqdn);
-    } else if (cfg.protocol_mode == BROWSE_PROTOCOL_IPV6) {
-        printf("Query sent (IPv6): PTR %s\n", service_type_fqdn);
-    } else {
-        printf("Query sent (IPv4+IPv6): PTR %s\n", service_type_fqdn);
+        fflush(stdout);
     }
     deadline_ms = now_ms() + (long)cfg.timeout_seconds * 1000L;
 
-    for (;;) {
+    while (g_running) {
         long remaining_ms;
         fd_set rfds;
         struct timeval tv;
         int select_ret;
         int maxfd = -1;
 
-        remaining_ms = deadline_ms - now_ms();
-        if (remaining_ms <= 0) {
-            break;
+        if (cfg.watch) {
+            // Wake every wheel tick to run expiry and refresh timers
+            remaining_ms = RECORD_CACHE_TICK_MS;
+        } else {
+            remaining_ms = deadline_ms - now_ms();
+            if (remaining_ms <= 0) {
+                break;
+            }
+            if (ctx.cache != NULL && remaining_ms > RECORD_CACHE_TICK_MS) {
+                remaining_ms = RECORD_CACHE_TICK_MS;
+            }
+        }
+        if (batch_pending && remaining_ms > BROWSE_SETTLE_MS) {
+            remaining_ms = BROWSE_SETTLE_MS;
         }
 
         FD_ZERO(&rfds);
@@ -797,83 +1301,83 @@ int main(int argc, char **argv) {
 
         select_ret = select(maxfd + 1, &rfds, NULL, NULL, &tv);
         if (select_ret < 0) {
-            log_error("select() failed: %s", strerror(errno));
-            if (sockfd4 >= 0) {
-                close(sockfd4);
-            }
-            if (sockfd6 >= 0) {
-                close(sockfd6);
+            if (errno == EINTR) {
+                continue;
             }
-            log_close();
-            return 1;
+            log_error("select() failed: %s", strerror(errno));
+            goto cleanup;
         }
 
-        if (select_ret == 0) {
-            continue;
+        if (sockfd4 >= 0 && select_ret > 0 && FD_ISSET(sockfd4, &rfds)) {
+            total_records += handle_datagram(sockfd4, AF_INET, &ctx);
         }
-
-        if (sockfd4 >= 0 && FD_ISSET(sockfd4, &rfds)) {
-            uint8_t packet[MDNS_MAX_PACKET];
-            struct sockaddr_in src_addr;
-            socklen_t src_len = sizeof(src_addr);
-            ssize_t nread;
-            int printed;
-            char src_ip[INET_ADDRSTRLEN];
-
-            nread = recvfrom(sockfd4, packet, sizeof(packet), 0,
-                             (struct sockaddr *)&src_addr, &src_len);
-            if (nread < 0) {
-                log_warn("recvfrom() failed: %s", strerror(errno));
-            } else {
-                if (inet_ntop(AF_INET, &src_addr.sin_addr, src_ip, sizeof(src_ip)) == NULL) {
-                    strncpy(src_ip, "<unknown>", sizeof(src_ip));
-                    src_ip[sizeof(src_ip) - 1] = '\0';
-                }
-
-                printed = print_response_records(packet, (size_t)nread, src_ip, service_type_fqdn);
-                if (printed > 0) {
-                    total_records += printed;
-                }
-            }
+        if (sockfd6 >= 0 && select_ret > 0 && FD_ISSET(sockfd6, &rfds)) {
+            total_records += handle_datagram(sockfd6, AF_INET6, &ctx);
+        }
+        if (select_ret > 0) {
+            batch_pending = 1;
         }
 
-        if (sockfd6 >= 0 && FD_ISSET(sockfd6, &rfds)) {
-            uint8_t packet[MDNS_MAX_PACKET];
-            struct sockaddr_in6 src_addr;
-            socklen_t src_len = sizeof(src_addr);
-            ssize_t nread;
-            int printed;
-            char src_ip[INET6_ADDRSTRLEN];
-
-            nread = recvfrom(sockfd6, packet, sizeof(packet), 0,
-                             (struct sockaddr *)&src_addr, &src_len);
-            if (nread < 0) {
-                log_warn("recvfrom() failed: %s", strerror(errno));
-                continue;
+        // Without a cache only --all has follow-up questions (newly found types)
+        if ((ctx.cache != NULL || ctx.enumerate) && (select_ret == 0 || now_ms() >= next_batch_ms)) {
+            batch_pending = 0;
+            next_batch_ms = now_ms() + RECORD_CACHE_TICK_MS;
+            if (ctx.failed) {
+                log_warn("Out of memory; some records or service types were not tracked");
+                ctx.failed = 0;
             }
-
-            if (inet_ntop(AF_INET6, &src_addr.sin6_addr, src_ip, sizeof(src_ip)) == NULL) {
-                strncpy(src_ip, "<unknown>", sizeof(src_ip));
-                src_ip[sizeof(src_ip) - 1] = '\0';
+            ctx.now_ms = (uint64_t)now_ms();
+            if (ctx.cache != NULL) {
+                record_cache_expire(ctx.cache, ctx.now_ms);
+            }
+            if (ctx.resolver != NULL) {
+                resolver_report(ctx.resolver, on_instance_report, &ctx);
+            }
+            if (send_due_queries(&ctx, sockfd4, sockfd6, ifindex6) != 0) {
+                goto cleanup;
             }
+            fflush(stdout);
+        }
 
-            printed = print_response_records(packet, (size_t)nread, src_ip, service_type_fqdn);
-            if (printed > 0) {
-                total_records += printed;
+        // Structured output is written once per quiet period or tick
+        if (ctx.output != NULL && (select_ret == 0 || now_ms() >= next_flush_ms)) {
+            next_flush_ms = now_ms() + RECORD_CACHE_TICK_MS;
+            if (browse_output_flush(ctx.output) != 0) {
+                log_error("Failed to write output: %s", strerror(errno));
+                goto cleanup;
             }
         }
     }
 
-    if (total_records == 0) {
-        printf("No responses for %s within %d second(s)\n", service_type_fqdn, cfg.timeout_seconds);
+    if (cfg.watch) {
+        exit_code = 0;
+    } else if (ctx.resolver != NULL) {
+        resolver_report_unresolved(ctx.resolver, on_instance_report, &ctx);
+        if (ctx.resolved == 0 && ctx.output == NULL) {
+            printf("No instances of %s resolved within %d second(s)\n", type_list,
+                   cfg.timeout_seconds);
+        }
+        exit_code = ctx.resolved > 0 ? 0 : 1;
+    } else {
+        if (total_records == 0 && ctx.output == NULL) {
+            printf("No responses for %s within %d second(s)\n", type_list, cfg.timeout_seconds);
+        }
+        exit_code = total_records > 0 ? 0 : 1;
     }
 
+cleanup:
+    if (ctx.output != NULL && browse_output_flush(ctx.output) != 0) {
+        exit_code = 1;
+    }
     if (sockfd4 >= 0) {
         close(sockfd4);
     }
     if (sockfd6 >= 0) {
         close(sockfd6);
     }
+    resolver_destroy(ctx.resolver);
+    record_cache_destroy(ctx.cache);
+    free(ctx.types.entries);
     log_close();
-    return total_records > 0 ? 0 : 1;
-}
\ No newline at end of file
+    return exit_code;
+}
@@ -1,84 +1,114 @@
 #include <arpa/inet.h>
+#include <ctype.h>
+#include <errno.h>
+#include <inttypes.h>
 #include <net/if.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <sys/socket.h>
 #include <sys/select.h>
+#include <sys/un.h>
+#include <time.h>
 #include <unistd.h>
 
+#include "answer.h"
 #include "args.h"
+#include "batch.h"
 #include "hostdb.h"
 #include "log.h"
+#include "lookup.h"
 #include "mdns.h"
 
 #define MDNS_PORT 5353
 #define QUERY_TIMEOUT 1  // 1 second timeout for single query
 
-// Create and send a simple mDNS query
-static int send_mdns_query(int sockfd, const char *hostname, uint16_t qtype) {
-    uint8_t query_buf[MDNS_MAX_PACKET];
-    struct sockaddr_in6 mcast_addr;
-    size_t offset;
-    ssize_t sent;
+// Batch queries leave room for the IPv6 and UDP headers in a 1500-byte MTU.
+// After a burst, one packet goes out every BATCH_PACKET_MS, which stays
+// within mdns_server's per-source query budget (burst 20, 10/s).
+#define BATCH_QUERY_MAX (MDNS_MAX_PACKET - 48)
+#define BATCH_BURST 16
+#define BATCH_PACKET_MS 100
+#define BATCH_RCVBUF (1024 * 1024)
 
-    // Build query
-    memset(query_buf, 0, MDNS_MAX_PACKET);
-    
-    // ID = 0, QR = 0 (query), Standard query
-    query_buf[0] = 0;
-    query_buf[1] = 0;
-    query_buf[2] = 0;
-    query_buf[3] = 0;
-    query_buf[4] = 0;
-    query_buf[5] = 1;  // QDCOUNT = 1
-    
-    offset = 12;
-    
-    // Encode query name
-    const char *cursor = hostname;
-    while (*cursor != '\0') {
-        const char *dot = strchr(cursor, '.');
-        size_t label_len = dot ? (size_t)(dot - cursor) : strlen(cursor);
-        
-        if (label_len == 0 || label_len > 63) {
-            return -1;
-        }
-        if (offset + 1 + label_len >= MDNS_MAX_PACKET) {
-            return -1;
-        }
-        
-        query_buf[offset++] = (uint8_t)label_len;
-        memcpy(&query_buf[offset], cursor, label_len);
-        offset += label_len;
-        
-        if (dot == NULL) {
-            break;
-        }
-        cursor = dot + 1;
+static long now_ms(void) {
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0) {
+        return 0;
     }
-    
-    if (offset >= MDNS_MAX_PACKET) {
-        return -1;
+    return (long)ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+// What print_answer() needs to know about the query and the responder
+typedef struct {
+    const dns_question_t *questions;
+    size_t question_count;
+    batch_t *batch;    // batch mode: names are matched here instead
+    const char *source;
+    int header_printed;
+    int answered;      // an answer-section record of an asked type for an asked name
+    int denied;        // an answer-section NSEC for an asked name
+} response_state_t;
+
+// Case-insensitive, and "host.local." is "host.local"
+static int same_name(const char *a, const char *b) {
+    size_t a_len = strlen(a);
+    size_t b_len = strlen(b);
+
+    if (a_len > 0 && a[a_len - 1] == '.') {
+        a_len--;
     }
-    query_buf[offset++] = 0;  // Root label
-    
-    // Query type and class
-    if (offset + 4 > MDNS_MAX_PACKET) {
-        return -1;
+    if (b_len > 0 && b[b_len - 1] == '.') {
+        b_len--;
     }
-    query_buf[offset++] = (uint8_t)((qtype >> 8) & 0xFF);
-    query_buf[offset++] = (uint8_t)(qtype & 0xFF);
-    query_buf[offset++] = 0;  // Class IN
-    query_buf[offset++] = 1;
-    
+    return a_len == b_len && strncasecmp(a, b, a_len) == 0;
+}
+
+static int print_answer(void *user, const mdns_answer_t *answer) {
+    response_state_t *state = user;
+    char value[1024];
+
+    if (answer_format(answer, value, sizeof(value)) != 0) {
+        return 0;
+    }
+    if (!state->header_printed) {
+        printf("Response from %s:\n", state->source);
+        state->header_printed = 1;
+    }
+    printf("  %s %s ttl=%" PRIu32 "%s\n", answer->name, value, answer->ttl,
+           answer->section == ANSWER_SECTION_ANSWER ? "" : " (additional)");
+
+    if (answer->section == ANSWER_SECTION_ANSWER && state->batch != NULL) {
+        state->answered |= batch_note_answer(state->batch, answer->name, answer->type);
+    } else if (answer->section == ANSWER_SECTION_ANSWER) {
+        for (size_t i = 0; i < state->question_count; i++) {
+            if (!same_name(state->questions[i].name, answer->name)) {
+                continue;
+            }
+            if (state->questions[i].qtype == answer->type) {
+                state->answered = 1;
+            } else if (answer->type == DNS_TYPE_NSEC) {
+                state->denied = 1;
+            }
+        }
+    }
+    return 0;
+}
+
+// Multicast a built query
+static int send_packet(int sockfd, const uint8_t *packet, size_t len) {
+    struct sockaddr_in6 mcast_addr;
+    ssize_t sent;
+
     // Send to mDNS multicast group
     memset(&mcast_addr, 0, sizeof(mcast_addr));
     mcast_addr.sin6_family = AF_INET6;
     mcast_addr.sin6_port = htons(MDNS_PORT);
     inet_pton(AF_INET6, "ff02::fb", &mcast_addr.sin6_addr);
     
-    sent = sendto(sockfd, query_buf, offset, 0, (struct sockaddr *)&mcast_addr, sizeof(mcast_addr));
+    sent = sendto(sockfd, packet, len, 0, (struct sockaddr *)&mcast_addr, sizeof(mcast_addr));
     if (sent < 0) {
         return -1;
     }
@@ -86,6 +116,335 @@ static int send_mdns_query(int sockfd, const char *hostname, uint16_t qtype) {
     return 0;
 }
 
+// Create and send an mDNS query carrying every question in one packet
+static int send_mdns_query(int sockfd, const dns_question_t *questions, size_t question_count) {
+    uint8_t query_buf[MDNS_MAX_PACKET];
+    int query_len;
+
+    // ID = 0, QR = 0 (query), Standard query
+    query_len = mdns_build_query(query_buf, sizeof(query_buf), 0, questions, question_count);
+    if (query_len < 0) {
+        return -1;
+    }
+    return send_packet(sockfd, query_buf, (size_t)query_len);
+}
+
+// Record types asked for each name; returns how many (1 or 2)
+static size_t query_types(const client_config_t *cfg, uint16_t *qtypes) {
+    switch (cfg->query_type) {
+        case QUERY_TYPE_HOSTNAME:
+            if (cfg->ipv6_only) {
+                qtypes[0] = DNS_TYPE_AAAA;
+                return 1;
+            }
+            qtypes[0] = DNS_TYPE_A;
+            if (cfg->ipv4_only) {
+                return 1;
+            }
+            // Dual-stack: ask for A and AAAA in the same packet
+            qtypes[1] = DNS_TYPE_AAAA;
+            return 2;
+        case QUERY_TYPE_SERVICE:
+            qtypes[0] = DNS_TYPE_SRV;
+            return 1;
+        case QUERY_TYPE_IPv4:
+            qtypes[0] = DNS_TYPE_A;
+            return 1;
+        case QUERY_TYPE_IPv6:
+            qtypes[0] = DNS_TYPE_AAAA;
+            return 1;
+    }
+    return 0;
+}
+
+// Name to ask for: bare hostnames get .local
+static const char *query_name(const client_config_t *cfg, const char *target, char *buf, size_t buf_len) {
+    if (cfg->query_type == QUERY_TYPE_HOSTNAME && strchr(target, '.') == NULL) {
+        snprintf(buf, buf_len, "%s.local", target);
+        return buf;
+    }
+    return target;
+}
+
+// Read one datagram and print the records of a response. Returns 1 for a
+// response, 0 for a packet that was ignored, -1 if nothing could be read.
+static int receive_response(int sockfd, int flags, const client_config_t *cfg, response_state_t *state) {
+    uint8_t resp_buf[MDNS_MAX_PACKET];
+    struct sockaddr_in6 src_addr;
+    socklen_t src_len = sizeof(src_addr);
+    char addr_str[INET6_ADDRSTRLEN];
+    ssize_t nread;
+
+    nread = recvfrom(sockfd, resp_buf, sizeof(resp_buf), flags, (struct sockaddr *)&src_addr, &src_len);
+    if (nread < 0) {
+        return -1;
+    }
+    if (inet_ntop(AF_INET6, &src_addr.sin6_addr, addr_str, sizeof(addr_str)) == NULL) {
+        strcpy(addr_str, "?");
+    }
+    // RFC 6762 section 6: responses not sent from port 5353 are ignored
+    if (src_addr.sin6_port != htons(MDNS_PORT)) {
+        if (cfg->verbose) {
+            log_info("Ignoring packet from %s port %u", addr_str, (unsigned)ntohs(src_addr.sin6_port));
+        }
+        return 0;
+    }
+    if (cfg->verbose) {
+        log_info("Received response (%zd bytes)", nread);
+    }
+
+    state->source = addr_str;
+    state->header_printed = 0;
+    state->answered = 0;
+    state->denied = 0;
+    if (answer_parse_response(resp_buf, (size_t)nread, print_answer, state) < 0) {
+        if (cfg->verbose) {
+            log_info("Ignoring malformed response from %s", addr_str);
+        }
+        return 0;
+    }
+    return 1;
+}
+
+// Ask mdns_resolverd (see lookup.h). Returns the exit status, or -1 if the
+// daemon could not be asked and the network should be queried directly.
+static int lookup_via_daemon(const client_config_t *cfg, const char *name) {
+    struct sockaddr_un addr;
+    char request[LOOKUP_REQUEST_MAX + 1];
+    char reply[LOOKUP_REPLY_MAX + 1];
+    const char *type = "ADDR";
+    struct timeval tv;
+    fd_set rfds;
+    ssize_t n;
+    int len;
+    int fd;
+
+    switch (cfg->query_type) {
+        case QUERY_TYPE_HOSTNAME:
+            type = cfg->ipv4_only ? "A" : cfg->ipv6_only ? "AAAA" : "ADDR";
+            break;
+        case QUERY_TYPE_SERVICE:
+            type = "SRV";
+            break;
+        case QUERY_TYPE_IPv4:
+            type = "A";
+            break;
+        case QUERY_TYPE_IPv6:
+            type = "AAAA";
+            break;
+    }
+    len = snprintf(request, sizeof(request), "%s %s", type, name);
+    if (len < 0 || (size_t)len >= sizeof(request) || strlen(cfg->socket_path) >= sizeof(addr.sun_path)) {
+        return -1;
+    }
+
+    fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    // Binding just the family autobinds an abstract address for the reply
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(sa_family_t)) < 0) {
+        close(fd);
+        return -1;
+    }
+    strcpy(addr.sun_path, cfg->socket_path);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || send(fd, request, (size_t)len, 0) < 0) {
+        if (cfg->verbose) {
+            log_info("mdns_resolverd not reachable at %s: %s", cfg->socket_path, strerror(errno));
+        }
+        close(fd);
+        return -1;
+    }
+
+    // The daemon holds a cache miss for up to LOOKUP_TIMEOUT_MS
+    tv.tv_sec = (LOOKUP_TIMEOUT_MS + 500) / 1000;
+    tv.tv_usec = ((LOOKUP_TIMEOUT_MS + 500) % 1000) * 1000;
+    FD_ZERO(&rfds);
+    FD_SET(fd, &rfds);
+    n = select(fd + 1, &rfds, NULL, NULL, &tv) > 0 ? recv(fd, reply, LOOKUP_REPLY_MAX, 0) : -1;
+    close(fd);
+    if (n < 0) {
+        log_warn("No reply from mdns_resolverd");
+        return -1;
+    }
+    reply[n] = '\0';
+
+    if (strncmp(reply, "OK\n", 3) == 0) {
+        char *line = reply + 3;
+
+        printf("Response from %s:\n", cfg->socket_path);
+        while (*line != '\0') {
+            char *end = strchr(line, '\n');
+            if (end == NULL) {
+                break;
+            }
+            *end = '\0';
+            printf("  %s\n", line);
+            line = end + 1;
+        }
+        return 0;
+    }
+    if (strncmp(reply, "NONE", 4) == 0) {
+        printf("No response for %s\n", cfg->query_target);
+        return 1;
+    }
+    log_warn("mdns_resolverd: %s", reply);
+    return -1;
+}
+
+// Read names for batch mode: one per line, blank lines and # comments skipped
+static int read_batch_names(const client_config_t *cfg, batch_t *batch) {
+    FILE *file = strcmp(cfg->batch_file, "-") == 0 ? stdin : fopen(cfg->batch_file, "r");
+    char *line = NULL;
+    size_t line_cap = 0;
+    ssize_t line_len;
+    size_t line_no = 0;
+    int result = 0;
+
+    if (file == NULL) {
+        log_error("Cannot open %s: %s", cfg->batch_file, strerror(errno));
+        return -1;
+    }
+
+    while ((line_len = getline(&line, &line_cap, file)) >= 0) {
+        char *start = line;
+        char name_buf[256];
+        const char *name;
+
+        line_no++;
+        while (line_len > 0 && isspace((unsigned char)line[line_len - 1])) {
+            line[--line_len] = '\0';
+        }
+        while (isspace((unsigned char)*start)) {
+            start++;
+        }
+        if (*start == '\0' || *start == '#') {
+            continue;
+        }
+        name = query_name(cfg, start, name_buf, sizeof(name_buf));
+        if (batch_add(batch, name) < 0) {
+            log_error("%s:%zu: invalid name: %s", cfg->batch_file, line_no, start);
+            result = -1;
+            break;
+        }
+    }
+    if (result == 0 && ferror(file)) {
+        log_error("Failed to read %s", cfg->batch_file);
+        result = -1;
+    }
+
+    free(line);
+    if (file != stdin) {
+        fclose(file);
+    }
+    return result;
+}
+
+static void print_unanswered(void *user, const char *name) {
+    size_t *unanswered = user;
+
+    printf("No response for %s\n", name);
+    (*unanswered)++;
+}
+
+// Resolve every name of the batch: pack due names into as few queries as
+// fit, pace the packets, and retransmit only names still without an answer.
+// Returns the exit status.
+static int run_batch(int sockfd, const client_config_t *cfg) {
+    uint16_t qtypes[2];
+    size_t qtype_count = query_types(cfg, qtypes);
+    batch_t *batch = batch_create(qtypes, qtype_count);
+    response_state_t state;
+    int tokens = BATCH_BURST;
+    uint64_t refill_ms = (uint64_t)now_ms();
+    size_t packets = 0;
+    size_t unanswered = 0;
+    int rcvbuf = BATCH_RCVBUF;
+
+    if (batch == NULL) {
+        log_error("Out of memory");
+        return 1;
+    }
+    if (read_batch_names(cfg, batch) != 0) {
+        batch_destroy(batch);
+        return 1;
+    }
+    // Many queries are in flight, and each gets its own response packet
+    if (setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf)) < 0) {
+        log_warn("Failed to enlarge the receive buffer");
+    }
+
+    memset(&state, 0, sizeof(state));
+    state.batch = batch;
+
+    while (batch_pending(batch) > 0) {
+        uint64_t now = (uint64_t)now_ms();
+        uint64_t next;
+        uint64_t wait_ms;
+        struct timeval tv;
+        fd_set rfds;
+        int select_ret;
+
+        // Token bucket: BATCH_BURST packets, refilled one per BATCH_PACKET_MS
+        if (tokens == BATCH_BURST) {
+            refill_ms = now;
+        }
+        while (tokens < BATCH_BURST && now - refill_ms >= BATCH_PACKET_MS) {
+            tokens++;
+            refill_ms += BATCH_PACKET_MS;
+        }
+        while (tokens > 0) {
+            uint8_t packet[BATCH_QUERY_MAX];
+            int len = batch_build_query(batch, now, packet, sizeof(packet));
+
+            if (len <= 0) {
+                break;
+            }
+            if (send_packet(sockfd, packet, (size_t)len) != 0) {
+                log_warn("Failed to send query: %s", strerror(errno));
+            }
+            tokens--;
+            packets++;
+        }
+
+        next = batch_expire(batch, now);
+        if (batch_pending(batch) == 0) {
+            break;
+        }
+        // Names already due are waiting for a token
+        if (next <= now) {
+            next = refill_ms + BATCH_PACKET_MS;
+        }
+        wait_ms = next > now ? next - now : 0;
+        tv.tv_sec = (time_t)(wait_ms / 1000u);
+        tv.tv_usec = (suseconds_t)((wait_ms % 1000u) * 1000u);
+        FD_ZERO(&rfds);
+        FD_SET(sockfd, &rfds);
+
+        select_ret = select(sockfd + 1, &rfds, NULL, NULL, &tv);
+        if (select_ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            log_error("Select failed");
+            break;
+        }
+        // Drain everything queued before looking at the timers again
+        while (select_ret > 0 && receive_response(sockfd, MSG_DONTWAIT, cfg, &state) >= 0) {
+        }
+    }
+
+    batch_for_each_unanswered(batch, print_unanswered, &unanswered);
+    if (cfg->verbose) {
+        log_info("Resolved %zu of %zu names with %zu query packets",
+                 batch_count(batch) - unanswered, batch_count(batch), packets);
+    }
+    batch_destroy(batch);
+    return unanswered == 0 ? 0 : 1;
+}
+
 int main(int argc, char **argv) {
     client_config_t cfg;
     int sockfd;
@@ -103,13 +462,23 @@ int main(int argc, char **argv) {
         return 1;
     }
 
-    if (cfg.query_target == NULL) {
+    if (cfg.query_target == NULL && cfg.batch_file == NULL) {
         fprintf(stderr, "Error: No query target specified\n");
         print_usage(argv[0]);
         log_close();
         return 1;
     }
 
+    // A cache hit in mdns_resolverd needs no socket of our own
+    if (cfg.socket_path != NULL) {
+        char cached_name[256];
+        int status = lookup_via_daemon(&cfg, query_name(&cfg, cfg.query_target, cached_name, sizeof(cached_name)));
+        if (status >= 0) {
+            log_close();
+            return status;
+        }
+    }
+
     // Create UDP socket for mDNS queries
     sockfd = socket(AF_INET6, SOCK_DGRAM, 0);
     if (sockfd < 0) {
@@ -153,46 +522,38 @@ int main(int argc, char **argv) {
         }
     }
 
+    if (cfg.batch_file != NULL) {
+        int status = run_batch(sockfd, &cfg);
+        close(sockfd);
+        log_close();
+        return status;
+    }
+
     if (cfg.verbose) {
         log_info("Querying for: %s", cfg.query_target);
     }
 
     // Send query based on type
-    uint16_t qtype = DNS_TYPE_A;
-    const char *query_name = cfg.query_target;
+    dns_question_t questions[2];
+    uint16_t qtypes[2];
+    size_t question_count = query_types(&cfg, qtypes);
+    char full_name[256];
+    const char *name = query_name(&cfg, cfg.query_target, full_name, sizeof(full_name));
 
-    switch (cfg.query_type) {
-        case QUERY_TYPE_HOSTNAME:
-            if (cfg.ipv6_only) {
-                qtype = DNS_TYPE_AAAA;
-            } else if (!cfg.ipv4_only) {
-                // Try both - send A first
-                qtype = DNS_TYPE_A;
-            }
-            query_name = cfg.query_target;
-            // Add .local if not present
-            if (strchr(cfg.query_target, '.') == NULL) {
-                char full_name[256];
-                snprintf(full_name, sizeof(full_name), "%s.local", cfg.query_target);
-                query_name = full_name;
-            }
-            break;
-        case QUERY_TYPE_SERVICE:
-            qtype = DNS_TYPE_SRV;
-            query_name = cfg.query_target;
-            break;
-        case QUERY_TYPE_IPv4:
-            qtype = DNS_TYPE_A;
-            query_name = cfg.query_target;
-            break;
-        case QUERY_TYPE_IPv6:
-            qtype = DNS_TYPE_AAAA;
-            query_name = cfg.query_target;
-            break;
+    for (size_t i = 0; i < question_count; i++) {
+        if (strlen(name) >= sizeof(questions[i].name)) {
+            log_error("Query name too long: %s", name);
+            close(sockfd);
+            log_close();
+            return 1;
+        }
+        strcpy(questions[i].name, name);
+        questions[i].qtype = qtypes[i];
+        questions[i].qclass = DNS_CLASS_IN;
     }
 
     // Send the query
-    if (send_mdns_query(sockfd, query_name, qtype) != 0) {
+    if (send_mdns_query(sockfd, questions, question_count) != 0) {
         log_error("Failed to send query");
         close(sockfd);
         log_close();
@@ -203,48 +564,59 @@ int main(int argc, char **argv) {
         log_info("Query sent, waiting for responses...");
     }
 
-    // Wait for responses with timeout
-    int response_count = 0;
-    tv.tv_sec = QUERY_TIMEOUT;
-    tv.tv_usec = 0;
+    // Collect responses until the deadline; with --first, until one answers.
+    // An NSEC saying the name has no such record is final too.
+    long deadline = now_ms() + QUERY_TIMEOUT * 1000L;
+    int answered = 0;
+    int denied = 0;
+    response_state_t state;
 
-    FD_ZERO(&rfds);
-    FD_SET(sockfd, &rfds);
+    memset(&state, 0, sizeof(state));
+    state.questions = questions;
+    state.question_count = question_count;
 
-    int select_ret = select(sockfd + 1, &rfds, NULL, NULL, &tv);
-    if (select_ret < 0) {
-        log_error("Select failed");
-    } else if (select_ret == 0) {
-        if (cfg.verbose) {
-            log_info("No responses received");
+    for (;;) {
+        long remaining = deadline - now_ms();
+        int select_ret;
+
+        if (remaining <= 0) {
+            break;
         }
-        printf("No response for %s\n", cfg.query_target);
-    } else if (FD_ISSET(sockfd, &rfds)) {
-        // Try to receive response
-        uint8_t resp_buf[MDNS_MAX_PACKET];
-        struct sockaddr_in6 src_addr;
-        socklen_t src_len = sizeof(src_addr);
-        ssize_t nread;
-
-        nread = recvfrom(sockfd, resp_buf, sizeof(resp_buf), 0, (struct sockaddr *)&src_addr, &src_len);
-        if (nread > 0) {
-            response_count++;
-            if (cfg.verbose) {
-                log_info("Received response (%zu bytes)", nread);
+        tv.tv_sec = remaining / 1000;
+        tv.tv_usec = (remaining % 1000) * 1000;
+        FD_ZERO(&rfds);
+        FD_SET(sockfd, &rfds);
+
+        select_ret = select(sockfd + 1, &rfds, NULL, NULL, &tv);
+        if (select_ret < 0) {
+            if (errno == EINTR) {
+                continue;
             }
-            
-            // Parse response and print info
-            char addr_str[INET6_ADDRSTRLEN];
-            if (inet_ntop(AF_INET6, &src_addr.sin6_addr, addr_str, sizeof(addr_str))) {
-                printf("Response from %s:\n", addr_str);
-                printf("  Query target: %s\n", cfg.query_target);
-                printf("  Query type: %d\n", qtype);
+            log_error("Select failed");
+            break;
+        }
+        if (select_ret == 0) {
+            break;
+        }
+
+        if (receive_response(sockfd, 0, &cfg, &state) > 0 && (state.answered || state.denied)) {
+            answered |= state.answered;
+            denied |= state.denied;
+            if (cfg.first) {
+                break;
             }
         }
     }
 
+    if (!answered && !denied) {
+        if (cfg.verbose) {
+            log_info("No responses received");
+        }
+        printf("No response for %s\n", cfg.query_target);
+    }
+
     close(sockfd);
     log_close();
 
-    return response_count > 0 ? 0 : 1;
+    return answered ? 0 : 1;
 }
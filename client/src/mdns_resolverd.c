@@ -0,0 +1,659 @@
+#include <arpa/inet.h>
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "answer.h"
+#include "log.h"
+#include "lookup.h"
+#include "mdns.h"
+#include "record_cache.h"
+#include "wire.h"
+
+// Caching resolver: every multicast response seen on the link goes into a
+// TTL-aware record cache, and local clients look names up over a Unix
+// datagram socket (protocol in lookup.h). A lookup the cache cannot answer
+// is asked on the network once and held until a record arrives, an NSEC
+// record says there is none, or LOOKUP_TIMEOUT_MS passes.
+
+#define RESOLVERD_MAX_PENDING 256
+#define RESOLVERD_MAX_RECORDS 65536     // new records beyond this are dropped
+#define RESOLVERD_MAX_MATCHES 16        // records returned per (name, type)
+
+typedef struct {
+    const char *interface_name;
+    const char *socket_path;
+    int verbose;
+    log_level_t verbosity;
+} resolverd_config_t;
+
+// A lookup that missed the cache, waiting for the network
+typedef struct {
+    char name[WIRE_NAME_TEXT_MAX];
+    uint16_t qtypes[2];
+    size_t qtype_count;
+    int ready;                  // an asked record, or an NSEC denying one, arrived in the current packet
+    uint64_t deadline_ms;
+    struct sockaddr_un client;
+    socklen_t client_len;
+} pending_lookup_t;
+
+typedef struct {
+    const resolverd_config_t *cfg;
+    int mdns_fd;
+    int lookup_fd;
+    unsigned int ifindex;
+    record_cache_t *cache;
+    uint64_t now_ms;
+    pending_lookup_t pending[RESOLVERD_MAX_PENDING];
+    size_t pending_count;
+} resolverd_t;
+
+static volatile sig_atomic_t g_running = 1;
+
+static void on_signal(int signo) {
+    (void)signo;
+    g_running = 0;
+}
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0) {
+        return 0;
+    }
+    return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+}
+
+static void print_usage(const char *progname) {
+    fprintf(stderr,
+            "mDNS Resolver Daemon - Cache mDNS records and answer local lookups\n\n"
+            "Usage: %s [-i <interface>] [-s <socket>] [-v]\n\n"
+            "Options:\n"
+            "  -i, --interface  Network interface name (optional, e.g. eth0)\n"
+            "  -s, --socket     Unix socket to answer lookups on (default: " LOOKUP_DEFAULT_SOCKET ")\n"
+            "  -v, --verbose    Verbose output\n"
+            "  -h, --help       Show this help\n",
+            progname);
+}
+
+static int parse_args(int argc, char **argv, resolverd_config_t *cfg) {
+    static struct option long_opts[] = {
+        {"interface", required_argument, 0, 'i'},
+        {"socket", required_argument, 0, 's'},
+        {"verbose", no_argument, 0, 'v'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+    int opt;
+
+    cfg->interface_name = NULL;
+    cfg->socket_path = LOOKUP_DEFAULT_SOCKET;
+    cfg->verbose = 0;
+    cfg->verbosity = APP_LOG_WARN;
+
+    while ((opt = getopt_long(argc, argv, "i:s:vh", long_opts, NULL)) != -1) {
+        switch (opt) {
+            case 'i':
+                cfg->interface_name = optarg;
+                break;
+            case 's':
+                cfg->socket_path = optarg;
+                break;
+            case 'v':
+                cfg->verbose = 1;
+                cfg->verbosity = APP_LOG_DEBUG;
+                break;
+            case 'h':
+                print_usage(argv[0]);
+                exit(0);
+            default:
+                return -1;
+        }
+    }
+    if (optind < argc) {
+        fprintf(stderr, "Unexpected argument: %s\n", argv[optind]);
+        return -1;
+    }
+    if (strlen(cfg->socket_path) >= sizeof(((struct sockaddr_un *)0)->sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", cfg->socket_path);
+        return -1;
+    }
+    return 0;
+}
+
+// Port 5353 on ff02::fb, shared with a responder on the same host
+static int open_mdns_socket(const char *ifname, unsigned int *ifindex_out) {
+    int fd;
+    int yes = 1;
+    int hops = 255;
+    struct sockaddr_in6 bind_addr;
+    struct ipv6_mreq mreq;
+    unsigned int ifindex = 0;
+
+    if (ifname != NULL) {
+        ifindex = if_nametoindex(ifname);
+        if (ifindex == 0) {
+            return -1;
+        }
+    }
+
+    fd = socket(AF_INET6, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    memset(&bind_addr, 0, sizeof(bind_addr));
+    bind_addr.sin6_family = AF_INET6;
+    bind_addr.sin6_port = htons(MDNS_PORT);
+    bind_addr.sin6_addr = in6addr_any;
+
+    memset(&mreq, 0, sizeof(mreq));
+    inet_pton(AF_INET6, "ff02::fb", &mreq.ipv6mr_multiaddr);
+    mreq.ipv6mr_interface = ifindex;
+
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes)) < 0 ||
+        setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &yes, sizeof(yes)) < 0 ||
+        bind(fd, (struct sockaddr *)&bind_addr, sizeof(bind_addr)) < 0 ||
+        setsockopt(fd, IPPROTO_IPV6, IPV6_JOIN_GROUP, &mreq, sizeof(mreq)) < 0 ||
+        setsockopt(fd, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, &hops, sizeof(hops)) < 0 ||
+        (ifindex != 0 && setsockopt(fd, IPPROTO_IPV6, IPV6_MULTICAST_IF, &ifindex, sizeof(ifindex)) < 0)) {
+        close(fd);
+        return -1;
+    }
+
+    *ifindex_out = ifindex;
+    return fd;
+}
+
+// Any user may look names up; a stale socket from an earlier run is replaced
+static int open_lookup_socket(const char *path) {
+    struct sockaddr_un addr;
+    struct stat st;
+    int fd;
+
+    if (lstat(path, &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            log_error("%s exists and is not a socket", path);
+            return -1;
+        }
+        unlink(path);
+    }
+
+    fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || chmod(path, 0666) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int type_requested(const pending_lookup_t *lookup, uint16_t type) {
+    for (size_t i = 0; i < lookup->qtype_count; i++) {
+        if (lookup->qtypes[i] == type) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// 1 if a cached NSEC record says its owner has no record of type: the type
+// is missing from its bitmaps (RFC 6762 section 6.1)
+static int nsec_denies(const cached_record_t *nsec, uint16_t type) {
+    size_t pos;
+
+    if (wire_skip_name(nsec->rdata, nsec->rdlen, 0, &pos) != 0) {
+        return 0;
+    }
+    while (pos + 2 <= nsec->rdlen) {
+        uint8_t window = nsec->rdata[pos];
+        uint8_t len = nsec->rdata[pos + 1];
+        size_t byte = (type & 0xFFu) / 8u;
+
+        pos += 2;
+        if (len > 32 || pos + len > nsec->rdlen) {
+            return 0;
+        }
+        if (window == type >> 8) {
+            return byte >= len || (nsec->rdata[pos + byte] & (0x80 >> (type % 8))) == 0;
+        }
+        pos += len;
+    }
+    return 1;
+}
+
+// 1 if a cached NSEC for name denies every asked type, so the network need
+// not be asked
+static int cached_denial(const resolverd_t *d, const char *name, const uint16_t *qtypes, size_t qtype_count) {
+    const cached_record_t *nsec;
+
+    if (record_cache_lookup(d->cache, name, DNS_TYPE_NSEC, &nsec, 1) == 0) {
+        return 0;
+    }
+    for (size_t q = 0; q < qtype_count; q++) {
+        if (!nsec_denies(nsec, qtypes[q])) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Cache events: a new or changed record may complete a waiting lookup. So
+// may an NSEC denying an asked type; records of the other asked types come
+// in the same packet and are cached before finish_lookups() replies.
+static void on_record_event(void *user, record_event_t event, const cached_record_t *record,
+                            const cached_record_t *previous) {
+    resolverd_t *d = user;
+
+    (void)previous;
+    if (event != RECORD_ADDED && event != RECORD_CHANGED) {
+        return;
+    }
+    for (size_t i = 0; i < d->pending_count; i++) {
+        pending_lookup_t *lookup = &d->pending[i];
+        int answers = type_requested(lookup, record->type);
+
+        for (size_t q = 0; q < lookup->qtype_count && record->type == DNS_TYPE_NSEC; q++) {
+            answers |= nsec_denies(record, lookup->qtypes[q]);
+        }
+        if (answers && strcasecmp(lookup->name, record->name) == 0) {
+            lookup->ready = 1;
+        }
+    }
+}
+
+static int cache_answer(void *user, const mdns_answer_t *answer) {
+    resolverd_t *d = user;
+    uint8_t rdata[MDNS_MAX_PACKET];
+    const cached_record_t *known;
+    int rdlen = answer_rdata(answer, rdata, sizeof(rdata));
+
+    if (rdlen < 0) {
+        return 0;
+    }
+    if (record_cache_count(d->cache) >= RESOLVERD_MAX_RECORDS &&
+        record_cache_lookup(d->cache, answer->name, answer->type, &known, 1) == 0) {
+        log_debug("Cache full, dropping %s type %u", answer->name, answer->type);
+        return 0;
+    }
+    if (record_cache_update(d->cache, answer->name, answer->type, answer->cache_flush, rdata,
+                            (uint16_t)rdlen, answer->ttl, d->now_ms) != 0) {
+        log_warn("Failed to cache %s type %u", answer->name, answer->type);
+    }
+    return 0;
+}
+
+// Append one "<name> <TYPE> <value> ttl=<left>" line; whole lines only
+static size_t append_record(char *out, size_t used, size_t cap, const cached_record_t *record,
+                            uint64_t now, int additional) {
+    mdns_answer_t answer;
+    char value[1024];
+    uint32_t left = record->expires_ms > now ? (uint32_t)((record->expires_ms - now) / 1000u) : 0;
+    int n;
+
+    if (answer_from_rdata(record->name, record->type, left, record->rdata, record->rdlen, &answer) != 0 ||
+        answer_format(&answer, value, sizeof(value)) != 0) {
+        return used;
+    }
+    n = snprintf(&out[used], cap - used, "%s %s ttl=%" PRIu32 "%s\n", record->name, value, left,
+                 additional ? " (additional)" : "");
+    if (n < 0 || (size_t)n >= cap - used) {
+        out[used] = '\0';
+        return used;
+    }
+    return used + (size_t)n;
+}
+
+// "OK" and the cached records for the lookup, or 0 if nothing is cached
+static size_t build_reply(const resolverd_t *d, const char *name, const uint16_t *qtypes, size_t qtype_count,
+                          char *out, size_t cap) {
+    const cached_record_t *records[RESOLVERD_MAX_MATCHES];
+    size_t used = (size_t)snprintf(out, cap, "OK\n");
+    size_t found = 0;
+
+    for (size_t q = 0; q < qtype_count; q++) {
+        size_t count = record_cache_lookup(d->cache, name, qtypes[q], records, RESOLVERD_MAX_MATCHES);
+
+        for (size_t i = 0; i < count; i++) {
+            used = append_record(out, used, cap, records[i], d->now_ms, 0);
+        }
+        found += count;
+
+        // The addresses of each SRV target save the client another lookup
+        for (size_t i = 0; i < count && qtypes[q] == DNS_TYPE_SRV; i++) {
+            char target[WIRE_NAME_TEXT_MAX];
+            const cached_record_t *addresses[RESOLVERD_MAX_MATCHES];
+            size_t address_count;
+
+            if (records[i]->rdlen <= 6 ||
+                wire_name_to_text(records[i]->rdata + 6, records[i]->rdlen - 6u, target, sizeof(target)) != 0 ||
+                strcmp(target, ".") == 0) {
+                continue;
+            }
+            address_count = record_cache_lookup(d->cache, target, DNS_TYPE_A, addresses, RESOLVERD_MAX_MATCHES);
+            address_count += record_cache_lookup(d->cache, target, DNS_TYPE_AAAA, &addresses[address_count],
+                                                 RESOLVERD_MAX_MATCHES - address_count);
+            for (size_t a = 0; a < address_count; a++) {
+                used = append_record(out, used, cap, addresses[a], d->now_ms, 1);
+            }
+        }
+    }
+    return found > 0 ? used : 0;
+}
+
+static void send_reply(const resolverd_t *d, const struct sockaddr_un *client, socklen_t client_len,
+                       const char *reply, size_t len) {
+    if (sendto(d->lookup_fd, reply, len, 0, (const struct sockaddr *)client, client_len) < 0) {
+        log_debug("Failed to reply to lookup: %s", strerror(errno));
+    }
+}
+
+static void send_text_reply(const resolverd_t *d, const struct sockaddr_un *client, socklen_t client_len,
+                            const char *reply) {
+    send_reply(d, client, client_len, reply, strlen(reply));
+}
+
+// Ask the network, unless a lookup for the same thing already did
+static void send_query(resolverd_t *d, const pending_lookup_t *lookup) {
+    dns_question_t questions[2];
+    uint8_t packet[MDNS_MAX_PACKET];
+    struct sockaddr_in6 mcast_addr;
+    int len;
+
+    for (size_t i = 0; i + 1 < d->pending_count; i++) {
+        const pending_lookup_t *other = &d->pending[i];
+        if (other->qtype_count == lookup->qtype_count && other->qtypes[0] == lookup->qtypes[0] &&
+            strcasecmp(other->name, lookup->name) == 0) {
+            return;
+        }
+    }
+
+    for (size_t i = 0; i < lookup->qtype_count; i++) {
+        strcpy(questions[i].name, lookup->name);
+        questions[i].qtype = lookup->qtypes[i];
+        questions[i].qclass = DNS_CLASS_IN;
+    }
+    len = mdns_build_query(packet, sizeof(packet), 0, questions, lookup->qtype_count);
+    if (len < 0) {
+        return;
+    }
+
+    memset(&mcast_addr, 0, sizeof(mcast_addr));
+    mcast_addr.sin6_family = AF_INET6;
+    mcast_addr.sin6_port = htons(MDNS_PORT);
+    mcast_addr.sin6_scope_id = d->ifindex;
+    inet_pton(AF_INET6, "ff02::fb", &mcast_addr.sin6_addr);
+    if (sendto(d->mdns_fd, packet, (size_t)len, 0, (struct sockaddr *)&mcast_addr, sizeof(mcast_addr)) < 0) {
+        log_warn("Failed to send query for %s: %s", lookup->name, strerror(errno));
+    }
+}
+
+// "<TYPE> <name>"; the name may contain spaces (service instances)
+static int parse_request(char *request, char *name, size_t name_len, uint16_t *qtypes, size_t *qtype_count) {
+    char *space = strchr(request, ' ');
+    size_t len;
+
+    if (space == NULL) {
+        return -1;
+    }
+    *space = '\0';
+    len = strlen(space + 1);
+    while (len > 0 && (space[len] == '\n' || space[len] == '\r' || space[len] == '.')) {
+        space[len--] = '\0';
+    }
+    if (len == 0 || len >= name_len) {
+        return -1;
+    }
+    memcpy(name, space + 1, len + 1);
+
+    *qtype_count = 1;
+    if (strcasecmp(request, "A") == 0) {
+        qtypes[0] = DNS_TYPE_A;
+    } else if (strcasecmp(request, "AAAA") == 0) {
+        qtypes[0] = DNS_TYPE_AAAA;
+    } else if (strcasecmp(request, "ADDR") == 0) {
+        qtypes[0] = DNS_TYPE_A;
+        qtypes[1] = DNS_TYPE_AAAA;
+        *qtype_count = 2;
+    } else if (strcasecmp(request, "SRV") == 0) {
+        qtypes[0] = DNS_TYPE_SRV;
+    } else if (strcasecmp(request, "TXT") == 0) {
+        qtypes[0] = DNS_TYPE_TXT;
+    } else if (strcasecmp(request, "PTR") == 0) {
+        qtypes[0] = DNS_TYPE_PTR;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+// Answer one request; -1 once none is queued
+static int handle_lookup(resolverd_t *d) {
+    char request[LOOKUP_REQUEST_MAX + 1];
+    char reply[LOOKUP_REPLY_MAX];
+    struct sockaddr_un client;
+    socklen_t client_len = sizeof(client);
+    pending_lookup_t *lookup;
+    char name[WIRE_NAME_TEXT_MAX];
+    uint16_t qtypes[2];
+    size_t qtype_count;
+    size_t reply_len;
+    ssize_t n;
+
+    n = recvfrom(d->lookup_fd, request, LOOKUP_REQUEST_MAX, MSG_DONTWAIT, (struct sockaddr *)&client,
+                 &client_len);
+    if (n < 0) {
+        return -1;
+    }
+    request[n] = '\0';
+    if (client_len <= sizeof(sa_family_t)) {
+        log_debug("Ignoring lookup from an unbound socket");
+        return 0;
+    }
+    if (parse_request(request, name, sizeof(name), qtypes, &qtype_count) != 0) {
+        send_text_reply(d, &client, client_len, "ERR bad request\n");
+        return 0;
+    }
+
+    reply_len = build_reply(d, name, qtypes, qtype_count, reply, sizeof(reply));
+    if (reply_len > 0) {
+        log_debug("Cache hit: %s %s", request, name);
+        send_reply(d, &client, client_len, reply, reply_len);
+        return 0;
+    }
+    if (cached_denial(d, name, qtypes, qtype_count)) {
+        log_debug("Cached NSEC: %s %s", request, name);
+        send_text_reply(d, &client, client_len, "NONE\n");
+        return 0;
+    }
+    if (d->pending_count == RESOLVERD_MAX_PENDING) {
+        send_text_reply(d, &client, client_len, "ERR busy\n");
+        return 0;
+    }
+
+    log_debug("Cache miss: %s %s", request, name);
+    lookup = &d->pending[d->pending_count++];
+    strcpy(lookup->name, name);
+    memcpy(lookup->qtypes, qtypes, sizeof(qtypes));
+    lookup->qtype_count = qtype_count;
+    lookup->ready = 0;
+    lookup->deadline_ms = d->now_ms + LOOKUP_TIMEOUT_MS;
+    lookup->client = client;
+    lookup->client_len = client_len;
+    send_query(d, lookup);
+    return 0;
+}
+
+// Reply to lookups that got their records or ran out of time
+static void finish_lookups(resolverd_t *d) {
+    char reply[LOOKUP_REPLY_MAX];
+    size_t i = 0;
+
+    while (i < d->pending_count) {
+        pending_lookup_t *lookup = &d->pending[i];
+        size_t reply_len;
+
+        if (!lookup->ready && lookup->deadline_ms > d->now_ms) {
+            i++;
+            continue;
+        }
+        reply_len = build_reply(d, lookup->name, lookup->qtypes, lookup->qtype_count, reply, sizeof(reply));
+        if (reply_len > 0) {
+            send_reply(d, &lookup->client, lookup->client_len, reply, reply_len);
+        } else {
+            send_text_reply(d, &lookup->client, lookup->client_len, "NONE\n");
+        }
+        *lookup = d->pending[--d->pending_count];
+    }
+}
+
+static void handle_mdns(resolverd_t *d) {
+    uint8_t packet[MDNS_MAX_PACKET];
+    struct sockaddr_in6 src;
+    socklen_t src_len;
+    ssize_t n;
+
+    for (;;) {
+        src_len = sizeof(src);
+        n = recvfrom(d->mdns_fd, packet, sizeof(packet), MSG_DONTWAIT, (struct sockaddr *)&src, &src_len);
+        if (n < 0) {
+            break;
+        }
+        // RFC 6762 section 6: only responses from port 5353 are trusted;
+        // queries (ours included) are not responses and are skipped
+        if (src.sin6_port != htons(MDNS_PORT)) {
+            continue;
+        }
+        answer_parse_response(packet, (size_t)n, cache_answer, d);
+    }
+    finish_lookups(d);
+}
+
+int main(int argc, char **argv) {
+    resolverd_config_t cfg;
+    resolverd_t *d;
+    struct sigaction sa;
+    uint64_t next_expire_ms;
+    int status = 1;
+
+    if (parse_args(argc, argv, &cfg) != 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    if (log_init(cfg.verbosity, 0) != 0) {
+        fprintf(stderr, "Failed to initialize logging\n");
+        return 1;
+    }
+
+    // Large (the pending table), so not on the stack
+    d = calloc(1, sizeof(*d));
+    if (d == NULL) {
+        log_error("Out of memory");
+        log_close();
+        return 1;
+    }
+    d->cfg = &cfg;
+    d->lookup_fd = -1;
+    d->now_ms = now_ms();
+
+    d->mdns_fd = open_mdns_socket(cfg.interface_name, &d->ifindex);
+    if (d->mdns_fd < 0) {
+        log_error("Failed to open mDNS socket%s%s: %s", cfg.interface_name != NULL ? " on " : "",
+                  cfg.interface_name != NULL ? cfg.interface_name : "", strerror(errno));
+        goto cleanup;
+    }
+    d->lookup_fd = open_lookup_socket(cfg.socket_path);
+    if (d->lookup_fd < 0) {
+        log_error("Failed to open lookup socket %s: %s", cfg.socket_path, strerror(errno));
+        goto cleanup;
+    }
+    d->cache = record_cache_create(on_record_event, d, d->now_ms);
+    if (d->cache == NULL) {
+        log_error("Failed to allocate record cache");
+        goto cleanup;
+    }
+
+    // No SA_RESTART: select() returns EINTR and the loop sees g_running
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    if (cfg.verbose) {
+        log_info("Answering lookups on %s", cfg.socket_path);
+    }
+
+    next_expire_ms = d->now_ms + RECORD_CACHE_TICK_MS;
+    while (g_running) {
+        uint64_t wake_ms = next_expire_ms;
+        uint64_t wait_ms;
+        struct timeval tv;
+        fd_set rfds;
+        int maxfd = d->mdns_fd > d->lookup_fd ? d->mdns_fd : d->lookup_fd;
+        int ready;
+
+        for (size_t i = 0; i < d->pending_count; i++) {
+            if (d->pending[i].deadline_ms < wake_ms) {
+                wake_ms = d->pending[i].deadline_ms;
+            }
+        }
+        wait_ms = wake_ms > d->now_ms ? wake_ms - d->now_ms : 0;
+        tv.tv_sec = (time_t)(wait_ms / 1000u);
+        tv.tv_usec = (suseconds_t)((wait_ms % 1000u) * 1000u);
+        FD_ZERO(&rfds);
+        FD_SET(d->mdns_fd, &rfds);
+        FD_SET(d->lookup_fd, &rfds);
+
+        ready = select(maxfd + 1, &rfds, NULL, NULL, &tv);
+        if (ready < 0 && errno != EINTR) {
+            log_error("Select failed: %s", strerror(errno));
+            break;
+        }
+        d->now_ms = now_ms();
+
+        if (ready > 0 && FD_ISSET(d->mdns_fd, &rfds)) {
+            handle_mdns(d);
+        }
+        while (ready > 0 && FD_ISSET(d->lookup_fd, &rfds) && handle_lookup(d) == 0) {
+        }
+        if (d->now_ms >= next_expire_ms) {
+            record_cache_expire(d->cache, d->now_ms);
+            next_expire_ms = d->now_ms + RECORD_CACHE_TICK_MS;
+        }
+        finish_lookups(d);
+    }
+    status = 0;
+
+cleanup:
+    if (d->lookup_fd >= 0) {
+        close(d->lookup_fd);
+        unlink(cfg.socket_path);
+    }
+    if (d->mdns_fd >= 0) {
+        close(d->mdns_fd);
+    }
+    record_cache_destroy(d->cache);
+    free(d);
+    log_close();
+    return status;
+}
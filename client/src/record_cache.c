@@ -0,0 +1,314 @@
+#include "record_cache.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+// RFC 6762 section 5.2: refresh queries at 80, 85, 90 and 95% of the TTL,
+// each with 0-2% random variation so caches on a link do not query together
+#define REFRESH_FIRST_PERMILLE 800
+#define REFRESH_STEP_PERMILLE 50
+#define REFRESH_STAGES 4
+#define REFRESH_JITTER_PERMILLE 20
+
+struct record_cache {
+    cached_record_t *buckets[RECORD_CACHE_BUCKETS];
+    cached_record_t *wheel[RECORD_CACHE_WHEEL_SLOTS];
+    uint64_t current_tick;   // last tick whose slot has been run
+    size_t count;
+    record_event_fn on_event;
+    void *user;
+};
+
+// FNV-1a over the lowercased name and the type: all rdata of one
+// (name, type) share a bucket, which is what cache-flush needs to find
+static uint32_t hash_key(const char *name, uint16_t type) {
+    uint32_t hash = 2166136261u;
+
+    while (*name != '\0') {
+        hash ^= (uint8_t)tolower((unsigned char)*name++);
+        hash *= 16777619u;
+    }
+    hash ^= type;
+    hash *= 16777619u;
+    return hash;
+}
+
+static int same_rrset(const cached_record_t *record, uint32_t hash, const char *name, uint16_t type) {
+    return record->hash == hash && record->type == type && strcasecmp(record->name, name) == 0;
+}
+
+static void timer_unlink(record_cache_t *cache, cached_record_t *record) {
+    if (record->timer_prev != NULL) {
+        record->timer_prev->timer_next = record->timer_next;
+    } else {
+        size_t slot = (size_t)((record->deadline_ms / RECORD_CACHE_TICK_MS) % RECORD_CACHE_WHEEL_SLOTS);
+        // Only the head of a slot list has no predecessor
+        if (cache->wheel[slot] == record) {
+            cache->wheel[slot] = record->timer_next;
+        }
+    }
+    if (record->timer_next != NULL) {
+        record->timer_next->timer_prev = record->timer_prev;
+    }
+    record->timer_prev = NULL;
+    record->timer_next = NULL;
+}
+
+// Timers already due land in the next tick, so they are never missed
+static void timer_schedule(record_cache_t *cache, cached_record_t *record) {
+    uint64_t tick = record->deadline_ms / RECORD_CACHE_TICK_MS;
+    size_t slot;
+
+    if (tick <= cache->current_tick) {
+        tick = cache->current_tick + 1;
+        record->deadline_ms = tick * RECORD_CACHE_TICK_MS;
+    }
+    slot = (size_t)(tick % RECORD_CACHE_WHEEL_SLOTS);
+
+    record->timer_prev = NULL;
+    record->timer_next = cache->wheel[slot];
+    if (record->timer_next != NULL) {
+        record->timer_next->timer_prev = record;
+    }
+    cache->wheel[slot] = record;
+}
+
+// Next refresh point, or the expiry once all refresh queries have gone out
+static uint64_t next_deadline(const cached_record_t *record) {
+    uint64_t permille;
+
+    if (record->refresh_stage >= REFRESH_STAGES) {
+        return record->expires_ms;
+    }
+    permille = REFRESH_FIRST_PERMILLE + (uint64_t)record->refresh_stage * REFRESH_STEP_PERMILLE +
+               (uint64_t)(rand() % REFRESH_JITTER_PERMILLE);
+    return record->received_ms + (uint64_t)record->ttl * permille;
+}
+
+static void set_lifetime(record_cache_t *cache, cached_record_t *record, uint32_t ttl, uint64_t now_ms) {
+    record->ttl = ttl;
+    record->received_ms = now_ms;
+    record->expires_ms = now_ms + (uint64_t)ttl * 1000u;
+    record->refresh_stage = 0;
+    record->deadline_ms = next_deadline(record);
+    timer_schedule(cache, record);
+}
+
+static void bucket_unlink(record_cache_t *cache, cached_record_t *record) {
+    cached_record_t **link = &cache->buckets[record->hash % RECORD_CACHE_BUCKETS];
+
+    while (*link != NULL) {
+        if (*link == record) {
+            *link = record->bucket_next;
+            break;
+        }
+        link = &(*link)->bucket_next;
+    }
+    cache->count--;
+}
+
+// Detach from both structures; the caller frees after reporting
+static void detach(record_cache_t *cache, cached_record_t *record) {
+    timer_unlink(cache, record);
+    bucket_unlink(cache, record);
+}
+
+static void emit(record_cache_t *cache, record_event_t event, const cached_record_t *record,
+                 const cached_record_t *previous) {
+    if (cache->on_event != NULL) {
+        cache->on_event(cache->user, event, record, previous);
+    }
+}
+
+// RFC 6762 section 10.2: a cache-flush record replaces the other rdata of its
+// rrset received more than a second ago, so the several records of one
+// announcement do not flush each other. The first one flushed is handed back
+// through previous, when given, to be reported as CHANGED; the rest are REMOVED.
+static void flush_stale(record_cache_t *cache, uint32_t hash, const char *name, uint16_t type,
+                        uint64_t now_ms, cached_record_t **previous) {
+    cached_record_t **link = &cache->buckets[hash % RECORD_CACHE_BUCKETS];
+
+    while (*link != NULL) {
+        cached_record_t *stale = *link;
+        if (!same_rrset(stale, hash, name, type) || stale->received_ms + 1000u > now_ms) {
+            link = &stale->bucket_next;
+            continue;
+        }
+        detach(cache, stale);
+        if (previous != NULL && *previous == NULL) {
+            *previous = stale;
+        } else {
+            emit(cache, RECORD_REMOVED, stale, NULL);
+            free(stale);
+        }
+    }
+}
+
+record_cache_t *record_cache_create(record_event_fn on_event, void *user, uint64_t now_ms) {
+    record_cache_t *cache = calloc(1, sizeof(*cache));
+
+    if (cache == NULL) {
+        return NULL;
+    }
+    cache->on_event = on_event;
+    cache->user = user;
+    cache->current_tick = now_ms / RECORD_CACHE_TICK_MS;
+    return cache;
+}
+
+void record_cache_destroy(record_cache_t *cache) {
+    if (cache == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < RECORD_CACHE_BUCKETS; i++) {
+        cached_record_t *record = cache->buckets[i];
+        while (record != NULL) {
+            cached_record_t *next = record->bucket_next;
+            free(record);
+            record = next;
+        }
+    }
+    free(cache);
+}
+
+int record_cache_update(record_cache_t *cache, const char *name, uint16_t type, int cache_flush,
+                        const uint8_t *rdata, uint16_t rdlen, uint32_t ttl, uint64_t now_ms) {
+    uint32_t hash;
+    cached_record_t **link;
+    cached_record_t *record;
+    cached_record_t *previous = NULL;
+    size_t name_len = strlen(name);
+
+    if (name_len >= sizeof(record->name)) {
+        return -1;
+    }
+    hash = hash_key(name, type);
+
+    for (record = cache->buckets[hash % RECORD_CACHE_BUCKETS]; record != NULL; record = record->bucket_next) {
+        if (same_rrset(record, hash, name, type) && record->rdlen == rdlen &&
+            memcmp(record->rdata, rdata, rdlen) == 0) {
+            break;
+        }
+    }
+
+    if (record != NULL) {
+        timer_unlink(cache, record);
+        if (ttl == 0) {
+            bucket_unlink(cache, record);
+            emit(cache, RECORD_REMOVED, record, NULL);
+            free(record);
+            return 0;
+        }
+        // Renewed just now, so the flush below leaves it alone
+        set_lifetime(cache, record, ttl, now_ms);
+        if (cache_flush) {
+            flush_stale(cache, hash, name, type, now_ms, NULL);
+        }
+        return 0;
+    }
+
+    if (ttl == 0) {
+        return 0;
+    }
+
+    record = calloc(1, sizeof(*record) + rdlen);
+    if (record == NULL) {
+        return -1;
+    }
+    memcpy(record->name, name, name_len + 1);
+    record->type = type;
+    record->hash = hash;
+    record->rdlen = rdlen;
+    memcpy(record->rdata, rdata, rdlen);
+
+    if (cache_flush) {
+        flush_stale(cache, hash, name, type, now_ms, &previous);
+    }
+
+    link = &cache->buckets[hash % RECORD_CACHE_BUCKETS];
+    record->bucket_next = *link;
+    *link = record;
+    cache->count++;
+    set_lifetime(cache, record, ttl, now_ms);
+
+    if (previous != NULL) {
+        emit(cache, RECORD_CHANGED, record, previous);
+        free(previous);
+    } else {
+        emit(cache, RECORD_ADDED, record, NULL);
+    }
+    return 0;
+}
+
+static void run_timer(record_cache_t *cache, cached_record_t *record, uint64_t now_ms) {
+    if (record->deadline_ms > now_ms) {
+        timer_schedule(cache, record);
+        return;
+    }
+
+    // One event per timer run even if several refresh points were missed
+    if (record->refresh_stage < REFRESH_STAGES && record->expires_ms > now_ms) {
+        do {
+            record->refresh_stage++;
+        } while (record->refresh_stage < REFRESH_STAGES && next_deadline(record) <= now_ms);
+        emit(cache, RECORD_REFRESH, record, NULL);
+        record->deadline_ms = next_deadline(record);
+        timer_schedule(cache, record);
+        return;
+    }
+
+    bucket_unlink(cache, record);
+    emit(cache, RECORD_REMOVED, record, NULL);
+    free(record);
+}
+
+void record_cache_expire(record_cache_t *cache, uint64_t now_ms) {
+    uint64_t now_tick = now_ms / RECORD_CACHE_TICK_MS;
+    uint64_t first_tick = cache->current_tick + 1;
+    uint64_t ticks;
+
+    if (now_tick < first_tick) {
+        return;
+    }
+    // After a long stall one revolution visits every slot
+    ticks = now_tick - first_tick + 1;
+    if (ticks > RECORD_CACHE_WHEEL_SLOTS) {
+        ticks = RECORD_CACHE_WHEEL_SLOTS;
+    }
+    cache->current_tick = now_tick;
+
+    for (uint64_t i = 0; i < ticks; i++) {
+        size_t slot = (size_t)((first_tick + i) % RECORD_CACHE_WHEEL_SLOTS);
+        // Detach the slot first: timers that are not due yet go back in
+        cached_record_t *record = cache->wheel[slot];
+
+        cache->wheel[slot] = NULL;
+        while (record != NULL) {
+            cached_record_t *next = record->timer_next;
+            record->timer_prev = NULL;
+            record->timer_next = NULL;
+            run_timer(cache, record, now_ms);
+            record = next;
+        }
+    }
+}
+
+size_t record_cache_lookup(const record_cache_t *cache, const char *name, uint16_t type,
+                           const cached_record_t **out, size_t max) {
+    uint32_t hash = hash_key(name, type);
+    size_t count = 0;
+
+    for (const cached_record_t *record = cache->buckets[hash % RECORD_CACHE_BUCKETS];
+         record != NULL && count < max; record = record->bucket_next) {
+        if (same_rrset(record, hash, name, type)) {
+            out[count++] = record;
+        }
+    }
+    return count;
+}
+
+size_t record_cache_count(const record_cache_t *cache) {
+    return cache->count;
+}
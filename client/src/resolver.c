@@ -0,0 +1,237 @@
+#include "resolver.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "wire.h"
+
+typedef struct {
+    char name[256];
+    uint64_t last_query_ms;
+    int attempts;
+    uint64_t asked_state;   // resolution state the attempts were counted for
+    uint64_t reported;      // state last reported complete, 0 if never
+} instance_t;
+
+struct resolver {
+    const record_cache_t *cache;
+    instance_t *instances;
+    size_t count;
+    size_t capacity;
+};
+
+static uint64_t fnv1a_64(uint64_t hash, const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        hash ^= data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Fingerprint of everything known about an instance; never 0
+static uint64_t resolution_state(const resolved_instance_t *resolved) {
+    uint64_t hash = 14695981039346656037ull;
+    uint8_t present = (uint8_t)((resolved->srv != NULL) | ((resolved->txt != NULL) << 1));
+
+    hash = fnv1a_64(hash, &present, 1);
+    if (resolved->srv != NULL) {
+        hash = fnv1a_64(hash, resolved->srv->rdata, resolved->srv->rdlen);
+    }
+    if (resolved->txt != NULL) {
+        hash = fnv1a_64(hash, resolved->txt->rdata, resolved->txt->rdlen);
+    }
+    for (size_t i = 0; i < resolved->address_count; i++) {
+        hash = fnv1a_64(hash, resolved->addresses[i]->rdata, resolved->addresses[i]->rdlen);
+    }
+    return hash != 0 ? hash : 1;
+}
+
+static void resolve(const resolver_t *resolver, const instance_t *instance, resolved_instance_t *out) {
+    size_t found;
+
+    memset(out, 0, sizeof(*out));
+    out->instance = instance->name;
+
+    record_cache_lookup(resolver->cache, instance->name, DNS_TYPE_SRV, &out->srv, 1);
+    record_cache_lookup(resolver->cache, instance->name, DNS_TYPE_TXT, &out->txt, 1);
+
+    // A target of "." means the service is not offered (RFC 2782)
+    if (out->srv != NULL && out->srv->rdlen > 6 &&
+        wire_name_to_text(out->srv->rdata + 6, out->srv->rdlen - 6u, out->target, sizeof(out->target)) == 0 &&
+        strcmp(out->target, ".") != 0) {
+        found = record_cache_lookup(resolver->cache, out->target, DNS_TYPE_A, out->addresses,
+                                    RESOLVER_MAX_ADDRESSES);
+        found += record_cache_lookup(resolver->cache, out->target, DNS_TYPE_AAAA, &out->addresses[found],
+                                     RESOLVER_MAX_ADDRESSES - found);
+        out->address_count = found;
+    } else {
+        out->target[0] = '\0';
+    }
+
+    out->complete = out->srv != NULL && out->txt != NULL && out->address_count > 0;
+}
+
+resolver_t *resolver_create(const record_cache_t *cache) {
+    resolver_t *resolver = calloc(1, sizeof(*resolver));
+
+    if (resolver == NULL) {
+        return NULL;
+    }
+    resolver->cache = cache;
+    return resolver;
+}
+
+void resolver_destroy(resolver_t *resolver) {
+    if (resolver == NULL) {
+        return;
+    }
+    free(resolver->instances);
+    free(resolver);
+}
+
+static instance_t *find_instance(resolver_t *resolver, const char *name) {
+    for (size_t i = 0; i < resolver->count; i++) {
+        if (strcasecmp(resolver->instances[i].name, name) == 0) {
+            return &resolver->instances[i];
+        }
+    }
+    return NULL;
+}
+
+int resolver_add_instance(resolver_t *resolver, const char *name) {
+    instance_t *instance;
+
+    if (strlen(name) >= sizeof(instance->name)) {
+        return -1;
+    }
+    if (find_instance(resolver, name) != NULL) {
+        return 0;
+    }
+
+    if (resolver->count == resolver->capacity) {
+        size_t new_capacity = resolver->capacity == 0 ? 16 : resolver->capacity * 2;
+        instance_t *new_instances = realloc(resolver->instances, new_capacity * sizeof(instance_t));
+        if (new_instances == NULL) {
+            return -1;
+        }
+        resolver->instances = new_instances;
+        resolver->capacity = new_capacity;
+    }
+
+    instance = &resolver->instances[resolver->count++];
+    memset(instance, 0, sizeof(*instance));
+    memcpy(instance->name, name, strlen(name) + 1);
+    return 0;
+}
+
+void resolver_remove_instance(resolver_t *resolver, const char *name, resolver_report_fn fn,
+                              void *user) {
+    instance_t *instance = find_instance(resolver, name);
+
+    if (instance == NULL) {
+        return;
+    }
+    if (instance->reported != 0 && fn != NULL) {
+        resolved_instance_t resolved;
+        resolve(resolver, instance, &resolved);
+        fn(user, -1, &resolved);
+    }
+    *instance = resolver->instances[--resolver->count];
+}
+
+static size_t add_question(dns_question_t *out, size_t count, const char *name, uint16_t qtype) {
+    for (size_t i = 0; i < count; i++) {
+        if (out[i].qtype == qtype && strcasecmp(out[i].name, name) == 0) {
+            return count;
+        }
+    }
+    snprintf(out[count].name, sizeof(out[count].name), "%s", name);
+    out[count].qtype = qtype;
+    out[count].qclass = DNS_CLASS_IN;
+    return count + 1;
+}
+
+size_t resolver_collect_questions(resolver_t *resolver, uint64_t now_ms, dns_question_t *out,
+                                  size_t count, size_t max) {
+    for (size_t i = 0; i < resolver->count; i++) {
+        instance_t *instance = &resolver->instances[i];
+        resolved_instance_t resolved;
+        uint64_t state;
+        size_t needed;
+
+        resolve(resolver, instance, &resolved);
+        if (resolved.complete) {
+            instance->attempts = 0;
+            continue;
+        }
+
+        // New data restarts the retry budget
+        state = resolution_state(&resolved);
+        if (state != instance->asked_state) {
+            instance->asked_state = state;
+            instance->attempts = 0;
+        }
+        if (instance->attempts >= RESOLVER_MAX_ATTEMPTS ||
+            (instance->attempts > 0 && now_ms - instance->last_query_ms < RESOLVER_RETRY_MS)) {
+            continue;
+        }
+
+        needed = (resolved.srv == NULL) + (resolved.txt == NULL) + (resolved.srv != NULL ? 2u : 0u);
+        if (count + needed > max) {
+            break;
+        }
+
+        if (resolved.srv == NULL) {
+            count = add_question(out, count, instance->name, DNS_TYPE_SRV);
+        }
+        if (resolved.txt == NULL) {
+            count = add_question(out, count, instance->name, DNS_TYPE_TXT);
+        }
+        if (resolved.srv != NULL && resolved.address_count == 0 && resolved.target[0] != '\0') {
+            count = add_question(out, count, resolved.target, DNS_TYPE_A);
+            count = add_question(out, count, resolved.target, DNS_TYPE_AAAA);
+        }
+        instance->attempts++;
+        instance->last_query_ms = now_ms;
+    }
+
+    return count;
+}
+
+void resolver_report(resolver_t *resolver, resolver_report_fn fn, void *user) {
+    for (size_t i = 0; i < resolver->count; i++) {
+        instance_t *instance = &resolver->instances[i];
+        resolved_instance_t resolved;
+        uint64_t state;
+
+        resolve(resolver, instance, &resolved);
+        if (!resolved.complete) {
+            // Lost a record it needs (expired or flushed)
+            if (instance->reported != 0) {
+                fn(user, -1, &resolved);
+                instance->reported = 0;
+            }
+            continue;
+        }
+
+        state = resolution_state(&resolved);
+        if (state != instance->reported) {
+            fn(user, instance->reported != 0 ? 1 : 0, &resolved);
+            instance->reported = state;
+        }
+    }
+}
+
+void resolver_report_unresolved(resolver_t *resolver, resolver_report_fn fn, void *user) {
+    for (size_t i = 0; i < resolver->count; i++) {
+        resolved_instance_t resolved;
+
+        if (resolver->instances[i].reported != 0) {
+            continue;
+        }
+        resolve(resolver, &resolver->instances[i], &resolved);
+        fn(user, -1, &resolved);
+    }
+}
@@ -0,0 +1,17 @@
+#ifndef ALLOCCHECK_H
+#define ALLOCCHECK_H
+
+// Allocation guard for the per-packet path (make ALLOC_CHECK=1). Once the
+// service database is built, answering a datagram must not touch the heap;
+// the check build wraps malloc/calloc/realloc/free and aborts when a call
+// is made between alloc_check_begin() and alloc_check_end() on the thread
+// that armed it. In normal builds both compile to nothing.
+#ifdef MDNS_ALLOC_CHECK
+void alloc_check_begin(void);
+void alloc_check_end(const char *where);
+#else
+#define alloc_check_begin() ((void)0)
+#define alloc_check_end(where) ((void)(where))
+#endif
+
+#endif
@@ -8,11 +8,22 @@ typedef enum {
     LOG_TARGET_SYSLOG = 1
 } log_target_t;
 
+typedef enum {
+    IO_BACKEND_SELECT = 0,
+    IO_BACKEND_URING = 1
+} io_backend_t;
+
 typedef struct {
     const char *interface_name;
     log_level_t verbosity;
     log_target_t log_target;
     const char *config_path;
+    io_backend_t io_backend;
+    int async_log;
+    const char *metrics_path;
+    int rate_limit;
+    const char *replay_path;
+    const char *replay_out_path;
 } app_config_t;
 
 int parse_args(int argc, char **argv, app_config_t *cfg);
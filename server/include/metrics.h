@@ -0,0 +1,48 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Latency histogram: 16 linear sub-buckets per power of two (HDR style,
+// about 6% resolution) covering 0 ns up to 2^40 ns (~18 minutes)
+#define METRICS_SUB_BUCKETS 16
+#define METRICS_LATENCY_BUCKETS (METRICS_SUB_BUCKETS * 38)
+
+typedef enum {
+    METRICS_QTYPE_A = 0,
+    METRICS_QTYPE_AAAA,
+    METRICS_QTYPE_SRV,
+    METRICS_QTYPE_ANY,
+    METRICS_QTYPE_OTHER,
+    METRICS_QTYPE_COUNT
+} metrics_qtype_t;
+
+// Owned by the packet thread and updated without locks or atomics; each
+// thread that handles packets keeps its own instance
+typedef struct {
+    uint64_t packets_in;
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+    uint64_t queries[METRICS_QTYPE_COUNT];
+    uint64_t answers;
+    uint64_t parse_errors;
+    uint64_t rate_limited;
+    uint64_t suppressed_answers;
+    uint64_t send_failures;
+    uint64_t latency_count;
+    uint64_t latency_sum_ns;
+    uint64_t latency_buckets[METRICS_LATENCY_BUCKETS];
+} mdns_metrics_t;
+
+void metrics_count_query(mdns_metrics_t *metrics, uint16_t qtype);
+void metrics_record_latency(mdns_metrics_t *metrics, uint64_t latency_ns);
+
+// Upper bound (exclusive) of the histogram bucket holding the q-quantile, in ns
+uint64_t metrics_latency_quantile(const mdns_metrics_t *metrics, double q);
+
+// Write a snapshot in Prometheus text exposition format. The file is
+// replaced atomically (written to path.tmp, then renamed).
+int metrics_write_prometheus(const mdns_metrics_t *metrics, const char *path);
+
+#endif
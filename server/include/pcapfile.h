@@ -0,0 +1,42 @@
+#ifndef PCAPFILE_H
+#define PCAPFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <netinet/in.h>
+
+// Minimal reader/writer for classic pcap files (no libpcap). The reader
+// extracts UDP datagrams to port 5353 over IPv4 or IPv6 from Ethernet
+// (with VLAN tags), raw IP, Linux cooked (SLL/SLL2) and BSD loopback links.
+
+typedef struct {
+    const uint8_t *payload;     // points into the loaded file
+    size_t len;
+    struct sockaddr_in6 src;    // IPv4 sources are stored as ::ffff:a.b.c.d
+    uint64_t ts_ns;             // capture timestamp
+} pcap_datagram_t;
+
+typedef struct {
+    uint8_t *file;
+    size_t file_len;
+    pcap_datagram_t *datagrams;
+    size_t count;
+    size_t skipped;             // records that were not mDNS over UDP
+} pcap_capture_t;
+
+int pcap_capture_load(const char *path, pcap_capture_t *capture);
+void pcap_capture_free(pcap_capture_t *capture);
+
+// Writes LINKTYPE_RAW records: each datagram gets a synthesized IPv6 (or,
+// for v4-mapped addresses, IPv4) and UDP header with valid checksums
+typedef struct {
+    FILE *fp;
+} pcap_writer_t;
+
+int pcap_writer_open(pcap_writer_t *writer, const char *path);
+int pcap_writer_write_udp(pcap_writer_t *writer, uint64_t ts_ns, const struct sockaddr_in6 *src,
+                          const struct sockaddr_in6 *dst, const uint8_t *payload, size_t len);
+int pcap_writer_close(pcap_writer_t *writer);
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef RATELIMIT_H
+#define RATELIMIT_H
+
+#include <stdint.h>
+#include <netinet/in.h>
+
+// Fixed-size tables; idle entries expire and are reused
+#define RATELIMIT_SLOTS 256
+#define RATELIMIT_IDLE_SECONDS 10
+
+// Per-source token bucket: bursts of up to 20 queries, refilled at 10/s
+#define RATELIMIT_SOURCE_BURST 20
+#define RATELIMIT_SOURCE_RATE 10
+
+// RFC 6762 section 6: a record is multicast at most once per second
+#define RATELIMIT_RECORD_INTERVAL_MS 1000
+
+// Returns 1 if a query from addr may be processed, 0 if the source is over budget
+int ratelimit_allow_source(const struct in6_addr *addr, uint64_t now_ms);
+
+// Returns 1 if the record set (owner name, rrtype) may be multicast on
+// ifindex now (and records the send), 0 if it went out less than a second
+// ago. Keyed by the records sent, not the question, so an ANY query cannot
+// re-send what an A query just did.
+int ratelimit_allow_record(const char *name, uint16_t rrtype, unsigned int ifindex, uint64_t now_ms);
+
+void ratelimit_reset(void);
+
+#endif
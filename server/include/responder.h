@@ -0,0 +1,57 @@
+#ifndef RESPONDER_H
+#define RESPONDER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <netinet/in.h>
+
+#include "hostdb.h"
+#include "mdns.h"
+#include "metrics.h"
+
+// Answer engine of the responder (libmdnsresponder): turns one received
+// datagram into the packets to send, with no I/O of its own. The caller
+// owns the socket (or ring, or capture file) and sends what it returns.
+//
+// Services come from the process-wide hostdb, and the response cache and
+// rate-limit tables are process-wide too, so use one responder per process.
+typedef struct mdns_responder mdns_responder_t;
+
+typedef enum {
+    MDNS_ROUTE_MULTICAST = 0,       // QM question from a full mDNS querier
+    MDNS_ROUTE_UNICAST = 1,         // QU question: reply directly to the querier
+    MDNS_ROUTE_LEGACY_UNICAST = 2   // one-shot resolver on an ephemeral port
+} mdns_route_t;
+
+typedef struct {
+    const uint8_t *data;
+    size_t len;
+    struct sockaddr_in6 dest;
+    mdns_route_t route;
+    const dns_question_t *question;   // the first question this packet answers
+    size_t question_count;            // questions whose answers it carries
+} mdns_packet_out_t;
+
+// ifindex scopes the multicast destination and the response cache key
+mdns_responder_t *mdns_responder_create(const host_record_t *local_record, unsigned int ifindex);
+void mdns_responder_destroy(mdns_responder_t *responder);
+
+// 0 disables the per-source and per-record rate limits
+void mdns_responder_set_rate_limit(mdns_responder_t *responder, int enabled);
+
+// Answer every question of one datagram. The answers to all questions with
+// the same route share one packet, unless they outgrow it. now_ms drives the
+// rate limiters. Returns the number of packets stored in *out (valid until
+// the next call), at most MDNS_MAX_QUESTIONS. Never allocates: all working space lives in
+// the responder and the fixed-size cache and rate-limit tables.
+size_t mdns_responder_respond(mdns_responder_t *responder, const uint8_t *packet, size_t len,
+                              const struct sockaddr_in6 *src, uint64_t now_ms,
+                              const mdns_packet_out_t **out);
+
+// Counters kept by the engine (received, queries, drops); callers add the
+// send-side ones (answers, bytes out, failures, latency)
+mdns_metrics_t *mdns_responder_metrics(mdns_responder_t *responder);
+
+const char *mdns_route_name(mdns_route_t route);
+
+#endif
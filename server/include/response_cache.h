@@ -0,0 +1,31 @@
+#ifndef RESPONSE_CACHE_H
+#define RESPONSE_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mdns.h"
+
+#define RESPONSE_CACHE_SLOTS 64
+
+// Answer records by question rather than whole packets, so the answers to
+// all questions of one query can be combined into one response with
+// mdns_append_answers().
+
+// Look up the answer records built before for (qname, qtype, ifindex).
+// generation is the current mdns_services_generation(); a change since the
+// last call drops every cached entry.
+// Returns 1 on hit (*count_out may be 0 for a cached "no answer"), 0 on miss.
+// The records stay valid until the next store.
+int response_cache_lookup(const dns_question_t *question, unsigned int ifindex, uint32_t generation,
+                          const uint8_t **records_out, size_t *len_out, uint16_t *count_out);
+
+// Store the answer records of a built response: the len bytes after its
+// header, holding count records (0 records that the question has no answer).
+// Evicts the least recently used slot when full.
+void response_cache_store(const dns_question_t *question, unsigned int ifindex, uint32_t generation,
+                          const uint8_t *records, size_t len, uint16_t count);
+
+void response_cache_clear(void);
+
+#endif
@@ -1,7 +1,33 @@
 #ifndef SOCKET_H
 #define SOCKET_H
 
+#include <stddef.h>
+#include <netinet/in.h>
+#include <sys/types.h>
+#include <time.h>
+
 int mdns_socket_open(const char *ifname);
 void mdns_socket_close(int fd);
 
+// Attach a classic BPF filter that drops mDNS responses (QR=1) and
+// single-question queries whose first label does not match the first label
+// of any of names (compared by length and first two bytes, case-folded).
+// names == NULL keeps every query and only drops responses.
+int mdns_socket_attach_filter(int fd, const char *const *names, size_t name_count);
+
+// Ask the kernel to stamp each datagram with its receive time (SO_TIMESTAMPNS)
+int mdns_socket_enable_timestamps(int fd);
+
+// Control buffer size needed to carry an SCM_TIMESTAMPNS message
+size_t mdns_socket_timestamp_control_len(void);
+
+// Extract the SCM_TIMESTAMPNS receive time from a control buffer; returns 0,
+// or -1 (rx_time zeroed) if there is none
+int mdns_socket_parse_timestamp(const void *control, size_t control_len, struct timespec *rx_time);
+
+// recvfrom() that also returns the kernel receive time when timestamps are
+// enabled (rx_time is zeroed otherwise)
+ssize_t mdns_socket_recv(int fd, void *buf, size_t len, struct sockaddr_in6 *src,
+                         struct timespec *rx_time);
+
 #endif
@@ -0,0 +1,39 @@
+#ifndef URING_H
+#define URING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <netinet/in.h>
+#include <time.h>
+
+// io_uring I/O backend for the responder socket: one multishot recvmsg over a
+// ring of provided receive buffers, and sendmsg submissions from a fixed pool
+// of send slots, so packets move without a syscall each. Uses the raw kernel
+// interface (Linux 6.0+), no liburing.
+typedef struct mdns_uring mdns_uring_t;
+
+// rx_time is the kernel receive time, zero unless SO_TIMESTAMPNS is enabled
+typedef void (*mdns_uring_packet_fn)(void *user, const uint8_t *packet, size_t len,
+                                     const struct sockaddr_in6 *src, const struct timespec *rx_time);
+
+// A queued datagram completed: error is 0 once sent, or the errno it failed
+// with. cookie is the value given to mdns_uring_send().
+typedef void (*mdns_uring_sent_fn)(void *user, size_t len, int error, uint64_t cookie);
+
+// Returns NULL if io_uring is unavailable (old kernel, seccomp, sysctl)
+mdns_uring_t *mdns_uring_create(int sockfd);
+void mdns_uring_destroy(mdns_uring_t *ring);
+
+// Queue a datagram; it is submitted with the next mdns_uring_poll(), which
+// reports the outcome to on_sent. Returns 1 if queued, 0 if it was sent
+// directly (out of send slots), -1 with errno set if that send failed.
+int mdns_uring_send(mdns_uring_t *ring, const uint8_t *packet, size_t len,
+                    const struct sockaddr_in6 *dest, uint64_t cookie);
+
+// Submit queued work, wait up to timeout_ms for completions and dispatch
+// every received packet to on_packet and every send completion to on_sent.
+// Returns 0, or -1 on a fatal error.
+int mdns_uring_poll(mdns_uring_t *ring, int timeout_ms, mdns_uring_packet_fn on_packet,
+                    mdns_uring_sent_fn on_sent, void *user);
+
+#endif
@@ -0,0 +1,71 @@
+#include "alloccheck.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "log.h"
+
+// Linked with -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=free,
+// so calls made from our objects (and libmdnsresponder.a) land here. Only
+// the arming thread counts: the async log writer may allocate at any time.
+
+static volatile int g_armed = 0;
+static pthread_t g_armed_thread;
+static unsigned long g_calls = 0;
+static const char *g_first_call = NULL;
+static size_t g_first_size = 0;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+// Logging from inside the allocator could recurse, so only record here
+static void note_call(const char *name, size_t size) {
+    if (!g_armed || !pthread_equal(pthread_self(), g_armed_thread)) {
+        return;
+    }
+    if (g_calls++ == 0) {
+        g_first_call = name;
+        g_first_size = size;
+    }
+}
+
+void *__wrap_malloc(size_t size) {
+    note_call("malloc", size);
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+    note_call("calloc", count * size);
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    note_call("realloc", size);
+    return __real_realloc(ptr, size);
+}
+
+void __wrap_free(void *ptr) {
+    if (ptr != NULL) {
+        note_call("free", 0);
+    }
+    __real_free(ptr);
+}
+
+void alloc_check_begin(void) {
+    g_armed_thread = pthread_self();
+    g_calls = 0;
+    g_armed = 1;
+}
+
+void alloc_check_end(const char *where) {
+    g_armed = 0;
+    if (g_calls == 0) {
+        return;
+    }
+    log_error("%s made %lu heap call(s), first %s(%zu); the per-packet path must not allocate",
+              where, g_calls, g_first_call, g_first_size);
+    log_close();
+    abort();
+}
@@ -8,13 +8,21 @@
 void print_usage(const char *progname) {
     fprintf(stderr,
             "Usage: %s -i <interface> [-c <config>] [-v <ERROR|WARN|INFO|DEBUG>] [-l <console|syslog>]\n"
+            "          [-b <select|io_uring>] [-a] [-m <metrics file>] [-n]\n"
+            "       %s -r <capture.pcap> [-w <answers.pcap>] [-c <config>] [-n]\n"
             "Options:\n"
             "  -i, --interface   Network interface name (required)\n"
             "  -c, --config      Config file path for service definitions\n"
             "  -v, --verbosity   Log verbosity level (default: WARN)\n"
             "  -l, --log         Log target: console or syslog (default: console)\n"
+            "  -b, --backend     I/O backend: select or io_uring (default: select)\n"
+            "  -a, --async-log   Format and write log messages on a background thread\n"
+            "  -m, --metrics     Write Prometheus text metrics to this file every 5s\n"
+            "  -n, --no-rate-limit  Disable per-source and per-record rate limits (load testing)\n"
+            "  -r, --replay      Answer the mDNS queries in a pcap file instead of a socket, timing the run\n"
+            "  -w, --replay-out  Write the answers produced by -r to this pcap file\n"
             "  -h, --help        Show this help\n",
-            progname);
+            progname, progname);
 }
 
 int parse_args(int argc, char **argv, app_config_t *cfg) {
@@ -23,6 +31,12 @@ int parse_args(int argc, char **argv, app_config_t *cfg) {
         {"config", required_argument, 0, 'c'},
         {"verbosity", required_argument, 0, 'v'},
         {"log", required_argument, 0, 'l'},
+        {"backend", required_argument, 0, 'b'},
+        {"async-log", no_argument, 0, 'a'},
+        {"metrics", required_argument, 0, 'm'},
+        {"no-rate-limit", no_argument, 0, 'n'},
+        {"replay", required_argument, 0, 'r'},
+        {"replay-out", required_argument, 0, 'w'},
         {"help", no_argument, 0, 'h'},
         {0, 0, 0, 0}
     };
@@ -37,8 +51,14 @@ int parse_args(int argc, char **argv, app_config_t *cfg) {
     cfg->config_path = NULL;
     cfg->verbosity = APP_LOG_WARN;
     cfg->log_target = LOG_TARGET_CONSOLE;
+    cfg->io_backend = IO_BACKEND_SELECT;
+    cfg->async_log = 0;
+    cfg->metrics_path = NULL;
+    cfg->rate_limit = 1;
+    cfg->replay_path = NULL;
+    cfg->replay_out_path = NULL;
 
-    while ((opt = getopt_long(argc, argv, "i:c:v:l:h", long_opts, NULL)) != -1) {
+    while ((opt = getopt_long(argc, argv, "i:c:v:l:b:am:nr:w:h", long_opts, NULL)) != -1) {
         switch (opt) {
             case 'i':
                 cfg->interface_name = optarg;
@@ -62,6 +82,31 @@ int parse_args(int argc, char **argv, app_config_t *cfg) {
                     return -1;
                 }
                 break;
+            case 'b':
+                if (strcmp(optarg, "select") == 0) {
+                    cfg->io_backend = IO_BACKEND_SELECT;
+                } else if (strcmp(optarg, "io_uring") == 0) {
+                    cfg->io_backend = IO_BACKEND_URING;
+                } else {
+                    fprintf(stderr, "Invalid I/O backend: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'a':
+                cfg->async_log = 1;
+                break;
+            case 'm':
+                cfg->metrics_path = optarg;
+                break;
+            case 'n':
+                cfg->rate_limit = 0;
+                break;
+            case 'r':
+                cfg->replay_path = optarg;
+                break;
+            case 'w':
+                cfg->replay_out_path = optarg;
+                break;
             case 'h':
                 print_usage(argv[0]);
                 exit(0);
@@ -70,7 +115,13 @@ int parse_args(int argc, char **argv, app_config_t *cfg) {
         }
     }
 
-    if (cfg->interface_name == NULL) {
+    if (cfg->replay_out_path != NULL && cfg->replay_path == NULL) {
+        fprintf(stderr, "-w requires -r\n");
+        return -1;
+    }
+
+    // Replay needs no socket, so no interface either
+    if (cfg->interface_name == NULL && cfg->replay_path == NULL) {
         fprintf(stderr, "Missing required interface option\n");
         return -1;
     }
@@ -1,19 +1,26 @@
 #include <arpa/inet.h>
 #include <errno.h>
+#include <net/if.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/select.h>
 #include <sys/socket.h>
+#include <time.h>
 #include <unistd.h>
 
+#include "alloccheck.h"
 #include "args.h"
 #include "config.h"
 #include "hostdb.h"
 #include "log.h"
 #include "mdns.h"
+#include "metrics.h"
+#include "pcapfile.h"
+#include "responder.h"
 #include "socket.h"
+#include "uring.h"
 
 static volatile sig_atomic_t g_running = 1;
 
@@ -22,72 +29,245 @@ static void on_signal(int signo) {
     g_running = 0;
 }
 
-static int is_supported_query_type(uint16_t qtype) {
-    return (qtype == DNS_TYPE_A || qtype == DNS_TYPE_AAAA || qtype == DNS_TYPE_SRV);
+#define METRICS_EXPORT_INTERVAL_MS 5000
+
+static uint64_t monotonic_ms(void) {
+    struct timespec ts;
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0) {
+        return 0;
+    }
+    return (uint64_t)ts.tv_sec * 1000u + (uint64_t)(ts.tv_nsec / 1000000L);
 }
 
-// Parse service type from query name.
-// Returns 0 if it looks like a general service query (_service._proto.domain)
-// Returns 1 if it looks like a targeted instance query
-static int is_general_service_query(const char *qname) {
-    // General service queries start with underscore
-    return (qname[0] == '_');
+#define FILTER_MAX_SERVICES 255
+
+// Regenerate the kernel socket filter from the names we currently own:
+// hostname plus every service instance and service type
+static void refresh_socket_filter(int sockfd, const host_record_t *local_record) {
+    mdns_service_t *services[FILTER_MAX_SERVICES + 1];
+    const char *names[1 + 2 * FILTER_MAX_SERVICES];
+    size_t name_count = 0;
+    size_t service_count;
+    int result;
+
+    service_count = mdns_list_services(services, FILTER_MAX_SERVICES + 1);
+
+    names[name_count++] = local_record->hostname;
+    for (size_t i = 0; i < service_count && i < FILTER_MAX_SERVICES; i++) {
+        names[name_count++] = services[i]->instance;
+        names[name_count++] = services[i]->service_type;
+    }
+
+    // Too many names to list: only drop responses in the kernel
+    result = mdns_socket_attach_filter(sockfd, service_count > FILTER_MAX_SERVICES ? NULL : names,
+                                       name_count);
+    if (result < 0) {
+        log_warn("Failed to attach socket filter: %s", strerror(errno));
+    } else {
+        log_debug("Socket filter attached with %d name fingerprint(s)", result);
+    }
 }
 
-// Extract service type and domain from general query name
-// E.g., "_http._tcp.local" -> service_type="_http._tcp", domain="local"
-static int parse_service_type_query(const char *qname, char *service_type,
-                                     size_t st_len, char *domain, size_t dom_len) {
-    const char *second_dot;
-    const char *third_dot;
-    
-    if (qname[0] != '_') {
-        return -1;
+// Sends one datagram through the active I/O backend. Returns 0 once sent,
+// 1 if queued (the backend reports the outcome with rx_ns later, see
+// on_uring_sent()), or -1 with errno set.
+typedef int (*send_packet_fn)(void *io, const uint8_t *packet, size_t len,
+                              const struct sockaddr_in6 *dest, uint64_t rx_ns);
+
+typedef struct {
+    mdns_responder_t *responder;
+    send_packet_fn send_packet;
+    void *send_io;
+    int measure_latency;
+} server_ctx_t;
+
+static uint64_t timespec_ns(const struct timespec *ts) {
+    return (uint64_t)ts->tv_sec * 1000000000u + (uint64_t)ts->tv_nsec;
+}
+
+static int send_packet_syscall(void *io, const uint8_t *packet, size_t len,
+                               const struct sockaddr_in6 *dest, uint64_t rx_ns) {
+    int sockfd = *(const int *)io;
+    (void)rx_ns;
+    return sendto(sockfd, packet, len, 0, (const struct sockaddr *)dest, sizeof(*dest)) < 0 ? -1 : 0;
+}
+
+static int send_packet_uring(void *io, const uint8_t *packet, size_t len,
+                             const struct sockaddr_in6 *dest, uint64_t rx_ns) {
+    return mdns_uring_send((mdns_uring_t *)io, packet, len, dest, rx_ns);
+}
+
+// Count a datagram that left the socket, with the latency from its query
+static void count_sent(server_ctx_t *ctx, size_t len, uint64_t rx_ns) {
+    mdns_metrics_t *metrics = mdns_responder_metrics(ctx->responder);
+
+    metrics->answers++;
+    metrics->bytes_out += len;
+    if (ctx->measure_latency) {
+        struct timespec now;
+        uint64_t now_ns;
+        clock_gettime(CLOCK_REALTIME, &now);
+        now_ns = timespec_ns(&now);
+        metrics_record_latency(metrics, now_ns > rx_ns ? now_ns - rx_ns : 0);
     }
-    
-    // Find second underscore/dot
-    second_dot = strchr(qname + 1, '.');
-    if (second_dot == NULL) {
-        return -1;
+}
+
+// Answer one received datagram and send the results; shared by all I/O
+// backends. rx_time is the kernel receive timestamp (zero if unavailable);
+// with metrics enabled the latency from it to each send is recorded. now_ms
+// drives the rate limiters (monotonic time live, capture time when replaying).
+// Nothing here may allocate; make ALLOC_CHECK=1 enforces it.
+static void handle_packet(server_ctx_t *ctx, const uint8_t *in_buf, size_t nread,
+                          const struct sockaddr_in6 *src_addr, const struct timespec *rx_time,
+                          uint64_t now_ms) {
+    mdns_metrics_t *metrics = mdns_responder_metrics(ctx->responder);
+    const mdns_packet_out_t *packets;
+    size_t packet_count;
+    uint64_t rx_ns = 0;
+
+    if (ctx->measure_latency) {
+        rx_ns = timespec_ns(rx_time);
+        if (rx_ns == 0) {
+            struct timespec now;
+            clock_gettime(CLOCK_REALTIME, &now);
+            rx_ns = timespec_ns(&now);
+        }
     }
-    
-    // Check if next part starts with underscore
-    if (second_dot[1] != '_') {
-        return -1;
+
+    alloc_check_begin();
+    packet_count = mdns_responder_respond(ctx->responder, in_buf, nread, src_addr, now_ms, &packets);
+
+    for (size_t i = 0; i < packet_count; i++) {
+        const mdns_packet_out_t *packet = &packets[i];
+        int sent = ctx->send_packet(ctx->send_io, packet->data, packet->len, &packet->dest, rx_ns);
+
+        if (sent < 0) {
+            metrics->send_failures++;
+            log_warn("sendto failed: %s", strerror(errno));
+            continue;
+        }
+        if (sent == 0) {
+            count_sent(ctx, packet->len, rx_ns);
+        }
+        log_info("Answered %s type %u%s (%s)", packet->question->name, packet->question->qtype,
+                 packet->question_count > 1 ? " and more" : "", mdns_route_name(packet->route));
     }
-    
-    // Find the dot after _tcp or _udp
-    third_dot = strchr(second_dot + 1, '.');
-    if (third_dot == NULL) {
-        return -1;
+    alloc_check_end("handle_packet");
+}
+
+static void on_uring_packet(void *user, const uint8_t *packet, size_t len,
+                            const struct sockaddr_in6 *src, const struct timespec *rx_time) {
+    handle_packet((server_ctx_t *)user, packet, len, src, rx_time, monotonic_ms());
+}
+
+// A send queued by handle_packet() completed; only now is it counted
+static void on_uring_sent(void *user, size_t len, int error, uint64_t rx_ns) {
+    server_ctx_t *ctx = user;
+
+    if (error != 0) {
+        mdns_responder_metrics(ctx->responder)->send_failures++;
+        log_warn("io_uring sendmsg failed: %s", strerror(error));
+        return;
     }
-    
-    // Extract service type
-    size_t st_size = (size_t)(third_dot - qname);
-    if (st_size >= st_len) {
-        return -1;
+    count_sent(ctx, len, rx_ns);
+}
+
+// Replay mode: datagrams from a capture go through the same handle_packet()
+// as live traffic; answers are optionally written to an output capture
+typedef struct {
+    pcap_writer_t writer;
+    int writing;
+    uint64_t ts_ns;
+    struct sockaddr_in6 local_addr;
+    struct sockaddr_in6 local_addr4;   // v4-mapped, source of IPv4 answers
+    size_t responses;
+} replay_io_t;
+
+static int send_packet_replay(void *io, const uint8_t *packet, size_t len,
+                              const struct sockaddr_in6 *dest, uint64_t rx_ns) {
+    replay_io_t *replay = io;
+
+    (void)rx_ns;
+
+    replay->responses++;
+    if (!replay->writing) {
+        return 0;
     }
-    memcpy(service_type, qname, st_size);
-    service_type[st_size] = '\0';
-    
-    // Extract domain (rest after third dot)
-    size_t dom_size = strlen(third_dot + 1);
-    if (dom_size >= dom_len) {
+    return pcap_writer_write_udp(&replay->writer, replay->ts_ns,
+                                 IN6_IS_ADDR_V4MAPPED(&dest->sin6_addr) ? &replay->local_addr4 : &replay->local_addr,
+                                 dest, packet, len);
+}
+
+static int run_replay(server_ctx_t *ctx, const app_config_t *cfg, const host_record_t *local_record) {
+    pcap_capture_t capture;
+    replay_io_t replay;
+    struct timespec no_rx_time = {0, 0};
+    struct timespec start;
+    struct timespec end;
+    double elapsed;
+
+    if (pcap_capture_load(cfg->replay_path, &capture) != 0) {
         return -1;
     }
-    strcpy(domain, third_dot + 1);
-    
-    // Remove trailing dot if present
-    if (dom_size > 0 && domain[dom_size - 1] == '.') {
-        domain[dom_size - 1] = '\0';
+
+    memset(&replay, 0, sizeof(replay));
+    replay.local_addr.sin6_family = AF_INET6;
+    replay.local_addr.sin6_port = htons(MDNS_PORT);
+    if (local_record->has_ipv6) {
+        replay.local_addr.sin6_addr = local_record->ipv6;
+    }
+    replay.local_addr4 = replay.local_addr;
+    memset(&replay.local_addr4.sin6_addr, 0, sizeof(replay.local_addr4.sin6_addr));
+    replay.local_addr4.sin6_addr.s6_addr[10] = 0xFF;
+    replay.local_addr4.sin6_addr.s6_addr[11] = 0xFF;
+    if (local_record->has_ipv4) {
+        memcpy(&replay.local_addr4.sin6_addr.s6_addr[12], &local_record->ipv4, 4);
+    }
+    if (cfg->replay_out_path != NULL) {
+        if (pcap_writer_open(&replay.writer, cfg->replay_out_path) != 0) {
+            pcap_capture_free(&capture);
+            return -1;
+        }
+        replay.writing = 1;
+    }
+
+    ctx->send_packet = send_packet_replay;
+    ctx->send_io = &replay;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t i = 0; i < capture.count; i++) {
+        const pcap_datagram_t *datagram = &capture.datagrams[i];
+        replay.ts_ns = datagram->ts_ns;
+        handle_packet(ctx, datagram->payload, datagram->len, &datagram->src, &no_rx_time,
+                      datagram->ts_ns / 1000000u);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    elapsed = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("replayed %zu datagrams (%zu other records skipped), %zu responses in %.6f s\n",
+           capture.count, capture.skipped, replay.responses, elapsed);
+    if (capture.count > 0 && elapsed > 0.0) {
+        printf("%.0f datagrams/s, %.1f ns/datagram\n", (double)capture.count / elapsed,
+               elapsed * 1e9 / (double)capture.count);
+    }
+
+    if (replay.writing && pcap_writer_close(&replay.writer) != 0) {
+        log_error("Failed to write %s", cfg->replay_out_path);
+        pcap_capture_free(&capture);
+        return -1;
     }
-    
+    pcap_capture_free(&capture);
     return 0;
 }
 
 int main(int argc, char **argv) {
     app_config_t cfg;
+    server_ctx_t ctx;
     host_record_t local_record;
+    mdns_uring_t *ring = NULL;
+    uint32_t filter_generation = 0;
+    int filter_attached = 0;
+    uint64_t metrics_written_ms = 0;
     int sockfd;
 
     if (parse_args(argc, argv, &cfg) != 0) {
@@ -100,6 +280,11 @@ int main(int argc, char **argv) {
         return 1;
     }
 
+    if (cfg.async_log && log_start_async() != 0) {
+        log_warn("Failed to start async log writer, logging synchronously");
+    }
+
+    memset(&ctx, 0, sizeof(ctx));
     if (hostdb_init(&local_record, NULL) != 0) {
         log_error("Failed to initialize host database");
         log_close();
@@ -113,6 +298,20 @@ int main(int argc, char **argv) {
         }
     }
 
+    if (cfg.replay_path != NULL) {
+        int rc = -1;
+        ctx.responder = mdns_responder_create(&local_record,
+                                              cfg.interface_name != NULL ? if_nametoindex(cfg.interface_name) : 0);
+        if (ctx.responder != NULL) {
+            mdns_responder_set_rate_limit(ctx.responder, cfg.rate_limit);
+            rc = run_replay(&ctx, &cfg, &local_record);
+        }
+        mdns_responder_destroy(ctx.responder);
+        mdns_cleanup_services();
+        log_close();
+        return rc == 0 ? 0 : 1;
+    }
+
     sockfd = mdns_socket_open(cfg.interface_name);
     if (sockfd < 0) {
         log_error("Failed to open mDNS socket on interface %s", cfg.interface_name);
@@ -120,16 +319,72 @@ int main(int argc, char **argv) {
         return 1;
     }
 
+    // The interface index is part of the response cache key so one process
+    // never mixes up interfaces
+    ctx.responder = mdns_responder_create(&local_record, if_nametoindex(cfg.interface_name));
+    if (ctx.responder == NULL) {
+        log_error("Failed to create responder");
+        mdns_socket_close(sockfd);
+        log_close();
+        return 1;
+    }
+    mdns_responder_set_rate_limit(ctx.responder, cfg.rate_limit);
+
+    ctx.send_packet = send_packet_syscall;
+    ctx.send_io = &sockfd;
+
+    if (cfg.metrics_path != NULL) {
+        ctx.measure_latency = 1;
+        if (mdns_socket_enable_timestamps(sockfd) != 0) {
+            log_warn("SO_TIMESTAMPNS unavailable, measuring latency from user space");
+        }
+    }
+
+    if (cfg.io_backend == IO_BACKEND_URING) {
+        ring = mdns_uring_create(sockfd);
+        if (ring == NULL) {
+            log_warn("io_uring unavailable, falling back to select()");
+        } else {
+            ctx.send_packet = send_packet_uring;
+            ctx.send_io = ring;
+        }
+    }
+
     signal(SIGINT, on_signal);
     signal(SIGTERM, on_signal);
 
-    log_info("mdns_server started on interface %s for host %s", cfg.interface_name, local_record.hostname);
+    log_info("mdns_server started on interface %s for host %s (%s backend)", cfg.interface_name,
+             local_record.hostname, ring != NULL ? "io_uring" : "select");
 
     while (g_running) {
         fd_set rfds;
         struct timeval tv;
         int ready;
 
+        if (filter_generation != mdns_services_generation() || !filter_attached) {
+            filter_generation = mdns_services_generation();
+            filter_attached = 1;
+            refresh_socket_filter(sockfd, &local_record);
+        }
+
+        if (cfg.metrics_path != NULL && monotonic_ms() - metrics_written_ms >= METRICS_EXPORT_INTERVAL_MS) {
+            metrics_written_ms = monotonic_ms();
+            metrics_write_prometheus(mdns_responder_metrics(ctx.responder), cfg.metrics_path);
+        }
+
+        if (ring != NULL) {
+            if (mdns_uring_poll(ring, 1000, on_uring_packet, on_uring_sent, &ctx) == 0) {
+                continue;
+            }
+            // Runtime failure (e.g. no multishot recvmsg): keep serving via select()
+            log_warn("io_uring backend failed, falling back to select()");
+            mdns_uring_destroy(ring);
+            ring = NULL;
+            ctx.send_packet = send_packet_syscall;
+            ctx.send_io = &sockfd;
+            continue;
+        }
+
         FD_ZERO(&rfds);
         FD_SET(sockfd, &rfds);
         tv.tv_sec = 1;
@@ -149,102 +404,26 @@ int main(int argc, char **argv) {
 
         if (FD_ISSET(sockfd, &rfds)) {
             uint8_t in_buf[MDNS_MAX_PACKET];
-            uint8_t out_buf[MDNS_MAX_PACKET];
             struct sockaddr_in6 src_addr;
-            socklen_t src_len = sizeof(src_addr);
+            struct timespec rx_time;
             ssize_t nread;
-            dns_question_t question;
-            int parsed;
-            host_record_t match;
 
-            nread = recvfrom(sockfd, in_buf, sizeof(in_buf), 0, (struct sockaddr *)&src_addr, &src_len);
+            nread = mdns_socket_recv(sockfd, in_buf, sizeof(in_buf), &src_addr, &rx_time);
             if (nread < 0) {
                 log_warn("recvfrom failed: %s", strerror(errno));
                 continue;
             }
 
-            parsed = mdns_parse_query(in_buf, (size_t)nread, &question);
-            if (parsed <= 0) {
-                continue;
-            }
-
-            if (!is_supported_query_type(question.qtype)) {
-                log_debug("Ignoring unsupported qtype %u for %s", question.qtype, question.name);
-                continue;
-            }
-
-            // Handle A/AAAA queries
-            if (question.qtype == DNS_TYPE_A || question.qtype == DNS_TYPE_AAAA) {
-                if (hostdb_lookup(&local_record, question.name, &match) != 1) {
-                    log_debug("No match for qname %s", question.name);
-                    continue;
-                }
-
-                int out_len;
-                ssize_t sent;
-
-                out_len = mdns_build_response(out_buf, sizeof(out_buf), &question, &match);
-                if (out_len <= 0) {
-                    continue;
-                }
-
-                sent = sendto(sockfd, out_buf, (size_t)out_len, 0, (struct sockaddr *)&src_addr, src_len);
-                if (sent < 0) {
-                    log_warn("sendto failed: %s", strerror(errno));
-                } else {
-                    log_info("Answered %s type %u", question.name, question.qtype);
-                }
-            }
-            // Handle SRV queries
-            else if (question.qtype == DNS_TYPE_SRV) {
-                mdns_service_t *services[32];
-                size_t service_count = 0;
-                int out_len;
-                ssize_t sent;
-                
-                if (is_general_service_query(question.name)) {
-                    // General query: return all services of this type
-                    char service_type[256];
-                    char domain[256];
-                    
-                    if (parse_service_type_query(question.name, service_type,
-                                                 sizeof(service_type), domain,
-                                                 sizeof(domain)) == 0) {
-                        service_count = mdns_find_services_by_type(service_type, domain,
-                                                                   services, 32);
-                    }
-                } else {
-                    // Targeted query: return specific instance
-                    mdns_service_t *svc = mdns_find_service_by_fqdn(question.name);
-                    if (svc != NULL) {
-                        services[0] = svc;
-                        service_count = 1;
-                    }
-                }
-                
-                if (service_count == 0) {
-                    log_debug("No service match for %s", question.name);
-                    continue;
-                }
-                
-                out_len = mdns_build_service_response(out_buf, sizeof(out_buf),
-                                                      &question, services, service_count);
-                if (out_len <= 0) {
-                    continue;
-                }
-                
-                sent = sendto(sockfd, out_buf, (size_t)out_len, 0,
-                             (struct sockaddr *)&src_addr, src_len);
-                if (sent < 0) {
-                    log_warn("sendto failed: %s", strerror(errno));
-                } else {
-                    log_info("Answered %s SRV with %zu service(s)", question.name, service_count);
-                }
-            }
+            handle_packet(&ctx, in_buf, (size_t)nread, &src_addr, &rx_time, monotonic_ms());
         }
     }
 
     log_info("mdns_server shutting down");
+    if (cfg.metrics_path != NULL) {
+        metrics_write_prometheus(mdns_responder_metrics(ctx.responder), cfg.metrics_path);
+    }
+    mdns_uring_destroy(ring);
+    mdns_responder_destroy(ctx.responder);
     mdns_socket_close(sockfd);
     mdns_cleanup_services();
     log_close();
@@ -0,0 +1,158 @@
+#include "metrics.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "log.h"
+#include "mdns.h"
+
+static size_t latency_bucket(uint64_t value) {
+    unsigned msb;
+    size_t index;
+
+    if (value < METRICS_SUB_BUCKETS) {
+        return (size_t)value;
+    }
+
+    // Octave n >= 1 holds [2^(n+3), 2^(n+4)) split into 16 equal sub-buckets
+    msb = 63u - (unsigned)__builtin_clzll(value);
+    index = (size_t)(msb - 3) * METRICS_SUB_BUCKETS + (size_t)((value >> (msb - 4)) & 15u);
+    if (index >= METRICS_LATENCY_BUCKETS) {
+        index = METRICS_LATENCY_BUCKETS - 1;
+    }
+    return index;
+}
+
+// Smallest value that lands in bucket index
+static uint64_t bucket_lower_bound(size_t index) {
+    size_t octave = index / METRICS_SUB_BUCKETS;
+    uint64_t sub = index % METRICS_SUB_BUCKETS;
+
+    if (octave == 0) {
+        return sub;
+    }
+    return (METRICS_SUB_BUCKETS + sub) << (octave - 1);
+}
+
+void metrics_count_query(mdns_metrics_t *metrics, uint16_t qtype) {
+    switch (qtype) {
+        case DNS_TYPE_A:
+            metrics->queries[METRICS_QTYPE_A]++;
+            break;
+        case DNS_TYPE_AAAA:
+            metrics->queries[METRICS_QTYPE_AAAA]++;
+            break;
+        case DNS_TYPE_SRV:
+            metrics->queries[METRICS_QTYPE_SRV]++;
+            break;
+        case DNS_TYPE_ANY:
+            metrics->queries[METRICS_QTYPE_ANY]++;
+            break;
+        default:
+            metrics->queries[METRICS_QTYPE_OTHER]++;
+            break;
+    }
+}
+
+void metrics_record_latency(mdns_metrics_t *metrics, uint64_t latency_ns) {
+    metrics->latency_buckets[latency_bucket(latency_ns)]++;
+    metrics->latency_count++;
+    metrics->latency_sum_ns += latency_ns;
+}
+
+uint64_t metrics_latency_quantile(const mdns_metrics_t *metrics, double q) {
+    uint64_t rank = (uint64_t)(q * (double)metrics->latency_count);
+    uint64_t seen = 0;
+
+    for (size_t i = 0; i < METRICS_LATENCY_BUCKETS; i++) {
+        seen += metrics->latency_buckets[i];
+        if (seen > rank) {
+            return bucket_lower_bound(i + 1);
+        }
+    }
+    return 0;
+}
+
+static void write_counter(FILE *fp, const char *name, const char *help, uint64_t value) {
+    fprintf(fp, "# HELP %s %s\n# TYPE %s counter\n%s %llu\n", name, help, name, name,
+            (unsigned long long)value);
+}
+
+static void write_latency(FILE *fp, const mdns_metrics_t *metrics) {
+    static const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+    uint64_t cumulative = 0;
+    size_t index = 0;
+
+    // Exported le bounds are powers of two nanoseconds (1.024us .. 1.07s),
+    // which fall exactly on sub-bucket boundaries
+    fprintf(fp, "# HELP mdns_response_latency_seconds Time from packet receipt to answer send\n"
+                "# TYPE mdns_response_latency_seconds histogram\n");
+    for (unsigned shift = 10; shift <= 30; shift++) {
+        uint64_t bound = (uint64_t)1 << shift;
+        while (index < METRICS_LATENCY_BUCKETS && bucket_lower_bound(index + 1) <= bound) {
+            cumulative += metrics->latency_buckets[index++];
+        }
+        fprintf(fp, "mdns_response_latency_seconds_bucket{le=\"%.9g\"} %llu\n", (double)bound / 1e9,
+                (unsigned long long)cumulative);
+    }
+    fprintf(fp, "mdns_response_latency_seconds_bucket{le=\"+Inf\"} %llu\n",
+            (unsigned long long)metrics->latency_count);
+    fprintf(fp, "mdns_response_latency_seconds_sum %.9f\n", (double)metrics->latency_sum_ns / 1e9);
+    fprintf(fp, "mdns_response_latency_seconds_count %llu\n", (unsigned long long)metrics->latency_count);
+
+    fprintf(fp, "# HELP mdns_response_latency_quantile_seconds Latency quantiles (bucket upper bound)\n"
+                "# TYPE mdns_response_latency_quantile_seconds gauge\n");
+    for (size_t i = 0; i < sizeof(quantiles) / sizeof(quantiles[0]); i++) {
+        fprintf(fp, "mdns_response_latency_quantile_seconds{quantile=\"%g\"} %.9g\n", quantiles[i],
+                (double)metrics_latency_quantile(metrics, quantiles[i]) / 1e9);
+    }
+}
+
+int metrics_write_prometheus(const mdns_metrics_t *metrics, const char *path) {
+    static const char *const qtype_names[METRICS_QTYPE_COUNT] = {"A", "AAAA", "SRV", "ANY", "other"};
+    char tmp_path[4096];
+    FILE *fp;
+
+    if (metrics == NULL || path == NULL) {
+        return -1;
+    }
+
+    if ((size_t)snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path) >= sizeof(tmp_path)) {
+        log_error("Metrics path too long: %s", path);
+        return -1;
+    }
+
+    fp = fopen(tmp_path, "w");
+    if (fp == NULL) {
+        log_warn("Failed to open metrics file %s", tmp_path);
+        return -1;
+    }
+
+    write_counter(fp, "mdns_packets_received_total", "Datagrams received", metrics->packets_in);
+    write_counter(fp, "mdns_received_bytes_total", "Bytes received", metrics->bytes_in);
+    write_counter(fp, "mdns_sent_bytes_total", "Bytes sent", metrics->bytes_out);
+
+    fprintf(fp, "# HELP mdns_queries_total Questions received, by query type\n"
+                "# TYPE mdns_queries_total counter\n");
+    for (size_t i = 0; i < METRICS_QTYPE_COUNT; i++) {
+        fprintf(fp, "mdns_queries_total{qtype=\"%s\"} %llu\n", qtype_names[i],
+                (unsigned long long)metrics->queries[i]);
+    }
+
+    write_counter(fp, "mdns_answers_total", "Answer packets sent", metrics->answers);
+    write_counter(fp, "mdns_parse_errors_total", "Queries that failed to parse", metrics->parse_errors);
+    write_counter(fp, "mdns_rate_limited_total", "Queries dropped by the per-source limit",
+                  metrics->rate_limited);
+    write_counter(fp, "mdns_suppressed_answers_total", "Multicast answer records suppressed by the per-record limit",
+                  metrics->suppressed_answers);
+    write_counter(fp, "mdns_send_failures_total", "Answers that failed to send", metrics->send_failures);
+    write_latency(fp, metrics);
+
+    if (fclose(fp) != 0 || rename(tmp_path, path) != 0) {
+        log_warn("Failed to write metrics file %s", path);
+        remove(tmp_path);
+        return -1;
+    }
+
+    return 0;
+}
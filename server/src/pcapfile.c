@@ -0,0 +1,409 @@
+#include "pcapfile.h"
+
+#include <arpa/inet.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "log.h"
+#include "mdns.h"
+
+#define PCAP_MAGIC_USEC 0xa1b2c3d4u
+#define PCAP_MAGIC_NSEC 0xa1b23c4du
+#define PCAP_GLOBAL_HEADER_LEN 24
+#define PCAP_RECORD_HEADER_LEN 16
+
+#define LINKTYPE_NULL 0
+#define LINKTYPE_ETHERNET 1
+#define LINKTYPE_RAW_OPENBSD 12
+#define LINKTYPE_RAW_BSDOS 14
+#define LINKTYPE_RAW 101
+#define LINKTYPE_LINUX_SLL 113
+#define LINKTYPE_LINUX_SLL2 276
+
+#define ETHERTYPE_IPV4 0x0800
+#define ETHERTYPE_IPV6 0x86DD
+#define ETHERTYPE_VLAN 0x8100
+#define ETHERTYPE_QINQ 0x88A8
+
+#define IPPROTO_NUM_UDP 17
+
+typedef struct {
+    int swapped;
+    int nsec;
+    uint32_t linktype;
+} pcap_format_t;
+
+static uint16_t be16(const uint8_t *p) {
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static uint32_t file_u32(const pcap_format_t *fmt, const uint8_t *p) {
+    if (fmt->swapped) {
+        return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+    }
+    return ((uint32_t)p[3] << 24) | ((uint32_t)p[2] << 16) | ((uint32_t)p[1] << 8) | (uint32_t)p[0];
+}
+
+static int read_file(const char *path, uint8_t **data_out, size_t *len_out) {
+    FILE *fp = fopen(path, "rb");
+    uint8_t *data = NULL;
+    size_t len = 0;
+    size_t capacity = 0;
+
+    if (fp == NULL) {
+        log_error("Cannot open capture %s", path);
+        return -1;
+    }
+
+    for (;;) {
+        size_t n;
+        if (len == capacity) {
+            size_t new_capacity = capacity == 0 ? 65536 : capacity * 2;
+            uint8_t *grown = realloc(data, new_capacity);
+            if (grown == NULL) {
+                free(data);
+                fclose(fp);
+                return -1;
+            }
+            data = grown;
+            capacity = new_capacity;
+        }
+        n = fread(&data[len], 1, capacity - len, fp);
+        len += n;
+        if (n == 0) {
+            break;
+        }
+    }
+
+    if (ferror(fp)) {
+        log_error("Failed to read capture %s", path);
+        free(data);
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+    *data_out = data;
+    *len_out = len;
+    return 0;
+}
+
+// Skip the link-layer header; returns the offset of the IP header or -1
+static long link_payload_offset(uint32_t linktype, const uint8_t *frame, size_t len) {
+    size_t offset;
+    uint16_t ethertype;
+
+    switch (linktype) {
+        case LINKTYPE_ETHERNET:
+            if (len < 14) {
+                return -1;
+            }
+            offset = 12;
+            ethertype = be16(&frame[offset]);
+            while (ethertype == ETHERTYPE_VLAN || ethertype == ETHERTYPE_QINQ) {
+                offset += 4;
+                if (offset + 2 > len) {
+                    return -1;
+                }
+                ethertype = be16(&frame[offset]);
+            }
+            if (ethertype != ETHERTYPE_IPV4 && ethertype != ETHERTYPE_IPV6) {
+                return -1;
+            }
+            return (long)(offset + 2);
+        case LINKTYPE_LINUX_SLL:
+            if (len < 16) {
+                return -1;
+            }
+            ethertype = be16(&frame[14]);
+            return (ethertype == ETHERTYPE_IPV4 || ethertype == ETHERTYPE_IPV6) ? 16 : -1;
+        case LINKTYPE_LINUX_SLL2:
+            if (len < 20) {
+                return -1;
+            }
+            ethertype = be16(&frame[0]);
+            return (ethertype == ETHERTYPE_IPV4 || ethertype == ETHERTYPE_IPV6) ? 20 : -1;
+        case LINKTYPE_NULL:
+            return len >= 4 ? 4 : -1;
+        case LINKTYPE_RAW:
+        case LINKTYPE_RAW_OPENBSD:
+        case LINKTYPE_RAW_BSDOS:
+            return 0;
+        default:
+            return -1;
+    }
+}
+
+// Find the UDP payload of an mDNS datagram inside an IP packet
+static int extract_mdns(const uint8_t *ip, size_t len, pcap_datagram_t *out) {
+    const uint8_t *udp;
+    size_t udp_len;
+    uint16_t udp_total;
+
+    if (len < 1) {
+        return -1;
+    }
+
+    memset(&out->src, 0, sizeof(out->src));
+    out->src.sin6_family = AF_INET6;
+
+    if ((ip[0] >> 4) == 4) {
+        size_t ihl = (size_t)(ip[0] & 0x0F) * 4;
+        if (len < 20 || ihl < 20 || len < ihl || ip[9] != IPPROTO_NUM_UDP) {
+            return -1;
+        }
+        // Fragments other than a complete datagram are not reassembled
+        if ((be16(&ip[6]) & 0x3FFF) != 0) {
+            return -1;
+        }
+        out->src.sin6_addr.s6_addr[10] = 0xFF;
+        out->src.sin6_addr.s6_addr[11] = 0xFF;
+        memcpy(&out->src.sin6_addr.s6_addr[12], &ip[12], 4);
+        udp = ip + ihl;
+        udp_len = len - ihl;
+    } else if ((ip[0] >> 4) == 6) {
+        uint8_t next;
+        size_t offset = 40;
+
+        if (len < 40) {
+            return -1;
+        }
+        memcpy(&out->src.sin6_addr, &ip[8], 16);
+        next = ip[6];
+        // Hop-by-hop, routing and destination options may precede UDP
+        while (next == 0 || next == 43 || next == 60) {
+            if (offset + 8 > len) {
+                return -1;
+            }
+            next = ip[offset];
+            offset += ((size_t)ip[offset + 1] + 1) * 8;
+        }
+        if (next != IPPROTO_NUM_UDP || offset > len) {
+            return -1;
+        }
+        udp = ip + offset;
+        udp_len = len - offset;
+    } else {
+        return -1;
+    }
+
+    if (udp_len < 8 || be16(&udp[2]) != MDNS_PORT) {
+        return -1;
+    }
+    udp_total = be16(&udp[4]);
+    if (udp_total < 8 || udp_total > udp_len) {
+        return -1;
+    }
+
+    out->src.sin6_port = htons(be16(&udp[0]));
+    out->payload = udp + 8;
+    out->len = udp_total - 8u;
+    return 0;
+}
+
+int pcap_capture_load(const char *path, pcap_capture_t *capture) {
+    pcap_format_t fmt;
+    size_t offset;
+    size_t capacity = 0;
+    uint32_t magic;
+
+    if (path == NULL || capture == NULL) {
+        return -1;
+    }
+    memset(capture, 0, sizeof(*capture));
+
+    if (read_file(path, &capture->file, &capture->file_len) != 0) {
+        return -1;
+    }
+    if (capture->file_len < PCAP_GLOBAL_HEADER_LEN) {
+        log_error("%s is not a pcap file", path);
+        pcap_capture_free(capture);
+        return -1;
+    }
+
+    memset(&fmt, 0, sizeof(fmt));
+    magic = file_u32(&fmt, capture->file);
+    if (magic == PCAP_MAGIC_USEC || magic == PCAP_MAGIC_NSEC) {
+        fmt.swapped = 0;
+    } else {
+        fmt.swapped = 1;
+        magic = file_u32(&fmt, capture->file);
+        if (magic != PCAP_MAGIC_USEC && magic != PCAP_MAGIC_NSEC) {
+            log_error("%s is not a pcap file (pcapng is not supported)", path);
+            pcap_capture_free(capture);
+            return -1;
+        }
+    }
+    fmt.nsec = magic == PCAP_MAGIC_NSEC;
+    fmt.linktype = file_u32(&fmt, &capture->file[20]) & 0x0FFFFFFFu;
+
+    offset = PCAP_GLOBAL_HEADER_LEN;
+    while (offset + PCAP_RECORD_HEADER_LEN <= capture->file_len) {
+        const uint8_t *rec = &capture->file[offset];
+        uint32_t ts_sec = file_u32(&fmt, rec);
+        uint32_t ts_frac = file_u32(&fmt, rec + 4);
+        uint32_t incl_len = file_u32(&fmt, rec + 8);
+        const uint8_t *frame = rec + PCAP_RECORD_HEADER_LEN;
+        pcap_datagram_t datagram;
+        long ip_offset;
+
+        if (incl_len > capture->file_len - offset - PCAP_RECORD_HEADER_LEN) {
+            log_warn("Capture %s is truncated", path);
+            break;
+        }
+        offset += PCAP_RECORD_HEADER_LEN + incl_len;
+
+        ip_offset = link_payload_offset(fmt.linktype, frame, incl_len);
+        if (ip_offset < 0 || extract_mdns(frame + ip_offset, incl_len - (size_t)ip_offset, &datagram) != 0) {
+            capture->skipped++;
+            continue;
+        }
+        datagram.ts_ns = (uint64_t)ts_sec * 1000000000u + (uint64_t)ts_frac * (fmt.nsec ? 1u : 1000u);
+
+        if (capture->count == capacity) {
+            size_t new_capacity = capacity == 0 ? 1024 : capacity * 2;
+            pcap_datagram_t *grown = realloc(capture->datagrams, new_capacity * sizeof(*grown));
+            if (grown == NULL) {
+                pcap_capture_free(capture);
+                return -1;
+            }
+            capture->datagrams = grown;
+            capacity = new_capacity;
+        }
+        capture->datagrams[capture->count++] = datagram;
+    }
+
+    return 0;
+}
+
+void pcap_capture_free(pcap_capture_t *capture) {
+    if (capture == NULL) {
+        return;
+    }
+    free(capture->datagrams);
+    free(capture->file);
+    memset(capture, 0, sizeof(*capture));
+}
+
+static void put_u32_le(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static void put_be16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)(v & 0xFF);
+}
+
+// One's-complement sum, continued across calls
+static uint32_t checksum_add(uint32_t sum, const uint8_t *data, size_t len) {
+    for (size_t i = 0; i + 1 < len; i += 2) {
+        sum += (uint32_t)be16(&data[i]);
+    }
+    if (len & 1) {
+        sum += (uint32_t)data[len - 1] << 8;
+    }
+    return sum;
+}
+
+static uint16_t checksum_finish(uint32_t sum) {
+    while (sum >> 16) {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+    return (uint16_t)~sum;
+}
+
+int pcap_writer_open(pcap_writer_t *writer, const char *path) {
+    uint8_t header[PCAP_GLOBAL_HEADER_LEN];
+
+    if (writer == NULL || path == NULL) {
+        return -1;
+    }
+
+    writer->fp = fopen(path, "wb");
+    if (writer->fp == NULL) {
+        log_error("Cannot create capture %s", path);
+        return -1;
+    }
+
+    memset(header, 0, sizeof(header));
+    put_u32_le(&header[0], PCAP_MAGIC_NSEC);
+    header[4] = 2;    // version 2.4
+    header[6] = 4;
+    put_u32_le(&header[16], 65535);
+    put_u32_le(&header[20], LINKTYPE_RAW);
+    if (fwrite(header, 1, sizeof(header), writer->fp) != sizeof(header)) {
+        fclose(writer->fp);
+        writer->fp = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+int pcap_writer_write_udp(pcap_writer_t *writer, uint64_t ts_ns, const struct sockaddr_in6 *src,
+                          const struct sockaddr_in6 *dst, const uint8_t *payload, size_t len) {
+    uint8_t packet[40 + 8 + MDNS_MAX_PACKET];
+    uint8_t record[PCAP_RECORD_HEADER_LEN];
+    size_t ip_len;
+    uint8_t *udp;
+    uint32_t sum;
+    uint16_t udp_len = (uint16_t)(8 + len);
+
+    if (writer == NULL || writer->fp == NULL || len > MDNS_MAX_PACKET) {
+        return -1;
+    }
+
+    memset(packet, 0, 48);
+    if (IN6_IS_ADDR_V4MAPPED(&dst->sin6_addr)) {
+        ip_len = 20;
+        packet[0] = 0x45;
+        put_be16(&packet[2], (uint16_t)(20 + udp_len));
+        packet[8] = 255;
+        packet[9] = IPPROTO_NUM_UDP;
+        memcpy(&packet[12], &src->sin6_addr.s6_addr[12], 4);
+        memcpy(&packet[16], &dst->sin6_addr.s6_addr[12], 4);
+        put_be16(&packet[10], checksum_finish(checksum_add(0, packet, 20)));
+        sum = checksum_add(0, &packet[12], 8);
+    } else {
+        ip_len = 40;
+        packet[0] = 0x60;
+        put_be16(&packet[4], udp_len);
+        packet[6] = IPPROTO_NUM_UDP;
+        packet[7] = 255;
+        memcpy(&packet[8], &src->sin6_addr, 16);
+        memcpy(&packet[24], &dst->sin6_addr, 16);
+        sum = checksum_add(0, &packet[8], 32);
+    }
+    sum += IPPROTO_NUM_UDP + udp_len;
+
+    udp = &packet[ip_len];
+    put_be16(&udp[0], ntohs(src->sin6_port));
+    put_be16(&udp[2], ntohs(dst->sin6_port));
+    put_be16(&udp[4], udp_len);
+    memcpy(&udp[8], payload, len);
+    sum = checksum_add(sum, udp, udp_len);
+    put_be16(&udp[6], checksum_finish(sum) == 0 ? 0xFFFF : checksum_finish(sum));
+
+    put_u32_le(&record[0], (uint32_t)(ts_ns / 1000000000u));
+    put_u32_le(&record[4], (uint32_t)(ts_ns % 1000000000u));
+    put_u32_le(&record[8], (uint32_t)(ip_len + udp_len));
+    put_u32_le(&record[12], (uint32_t)(ip_len + udp_len));
+
+    if (fwrite(record, 1, sizeof(record), writer->fp) != sizeof(record) ||
+        fwrite(packet, 1, ip_len + udp_len, writer->fp) != ip_len + udp_len) {
+        return -1;
+    }
+    return 0;
+}
+
+int pcap_writer_close(pcap_writer_t *writer) {
+    int rc;
+
+    if (writer == NULL || writer->fp == NULL) {
+        return -1;
+    }
+    rc = fclose(writer->fp);
+    writer->fp = NULL;
+    return rc == 0 ? 0 : -1;
+}
@@ -0,0 +1,133 @@
+#include "ratelimit.h"
+
+#include <ctype.h>
+#include <string.h>
+
+// Linear probing is bounded so lookups stay O(1) even when the table is full
+#define RATELIMIT_PROBE 8
+#define TOKEN_SCALE 1000  // tokens are kept in thousandths
+
+typedef struct {
+    uint64_t key;
+    uint64_t last_ms;   // last refill (sources) or last send (records)
+    uint32_t tokens;    // sources only, scaled by TOKEN_SCALE
+    uint32_t in_use;
+} limit_slot_t;
+
+static limit_slot_t source_slots[RATELIMIT_SLOTS];
+static limit_slot_t record_slots[RATELIMIT_SLOTS];
+
+static uint64_t fnv1a_64(uint64_t hash, const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        hash ^= data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static int is_expired(const limit_slot_t *slot, uint64_t now_ms) {
+    return !slot->in_use || now_ms - slot->last_ms > (uint64_t)RATELIMIT_IDLE_SECONDS * 1000u;
+}
+
+// Find the slot for key, or claim an expired/the stalest slot in its probe window.
+// *fresh is set when the slot was (re)initialized for this key.
+static limit_slot_t *find_slot(limit_slot_t *table, uint64_t key, uint64_t now_ms, int *fresh) {
+    size_t start = (size_t)(key % RATELIMIT_SLOTS);
+    limit_slot_t *victim = NULL;
+
+    for (size_t i = 0; i < RATELIMIT_PROBE; i++) {
+        limit_slot_t *slot = &table[(start + i) % RATELIMIT_SLOTS];
+
+        if (slot->in_use && slot->key == key && !is_expired(slot, now_ms)) {
+            *fresh = 0;
+            return slot;
+        }
+        if (victim == NULL || (!is_expired(victim, now_ms) &&
+                               (is_expired(slot, now_ms) || slot->last_ms < victim->last_ms))) {
+            victim = slot;
+        }
+    }
+
+    victim->key = key;
+    victim->in_use = 1;
+    victim->last_ms = now_ms;
+    *fresh = 1;
+    return victim;
+}
+
+int ratelimit_allow_source(const struct in6_addr *addr, uint64_t now_ms) {
+    limit_slot_t *slot;
+    uint64_t key;
+    int fresh;
+
+    if (addr == NULL) {
+        return 1;
+    }
+
+    key = fnv1a_64(1469598103934665603ull, (const uint8_t *)addr, sizeof(*addr));
+    slot = find_slot(source_slots, key, now_ms, &fresh);
+
+    if (fresh) {
+        slot->tokens = RATELIMIT_SOURCE_BURST * TOKEN_SCALE;
+    } else {
+        // RATE tokens/s is RATE thousandths per millisecond
+        uint64_t refill = (now_ms - slot->last_ms) * RATELIMIT_SOURCE_RATE;
+        uint64_t tokens = slot->tokens + refill;
+
+        if (tokens > RATELIMIT_SOURCE_BURST * TOKEN_SCALE) {
+            tokens = RATELIMIT_SOURCE_BURST * TOKEN_SCALE;
+        }
+        slot->tokens = (uint32_t)tokens;
+        slot->last_ms = now_ms;
+    }
+
+    if (slot->tokens < TOKEN_SCALE) {
+        return 0;
+    }
+    slot->tokens -= TOKEN_SCALE;
+    return 1;
+}
+
+int ratelimit_allow_record(const char *name, uint16_t rrtype, unsigned int ifindex, uint64_t now_ms) {
+    limit_slot_t *slot;
+    uint64_t key = 1469598103934665603ull;
+    uint8_t tail[6];
+    size_t len;
+    int fresh;
+
+    if (name == NULL) {
+        return 1;
+    }
+
+    // Case-insensitive, trailing dot ignored
+    len = strlen(name);
+    if (len > 0 && name[len - 1] == '.') {
+        len--;
+    }
+    for (size_t i = 0; i < len; i++) {
+        uint8_t c = (uint8_t)tolower((unsigned char)name[i]);
+        key = fnv1a_64(key, &c, 1);
+    }
+    tail[0] = (uint8_t)(rrtype >> 8);
+    tail[1] = (uint8_t)rrtype;
+    tail[2] = (uint8_t)(ifindex >> 24);
+    tail[3] = (uint8_t)(ifindex >> 16);
+    tail[4] = (uint8_t)(ifindex >> 8);
+    tail[5] = (uint8_t)ifindex;
+    key = fnv1a_64(key, tail, sizeof(tail));
+
+    slot = find_slot(record_slots, key, now_ms, &fresh);
+    if (fresh) {
+        return 1;
+    }
+    if (now_ms - slot->last_ms < RATELIMIT_RECORD_INTERVAL_MS) {
+        return 0;
+    }
+    slot->last_ms = now_ms;
+    return 1;
+}
+
+void ratelimit_reset(void) {
+    memset(source_slots, 0, sizeof(source_slots));
+    memset(record_slots, 0, sizeof(record_slots));
+}
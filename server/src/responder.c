@@ -0,0 +1,451 @@
+#include "responder.h"
+
+#include <arpa/inet.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "log.h"
+#include "ratelimit.h"
+#include "response_cache.h"
+#include "wire.h"
+
+#define ROUTE_COUNT 3
+#define NO_PACKET MDNS_MAX_QUESTIONS
+
+struct mdns_responder {
+    host_record_t local_record;
+    unsigned int ifindex;
+    struct sockaddr_in6 mcast_addr;
+    int rate_limit;
+    mdns_metrics_t metrics;
+    dns_question_t questions[MDNS_MAX_QUESTIONS];
+    // Packets of the datagram being answered: one per route, plus another
+    // whenever the answers outgrow a packet, so never more than one per question
+    mdns_packet_out_t out[MDNS_MAX_QUESTIONS];
+    uint8_t out_bufs[MDNS_MAX_QUESTIONS][MDNS_MAX_PACKET];
+    size_t out_count;
+    size_t open_packet[ROUTE_COUNT];   // packet still taking answers, or NO_PACKET
+    uint8_t scratch[MDNS_MAX_PACKET];  // a question's answers, as built
+    uint8_t limited[MDNS_MAX_PACKET];  // the same, less records multicast too recently
+    uint64_t now_ms;
+    size_t suppressed;
+};
+
+// Responses from other hosts are never answered
+static int is_response_packet(const uint8_t *packet, size_t packet_len) {
+    return packet_len >= 3 && (packet[2] & 0x80) != 0;
+}
+
+// Probe queries carry the proposed records in the authority section
+static int is_probe_query(const uint8_t *packet, size_t packet_len) {
+    return packet_len >= 12 && wire_read_u16(&packet[8]) != 0;
+}
+
+// RFC 6762 section 5.4/6.7: queries not sent from port 5353 come from legacy
+// resolvers and get a unicast reply echoing their ID; otherwise the QU bit
+// picks unicast and everything else goes to the multicast group.
+static mdns_route_t select_route(const struct sockaddr_in6 *src_addr, const dns_question_t *question) {
+    if (ntohs(src_addr->sin6_port) != MDNS_PORT) {
+        return MDNS_ROUTE_LEGACY_UNICAST;
+    }
+    if ((question->qclass & DNS_CLASS_UNICAST_RESPONSE) != 0) {
+        return MDNS_ROUTE_UNICAST;
+    }
+    return MDNS_ROUTE_MULTICAST;
+}
+
+const char *mdns_route_name(mdns_route_t route) {
+    switch (route) {
+        case MDNS_ROUTE_MULTICAST: return "multicast";
+        case MDNS_ROUTE_UNICAST: return "unicast";
+        case MDNS_ROUTE_LEGACY_UNICAST: return "legacy unicast";
+        default: return "unknown";
+    }
+}
+
+static int is_supported_query_type(uint16_t qtype) {
+    return (qtype == DNS_TYPE_A || qtype == DNS_TYPE_AAAA || qtype == DNS_TYPE_SRV ||
+            qtype == DNS_TYPE_ANY);
+}
+
+// Parse service type from query name.
+// Returns 0 if it looks like a general service query (_service._proto.domain)
+// Returns 1 if it looks like a targeted instance query
+static int is_general_service_query(const char *qname) {
+    // General service queries start with underscore
+    return (qname[0] == '_');
+}
+
+// Extract service type and domain from general query name
+// E.g., "_http._tcp.local" -> service_type="_http._tcp", domain="local"
+static int parse_service_type_query(const char *qname, char *service_type,
+                                     size_t st_len, char *domain, size_t dom_len) {
+    const char *second_dot;
+    const char *third_dot;
+    
+    if (qname[0] != '_') {
+        return -1;
+    }
+    
+    // Find second underscore/dot
+    second_dot = strchr(qname + 1, '.');
+    if (second_dot == NULL) {
+        return -1;
+    }
+    
+    // Check if next part starts with underscore
+    if (second_dot[1] != '_') {
+        return -1;
+    }
+    
+    // Find the dot after _tcp or _udp
+    third_dot = strchr(second_dot + 1, '.');
+    if (third_dot == NULL) {
+        return -1;
+    }
+    
+    // Extract service type
+    size_t st_size = (size_t)(third_dot - qname);
+    if (st_size >= st_len) {
+        return -1;
+    }
+    memcpy(service_type, qname, st_size);
+    service_type[st_size] = '\0';
+    
+    // Extract domain (rest after third dot)
+    size_t dom_size = strlen(third_dot + 1);
+    if (dom_size >= dom_len) {
+        return -1;
+    }
+    strcpy(domain, third_dot + 1);
+    
+    // Remove trailing dot if present
+    if (dom_size > 0 && domain[dom_size - 1] == '.') {
+        domain[dom_size - 1] = '\0';
+    }
+    
+    return 0;
+}
+
+// Build the response for a single question from the host record and service list.
+// Returns packet length, 0 when there is nothing to answer, or -1 on build error.
+static int build_answer(const dns_question_t *question, const host_record_t *local_record,
+                        uint8_t *out, size_t out_len) {
+    // Handle A/AAAA queries, and ANY for our hostname
+    if (question->qtype == DNS_TYPE_A || question->qtype == DNS_TYPE_AAAA ||
+        question->qtype == DNS_TYPE_ANY) {
+        host_record_t match;
+
+        if (hostdb_lookup(local_record, question->name, &match) == 1) {
+            return mdns_build_response(out, out_len, question, &match);
+        }
+
+        if (question->qtype != DNS_TYPE_ANY) {
+            // A service instance name is ours too: deny addresses, list SRV/TXT
+            mdns_service_t *svc = mdns_find_service_by_fqdn(question->name);
+            if (svc != NULL) {
+                static const uint16_t instance_types[] = {DNS_TYPE_TXT, DNS_TYPE_SRV};
+                return mdns_build_nsec_response(out, out_len, question, instance_types, 2, svc->ttl);
+            }
+            log_debug("No match for qname %s", question->name);
+            return 0;
+        }
+    }
+
+    // Handle SRV queries, and ANY for service names (SRV + TXT)
+    if (question->qtype == DNS_TYPE_SRV || question->qtype == DNS_TYPE_ANY) {
+        mdns_service_t *services[32];
+        size_t service_count = 0;
+
+        if (is_general_service_query(question->name)) {
+            // General query: return all services of this type
+            char service_type[256];
+            char domain[256];
+
+            if (parse_service_type_query(question->name, service_type,
+                                         sizeof(service_type), domain,
+                                         sizeof(domain)) == 0) {
+                service_count = mdns_find_services_by_type(service_type, domain,
+                                                           services, 32);
+            }
+        } else {
+            // Targeted query: return specific instance
+            mdns_service_t *svc = mdns_find_service_by_fqdn(question->name);
+            if (svc != NULL) {
+                services[0] = svc;
+                service_count = 1;
+            }
+        }
+
+        if (service_count == 0) {
+            host_record_t match;
+
+            // Our hostname has no SRV record: answer with the types it does have
+            if (question->qtype == DNS_TYPE_SRV &&
+                hostdb_lookup(local_record, question->name, &match) == 1) {
+                uint16_t types[2];
+                size_t type_count = 0;
+
+                if (match.has_ipv4) {
+                    types[type_count++] = DNS_TYPE_A;
+                }
+                if (match.has_ipv6) {
+                    types[type_count++] = DNS_TYPE_AAAA;
+                }
+                return mdns_build_nsec_response(out, out_len, question, types, type_count, match.ttl);
+            }
+            log_debug("No service match for %s", question->name);
+            return 0;
+        }
+
+        return mdns_build_service_response(out, out_len, question, services, service_count);
+    }
+
+    return 0;
+}
+
+static int allow_multicast_record(void *user, const char *name, uint16_t type) {
+    mdns_responder_t *responder = user;
+
+    if (ratelimit_allow_record(name, type, responder->ifindex, responder->now_ms)) {
+        return 1;
+    }
+    responder->suppressed++;
+    return 0;
+}
+
+// RFC 6762 section 6: each record is multicast at most once per second,
+// whichever question asked for it. Rewrites *records to the answers less
+// the records multicast too recently; returns how many are left, or -1.
+static int limit_multicast_records(mdns_responder_t *responder, const uint8_t **records, size_t *records_len,
+                                   uint16_t record_count, uint64_t now_ms) {
+    int len;
+
+    // Records just built are still a whole response in scratch; cached ones
+    // need a header in front to be read as one
+    if (*records == &responder->scratch[WIRE_HEADER_LEN]) {
+        len = (int)(WIRE_HEADER_LEN + *records_len);
+    } else {
+        len = mdns_begin_response(responder->scratch, MDNS_MAX_PACKET);
+        if (len < 0) {
+            return -1;
+        }
+        len = mdns_append_answers(responder->scratch, (size_t)len, MDNS_MAX_PACKET, *records, *records_len,
+                                  record_count);
+        if (len < 0) {
+            return -1;
+        }
+    }
+
+    responder->now_ms = now_ms;
+    responder->suppressed = 0;
+    len = mdns_filter_answers(responder->scratch, (size_t)len, responder->limited, MDNS_MAX_PACKET,
+                              allow_multicast_record, responder);
+    if (len < 0) {
+        return -1;
+    }
+    responder->metrics.suppressed_answers += responder->suppressed;
+    *records = &responder->limited[WIRE_HEADER_LEN];
+    *records_len = (size_t)len - WIRE_HEADER_LEN;
+    return wire_read_u16(&responder->limited[6]);
+}
+
+// Question section a legacy reply repeats, at most: labels take a length
+// byte per dot, plus the root and the type and class
+static size_t legacy_question_space(const dns_question_t *questions, size_t count) {
+    size_t space = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        space += strlen(questions[i].name) + 2 + 4;
+    }
+    return space;
+}
+
+// Add one question's answer records to the open packet for route, starting
+// another packet when they do not fit. reserve is kept free for the question
+// section of a legacy reply. Returns 0, or -1 if the answers are dropped.
+static int add_answers(mdns_responder_t *responder, mdns_route_t route, const struct sockaddr_in6 *src,
+                       const dns_question_t *question, const uint8_t *records, size_t records_len,
+                       uint16_t record_count, size_t reserve) {
+    size_t index = responder->open_packet[route];
+    mdns_packet_out_t *result;
+    uint8_t *out_buf;
+    int new_len;
+
+    if (index == NO_PACKET || responder->out[index].len + records_len + reserve > MDNS_MAX_PACKET) {
+        int header_len;
+
+        if (responder->out_count == MDNS_MAX_QUESTIONS) {
+            return -1;
+        }
+        index = responder->out_count;
+        header_len = mdns_begin_response(responder->out_bufs[index], MDNS_MAX_PACKET);
+        if (header_len < 0 || (size_t)header_len + records_len + reserve > MDNS_MAX_PACKET) {
+            return -1;
+        }
+        result = &responder->out[index];
+        result->data = responder->out_bufs[index];
+        result->len = (size_t)header_len;
+        result->dest = route == MDNS_ROUTE_MULTICAST ? responder->mcast_addr : *src;
+        result->route = route;
+        result->question = question;
+        result->question_count = 0;
+        responder->open_packet[route] = index;
+        responder->out_count++;
+    }
+
+    result = &responder->out[index];
+    out_buf = responder->out_bufs[index];
+    new_len = mdns_append_answers(out_buf, result->len, MDNS_MAX_PACKET - reserve, records, records_len,
+                                  record_count);
+    if (new_len < 0) {
+        return -1;
+    }
+    result->len = (size_t)new_len;
+    result->question_count++;
+    return 0;
+}
+
+mdns_responder_t *mdns_responder_create(const host_record_t *local_record, unsigned int ifindex) {
+    mdns_responder_t *responder;
+
+    if (local_record == NULL) {
+        return NULL;
+    }
+
+    responder = calloc(1, sizeof(*responder));
+    if (responder == NULL) {
+        return NULL;
+    }
+
+    responder->local_record = *local_record;
+    responder->ifindex = ifindex;
+    responder->rate_limit = 1;
+    responder->mcast_addr.sin6_family = AF_INET6;
+    responder->mcast_addr.sin6_port = htons(MDNS_PORT);
+    responder->mcast_addr.sin6_scope_id = ifindex;
+    inet_pton(AF_INET6, "ff02::fb", &responder->mcast_addr.sin6_addr);
+    return responder;
+}
+
+void mdns_responder_destroy(mdns_responder_t *responder) {
+    free(responder);
+}
+
+void mdns_responder_set_rate_limit(mdns_responder_t *responder, int enabled) {
+    responder->rate_limit = enabled;
+}
+
+mdns_metrics_t *mdns_responder_metrics(mdns_responder_t *responder) {
+    return &responder->metrics;
+}
+
+size_t mdns_responder_respond(mdns_responder_t *responder, const uint8_t *packet, size_t len,
+                              const struct sockaddr_in6 *src, uint64_t now_ms,
+                              const mdns_packet_out_t **out) {
+    int parsed;
+    uint32_t generation;
+    size_t legacy_reserve = 0;
+
+    *out = responder->out;
+    responder->metrics.packets_in++;
+    responder->metrics.bytes_in += len;
+
+    if (is_response_packet(packet, len)) {
+        return 0;
+    }
+
+    if (responder->rate_limit && !ratelimit_allow_source(&src->sin6_addr, now_ms)) {
+        responder->metrics.rate_limited++;
+        log_debug("Dropping query from rate-limited source");
+        return 0;
+    }
+
+    parsed = mdns_parse_questions(packet, len, responder->questions, MDNS_MAX_QUESTIONS);
+    if (parsed <= 0) {
+        if (parsed < 0) {
+            responder->metrics.parse_errors++;
+        }
+        return 0;
+    }
+
+    generation = mdns_services_generation();
+    responder->out_count = 0;
+    for (size_t r = 0; r < ROUTE_COUNT; r++) {
+        responder->open_packet[r] = NO_PACKET;
+    }
+    if (ntohs(src->sin6_port) != MDNS_PORT) {
+        legacy_reserve = legacy_question_space(responder->questions, (size_t)parsed);
+    }
+
+    // The answers to all questions that share a route go out in one packet,
+    // so an A+AAAA query costs one response rather than two
+    for (int q = 0; q < parsed; q++) {
+        const dns_question_t *question = &responder->questions[q];
+        const uint8_t *records;
+        size_t records_len;
+        uint16_t record_count;
+        mdns_route_t route;
+
+        metrics_count_query(&responder->metrics, question->qtype);
+
+        if (!is_supported_query_type(question->qtype)) {
+            log_debug("Ignoring unsupported qtype %u for %s", question->qtype, question->name);
+            continue;
+        }
+
+        if (!response_cache_lookup(question, responder->ifindex, generation, &records, &records_len,
+                                   &record_count)) {
+            int out_len = build_answer(question, &responder->local_record, responder->scratch, MDNS_MAX_PACKET);
+            if (out_len < 0) {
+                continue;
+            }
+            records = &responder->scratch[WIRE_HEADER_LEN];
+            records_len = out_len > 0 ? (size_t)out_len - WIRE_HEADER_LEN : 0;
+            record_count = out_len > 0 ? wire_read_u16(&responder->scratch[6]) : 0;
+            response_cache_store(question, responder->ifindex, generation, records, records_len, record_count);
+        }
+
+        if (record_count == 0) {
+            continue;
+        }
+
+        route = select_route(src, question);
+        if (route == MDNS_ROUTE_MULTICAST && responder->rate_limit && !is_probe_query(packet, len)) {
+            int kept = limit_multicast_records(responder, &records, &records_len, record_count, now_ms);
+            if (kept <= 0) {
+                log_debug("Suppressed the answers to %s type %u: multicast less than 1s ago",
+                          question->name, question->qtype);
+                continue;
+            }
+            record_count = (uint16_t)kept;
+        }
+        // Copied into the packet now, before a later store can evict it
+        if (add_answers(responder, route, src, question, records, records_len, record_count,
+                        route == MDNS_ROUTE_LEGACY_UNICAST ? legacy_reserve : 0) != 0) {
+            log_debug("No room for the answers to %s type %u", question->name, question->qtype);
+        }
+    }
+
+    // Legacy replies repeat every question of the query, with its ID. All
+    // packets of one datagram share a route then.
+    if (legacy_reserve > 0) {
+        size_t kept = 0;
+
+        for (size_t i = 0; i < responder->out_count; i++) {
+            mdns_packet_out_t *result = &responder->out[i];
+            // Not moved yet: packet i is still in out_bufs[i]
+            int legacy_len = mdns_prepare_legacy_unicast(responder->out_bufs[i], result->len, MDNS_MAX_PACKET,
+                                                         mdns_packet_id(packet, len), responder->questions,
+                                                         (size_t)parsed, MDNS_LEGACY_UNICAST_TTL);
+            if (legacy_len < 0) {
+                continue;
+            }
+            result->len = (size_t)legacy_len;
+            responder->out[kept++] = *result;
+        }
+        responder->out_count = kept;
+    }
+
+    return responder->out_count;
+}
@@ -0,0 +1,136 @@
+#include "response_cache.h"
+
+#include <ctype.h>
+#include <string.h>
+
+typedef struct {
+    int in_use;
+    uint32_t hash;
+    uint64_t last_used;
+    char name[256];
+    uint16_t qtype;
+    unsigned int ifindex;
+    uint16_t count;
+    size_t len;
+    uint8_t records[MDNS_MAX_PACKET];
+} cache_slot_t;
+
+static cache_slot_t slots[RESPONSE_CACHE_SLOTS];
+static uint32_t cache_generation = 0;
+static uint64_t use_clock = 0;
+
+// Lowercase and strip the trailing dot so "Host.local." and "host.local" share a slot
+static int normalize_qname(const char *name, char *out, size_t out_len) {
+    size_t len = strlen(name);
+
+    if (len >= out_len) {
+        return -1;
+    }
+    if (len > 0 && name[len - 1] == '.') {
+        len--;
+    }
+    for (size_t i = 0; i < len; i++) {
+        out[i] = (char)tolower((unsigned char)name[i]);
+    }
+    out[len] = '\0';
+    return 0;
+}
+
+// FNV-1a over the normalized key
+static uint32_t hash_key(const char *name, uint16_t qtype, unsigned int ifindex) {
+    uint32_t hash = 2166136261u;
+
+    while (*name != '\0') {
+        hash ^= (uint8_t)*name++;
+        hash *= 16777619u;
+    }
+    hash ^= qtype;
+    hash *= 16777619u;
+    hash ^= ifindex;
+    hash *= 16777619u;
+    return hash;
+}
+
+static void sync_generation(uint32_t generation) {
+    if (generation != cache_generation) {
+        response_cache_clear();
+        cache_generation = generation;
+    }
+}
+
+int response_cache_lookup(const dns_question_t *question, unsigned int ifindex, uint32_t generation,
+                          const uint8_t **records_out, size_t *len_out, uint16_t *count_out) {
+    char name[256];
+    uint32_t hash;
+
+    if (question == NULL || records_out == NULL || len_out == NULL || count_out == NULL) {
+        return 0;
+    }
+
+    sync_generation(generation);
+
+    if (normalize_qname(question->name, name, sizeof(name)) != 0) {
+        return 0;
+    }
+    hash = hash_key(name, question->qtype, ifindex);
+
+    for (size_t i = 0; i < RESPONSE_CACHE_SLOTS; i++) {
+        cache_slot_t *slot = &slots[i];
+        if (!slot->in_use || slot->hash != hash || slot->qtype != question->qtype ||
+            slot->ifindex != ifindex || strcmp(slot->name, name) != 0) {
+            continue;
+        }
+        slot->last_used = ++use_clock;
+        *records_out = slot->records;
+        *len_out = slot->len;
+        *count_out = slot->count;
+        return 1;
+    }
+
+    return 0;
+}
+
+void response_cache_store(const dns_question_t *question, unsigned int ifindex, uint32_t generation,
+                          const uint8_t *records, size_t len, uint16_t count) {
+    char name[256];
+    cache_slot_t *victim = NULL;
+
+    if (question == NULL || len > MDNS_MAX_PACKET || (len > 0 && records == NULL)) {
+        return;
+    }
+
+    sync_generation(generation);
+
+    if (normalize_qname(question->name, name, sizeof(name)) != 0) {
+        return;
+    }
+
+    // Prefer a free slot, otherwise the least recently used one
+    for (size_t i = 0; i < RESPONSE_CACHE_SLOTS; i++) {
+        if (!slots[i].in_use) {
+            victim = &slots[i];
+            break;
+        }
+        if (victim == NULL || slots[i].last_used < victim->last_used) {
+            victim = &slots[i];
+        }
+    }
+
+    victim->in_use = 1;
+    victim->hash = hash_key(name, question->qtype, ifindex);
+    victim->last_used = ++use_clock;
+    memcpy(victim->name, name, strlen(name) + 1);
+    victim->qtype = question->qtype;
+    victim->ifindex = ifindex;
+    victim->count = count;
+    victim->len = len;
+    if (len > 0) {
+        memcpy(victim->records, records, len);
+    }
+}
+
+void response_cache_clear(void) {
+    for (size_t i = 0; i < RESPONSE_CACHE_SLOTS; i++) {
+        slots[i].in_use = 0;
+    }
+}
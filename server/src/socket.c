@@ -1,14 +1,26 @@
+#define _DEFAULT_SOURCE
+
 #include "socket.h"
 
 #include <arpa/inet.h>
+#include <linux/filter.h>
 #include <net/if.h>
 #include <netinet/in.h>
+#include <stdint.h>
 #include <string.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #define MDNS_PORT 5353
 
+// UDP socket filters see the packet from the UDP header on
+#define FILTER_DNS_OFFSET 8
+#define FILTER_MAX_FINGERPRINTS 512
+#define FILTER_MAX_INSNS (10 + FILTER_MAX_FINGERPRINTS * 5 + 1)
+#define FILTER_ACCEPT 0xFFFFFFFFu
+#define FILTER_DROP 0u
+
 int mdns_socket_open(const char *ifname) {
     int fd;
     int yes;
@@ -79,3 +91,169 @@ void mdns_socket_close(int fd) {
         close(fd);
     }
 }
+
+int mdns_socket_enable_timestamps(int fd) {
+    int yes = 1;
+    return setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &yes, sizeof(yes)) < 0 ? -1 : 0;
+}
+
+size_t mdns_socket_timestamp_control_len(void) {
+    return CMSG_SPACE(sizeof(struct timespec));
+}
+
+int mdns_socket_parse_timestamp(const void *control, size_t control_len, struct timespec *rx_time) {
+    // Copy into aligned storage: io_uring hands the control data back unaligned
+    union {
+        struct cmsghdr align;
+        uint8_t data[CMSG_SPACE(sizeof(struct timespec)) * 2];
+    } buf;
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+
+    memset(rx_time, 0, sizeof(*rx_time));
+    if (control == NULL || control_len == 0) {
+        return -1;
+    }
+    if (control_len > sizeof(buf.data)) {
+        control_len = sizeof(buf.data);
+    }
+    memcpy(buf.data, control, control_len);
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control = buf.data;
+    msg.msg_controllen = control_len;
+    for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+            memcpy(rx_time, CMSG_DATA(cmsg), sizeof(*rx_time));
+            return 0;
+        }
+    }
+    return -1;
+}
+
+ssize_t mdns_socket_recv(int fd, void *buf, size_t len, struct sockaddr_in6 *src,
+                         struct timespec *rx_time) {
+    union {
+        struct cmsghdr align;
+        uint8_t data[CMSG_SPACE(sizeof(struct timespec))];
+    } control;
+    struct iovec iov;
+    struct msghdr msg;
+    ssize_t nread;
+
+    iov.iov_base = buf;
+    iov.iov_len = len;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = src;
+    msg.msg_namelen = sizeof(*src);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.data;
+    msg.msg_controllen = sizeof(control.data);
+
+    nread = recvmsg(fd, &msg, 0);
+    if (nread >= 0) {
+        mdns_socket_parse_timestamp(control.data, msg.msg_controllen, rx_time);
+    }
+    return nread;
+}
+
+// Fingerprint of a name's first label: length plus its first two wire bytes
+// with 0x20 OR-ed in, matching what the filter computes from the packet
+typedef struct {
+    uint8_t len;
+    uint16_t head;
+} label_fingerprint_t;
+
+static int fingerprint_name(const char *name, label_fingerprint_t *out) {
+    const char *dot = strchr(name, '.');
+    size_t len = dot ? (size_t)(dot - name) : strlen(name);
+    uint8_t second;
+
+    if (len == 0 || len > 63) {
+        return -1;
+    }
+
+    // For two-byte heads on 1-byte labels the second byte is the next
+    // label length, so only the length is compared for those
+    second = len > 1 ? (uint8_t)name[1] : 0;
+    out->len = (uint8_t)len;
+    out->head = (uint16_t)((((uint8_t)name[0] << 8) | second) | 0x2020);
+    return 0;
+}
+
+int mdns_socket_attach_filter(int fd, const char *const *names, size_t name_count) {
+    label_fingerprint_t prints[FILTER_MAX_FINGERPRINTS];
+    struct sock_filter insns[FILTER_MAX_INSNS];
+    struct sock_fprog prog;
+    size_t print_count = 0;
+    size_t n = 0;
+    int filter_names = names != NULL;
+
+    for (size_t i = 0; filter_names && i < name_count; i++) {
+        label_fingerprint_t fp;
+        size_t j;
+
+        if (names[i] == NULL || fingerprint_name(names[i], &fp) != 0) {
+            continue;
+        }
+        for (j = 0; j < print_count; j++) {
+            if (prints[j].len == fp.len && (fp.len == 1 || prints[j].head == fp.head)) {
+                break;
+            }
+        }
+        if (j < print_count) {
+            continue;
+        }
+        if (print_count == FILTER_MAX_FINGERPRINTS) {
+            filter_names = 0;  // Too many to encode: fall back to dropping responses only
+            break;
+        }
+        prints[print_count++] = fp;
+    }
+
+    // Drop responses: QR is the top bit of the flags word
+    insns[n++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_B | BPF_ABS, FILTER_DNS_OFFSET + 2);
+    insns[n++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, 0x80, 0, 1);
+    insns[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, FILTER_DROP);
+
+    if (filter_names) {
+        // Only single-question queries are judged by name
+        insns[n++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_H | BPF_ABS, FILTER_DNS_OFFSET + 4);
+        insns[n++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 1, 1, 0);
+        insns[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, FILTER_ACCEPT);
+
+        // X = case-folded first two label bytes, A = first label length
+        insns[n++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_H | BPF_ABS, FILTER_DNS_OFFSET + 13);
+        insns[n++] = (struct sock_filter)BPF_STMT(BPF_ALU | BPF_OR | BPF_K, 0x2020);
+        insns[n++] = (struct sock_filter)BPF_STMT(BPF_MISC | BPF_TAX, 0);
+        insns[n++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_B | BPF_ABS, FILTER_DNS_OFFSET + 12);
+
+        for (size_t i = 0; i < print_count; i++) {
+            if (prints[i].len == 1) {
+                insns[n++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 1, 0, 1);
+                insns[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, FILTER_ACCEPT);
+                continue;
+            }
+            insns[n++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, prints[i].len, 0, 3);
+            insns[n++] = (struct sock_filter)BPF_STMT(BPF_MISC | BPF_TXA, 0);
+            insns[n++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, prints[i].head, 0, 1);
+            insns[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, FILTER_ACCEPT);
+            insns[n++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_B | BPF_ABS, FILTER_DNS_OFFSET + 12);
+        }
+        insns[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, FILTER_DROP);
+    } else {
+        insns[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, FILTER_ACCEPT);
+    }
+
+    memset(&prog, 0, sizeof(prog));
+    prog.len = (unsigned short)n;
+    prog.filter = insns;
+
+    // Replaces any previously attached program atomically
+    if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog)) < 0) {
+        return -1;
+    }
+
+    return filter_names ? (int)print_count : 0;
+}
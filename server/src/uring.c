@@ -0,0 +1,443 @@
+#define _DEFAULT_SOURCE
+
+#include "uring.h"
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "log.h"
+#include "mdns.h"
+#include "socket.h"
+
+#define URING_ENTRIES 256
+#define URING_RECV_BUFFERS 256  // power of two, provided buffer ring size
+#define URING_RECV_BUF_SIZE 2048
+#define URING_SEND_SLOTS 128
+#define URING_BUFFER_GROUP 1
+
+// user_data: kind in the high 32 bits, slot index in the low 32 bits
+#define URING_TAG_RECV 1ull
+#define URING_TAG_SEND 2ull
+#define URING_TAG_TIMEOUT 3ull
+
+typedef struct {
+    uint8_t data[MDNS_MAX_PACKET];
+    struct sockaddr_in6 dest;
+    struct iovec iov;
+    struct msghdr msg;
+    uint64_t cookie;
+} send_slot_t;
+
+struct mdns_uring {
+    int ring_fd;
+    int sockfd;
+
+    // Submission queue
+    void *sq_ptr;
+    size_t sq_size;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+    unsigned sq_local_tail;
+    unsigned sq_submitted;
+
+    // Completion queue
+    void *cq_ptr;
+    size_t cq_size;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe *cqes;
+
+    // Provided receive buffers and the multishot recvmsg template
+    struct io_uring_buf_ring *buf_ring;
+    size_t buf_ring_size;
+    uint8_t *recv_bufs;
+    uint16_t buf_tail;
+    struct msghdr recv_msg;
+    int recv_armed;
+
+    struct __kernel_timespec timeout;
+    int timeout_armed;
+
+    send_slot_t *slots;
+    unsigned free_slots[URING_SEND_SLOTS];
+    unsigned free_count;
+};
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *params) {
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static struct io_uring_sqe *get_sqe(mdns_uring_t *ring) {
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    struct io_uring_sqe *sqe;
+
+    if (ring->sq_local_tail - head >= ring->sq_entries) {
+        return NULL;
+    }
+
+    sqe = &ring->sqes[ring->sq_local_tail & ring->sq_mask];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_array[ring->sq_local_tail & ring->sq_mask] = ring->sq_local_tail & ring->sq_mask;
+    ring->sq_local_tail++;
+    return sqe;
+}
+
+// Publish queued SQEs and enter the kernel once for submit + wait
+static int submit_and_wait(mdns_uring_t *ring, unsigned min_complete) {
+    unsigned to_submit = ring->sq_local_tail - ring->sq_submitted;
+    int ret;
+
+    __atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+
+    if (to_submit == 0 && min_complete == 0) {
+        return 0;
+    }
+
+    ret = sys_io_uring_enter(ring->ring_fd, to_submit, min_complete,
+                             min_complete > 0 ? IORING_ENTER_GETEVENTS : 0);
+    if (ret < 0) {
+        // Interrupted by a signal: unsubmitted entries go out on the next call
+        return errno == EINTR ? 0 : -1;
+    }
+
+    ring->sq_submitted += (unsigned)ret;
+    return 0;
+}
+
+static void provide_buffer(mdns_uring_t *ring, uint16_t bid) {
+    struct io_uring_buf *buf = &ring->buf_ring->bufs[ring->buf_tail & (URING_RECV_BUFFERS - 1)];
+
+    buf->addr = (uint64_t)(uintptr_t)&ring->recv_bufs[(size_t)bid * URING_RECV_BUF_SIZE];
+    buf->len = URING_RECV_BUF_SIZE;
+    buf->bid = bid;
+    ring->buf_tail++;
+    __atomic_store_n(&ring->buf_ring->tail, ring->buf_tail, __ATOMIC_RELEASE);
+}
+
+static int arm_recv(mdns_uring_t *ring) {
+    struct io_uring_sqe *sqe = get_sqe(ring);
+
+    if (sqe == NULL) {
+        return -1;
+    }
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = ring->sockfd;
+    sqe->addr = (uint64_t)(uintptr_t)&ring->recv_msg;
+    sqe->len = 1;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BUFFER_GROUP;
+    sqe->user_data = URING_TAG_RECV << 32;
+    ring->recv_armed = 1;
+    return 0;
+}
+
+static int arm_timeout(mdns_uring_t *ring, int timeout_ms) {
+    struct io_uring_sqe *sqe = get_sqe(ring);
+
+    if (sqe == NULL) {
+        return -1;
+    }
+    ring->timeout.tv_sec = timeout_ms / 1000;
+    ring->timeout.tv_nsec = (long long)(timeout_ms % 1000) * 1000000LL;
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->fd = -1;
+    sqe->addr = (uint64_t)(uintptr_t)&ring->timeout;
+    sqe->len = 1;
+    sqe->user_data = URING_TAG_TIMEOUT << 32;
+    ring->timeout_armed = 1;
+    return 0;
+}
+
+mdns_uring_t *mdns_uring_create(int sockfd) {
+    struct io_uring_params params;
+    struct io_uring_buf_reg reg;
+    mdns_uring_t *ring;
+
+    ring = calloc(1, sizeof(*ring));
+    if (ring == NULL) {
+        return NULL;
+    }
+    ring->ring_fd = -1;
+    ring->sockfd = sockfd;
+
+    memset(&params, 0, sizeof(params));
+    ring->ring_fd = sys_io_uring_setup(URING_ENTRIES, &params);
+    if (ring->ring_fd < 0) {
+        log_debug("io_uring_setup failed: %s", strerror(errno));
+        mdns_uring_destroy(ring);
+        return NULL;
+    }
+
+    ring->sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_size > ring->sq_size) {
+            ring->sq_size = ring->cq_size;
+        }
+        ring->cq_size = ring->sq_size;
+    }
+
+    ring->sq_ptr = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ring->ring_fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ptr == MAP_FAILED) {
+        ring->sq_ptr = NULL;
+        mdns_uring_destroy(ring);
+        return NULL;
+    }
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ptr = ring->sq_ptr;
+    } else {
+        ring->cq_ptr = mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                            ring->ring_fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ptr == MAP_FAILED) {
+            ring->cq_ptr = NULL;
+            mdns_uring_destroy(ring);
+            return NULL;
+        }
+    }
+
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring->ring_fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = NULL;
+        mdns_uring_destroy(ring);
+        return NULL;
+    }
+
+    ring->sq_head = (unsigned *)((uint8_t *)ring->sq_ptr + params.sq_off.head);
+    ring->sq_tail = (unsigned *)((uint8_t *)ring->sq_ptr + params.sq_off.tail);
+    ring->sq_mask = *(unsigned *)((uint8_t *)ring->sq_ptr + params.sq_off.ring_mask);
+    ring->sq_entries = params.sq_entries;
+    ring->sq_array = (unsigned *)((uint8_t *)ring->sq_ptr + params.sq_off.array);
+    ring->sq_local_tail = *ring->sq_tail;
+    ring->sq_submitted = ring->sq_local_tail;
+
+    ring->cq_head = (unsigned *)((uint8_t *)ring->cq_ptr + params.cq_off.head);
+    ring->cq_tail = (unsigned *)((uint8_t *)ring->cq_ptr + params.cq_off.tail);
+    ring->cq_mask = *(unsigned *)((uint8_t *)ring->cq_ptr + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)((uint8_t *)ring->cq_ptr + params.cq_off.cqes);
+
+    // Provided buffer ring: the kernel picks a buffer per received datagram
+    ring->buf_ring_size = URING_RECV_BUFFERS * sizeof(struct io_uring_buf);
+    ring->buf_ring = mmap(NULL, ring->buf_ring_size, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring->buf_ring == MAP_FAILED) {
+        ring->buf_ring = NULL;
+        mdns_uring_destroy(ring);
+        return NULL;
+    }
+    ring->recv_bufs = malloc((size_t)URING_RECV_BUFFERS * URING_RECV_BUF_SIZE);
+    ring->slots = calloc(URING_SEND_SLOTS, sizeof(send_slot_t));
+    if (ring->recv_bufs == NULL || ring->slots == NULL) {
+        mdns_uring_destroy(ring);
+        return NULL;
+    }
+
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)ring->buf_ring;
+    reg.ring_entries = URING_RECV_BUFFERS;
+    reg.bgid = URING_BUFFER_GROUP;
+    if (sys_io_uring_register(ring->ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        log_debug("io_uring buffer ring registration failed: %s", strerror(errno));
+        mdns_uring_destroy(ring);
+        return NULL;
+    }
+    for (uint16_t bid = 0; bid < URING_RECV_BUFFERS; bid++) {
+        provide_buffer(ring, bid);
+    }
+
+    for (unsigned i = 0; i < URING_SEND_SLOTS; i++) {
+        ring->free_slots[i] = URING_SEND_SLOTS - 1 - i;
+    }
+    ring->free_count = URING_SEND_SLOTS;
+
+    // Multishot recvmsg reports the source address and receive timestamp in each buffer
+    memset(&ring->recv_msg, 0, sizeof(ring->recv_msg));
+    ring->recv_msg.msg_namelen = sizeof(struct sockaddr_in6);
+    ring->recv_msg.msg_controllen = mdns_socket_timestamp_control_len();
+
+    if (arm_recv(ring) != 0) {
+        mdns_uring_destroy(ring);
+        return NULL;
+    }
+
+    return ring;
+}
+
+void mdns_uring_destroy(mdns_uring_t *ring) {
+    if (ring == NULL) {
+        return;
+    }
+    if (ring->sqes != NULL) {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if (ring->cq_ptr != NULL && ring->cq_ptr != ring->sq_ptr) {
+        munmap(ring->cq_ptr, ring->cq_size);
+    }
+    if (ring->sq_ptr != NULL) {
+        munmap(ring->sq_ptr, ring->sq_size);
+    }
+    if (ring->ring_fd >= 0) {
+        close(ring->ring_fd);
+    }
+    if (ring->buf_ring != NULL) {
+        munmap(ring->buf_ring, ring->buf_ring_size);
+    }
+    free(ring->recv_bufs);
+    free(ring->slots);
+    free(ring);
+}
+
+int mdns_uring_send(mdns_uring_t *ring, const uint8_t *packet, size_t len,
+                    const struct sockaddr_in6 *dest, uint64_t cookie) {
+    struct io_uring_sqe *sqe;
+    send_slot_t *slot;
+    unsigned index;
+
+    if (ring == NULL || packet == NULL || dest == NULL || len > MDNS_MAX_PACKET) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // Out of slots or SQEs: fall back to a direct syscall rather than drop
+    if (ring->free_count == 0) {
+        return sendto(ring->sockfd, packet, len, 0, (const struct sockaddr *)dest, sizeof(*dest)) < 0 ? -1 : 0;
+    }
+    sqe = get_sqe(ring);
+    if (sqe == NULL) {
+        return sendto(ring->sockfd, packet, len, 0, (const struct sockaddr *)dest, sizeof(*dest)) < 0 ? -1 : 0;
+    }
+
+    index = ring->free_slots[--ring->free_count];
+    slot = &ring->slots[index];
+    memcpy(slot->data, packet, len);
+    slot->dest = *dest;
+    slot->iov.iov_base = slot->data;
+    slot->iov.iov_len = len;
+    memset(&slot->msg, 0, sizeof(slot->msg));
+    slot->msg.msg_name = &slot->dest;
+    slot->msg.msg_namelen = sizeof(slot->dest);
+    slot->msg.msg_iov = &slot->iov;
+    slot->msg.msg_iovlen = 1;
+    slot->cookie = cookie;
+
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = ring->sockfd;
+    sqe->addr = (uint64_t)(uintptr_t)&slot->msg;
+    sqe->len = 1;
+    sqe->user_data = (URING_TAG_SEND << 32) | index;
+    return 1;
+}
+
+static void handle_recv_cqe(mdns_uring_t *ring, const struct io_uring_cqe *cqe,
+                            mdns_uring_packet_fn on_packet, void *user) {
+    if (!(cqe->flags & IORING_CQE_F_MORE)) {
+        ring->recv_armed = 0;
+    }
+
+    if (cqe->res < 0) {
+        // ENOBUFS just means every buffer was in flight; re-arming is enough
+        if (cqe->res != -ENOBUFS) {
+            log_warn("io_uring recvmsg failed: %s", strerror(-cqe->res));
+        }
+        return;
+    }
+
+    if (cqe->flags & IORING_CQE_F_BUFFER) {
+        uint16_t bid = (uint16_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+        uint8_t *buf = &ring->recv_bufs[(size_t)bid * URING_RECV_BUF_SIZE];
+        const struct io_uring_recvmsg_out *out = (const struct io_uring_recvmsg_out *)buf;
+        const uint8_t *name = buf + sizeof(*out);
+        const uint8_t *payload = name + ring->recv_msg.msg_namelen + ring->recv_msg.msg_controllen;
+        size_t room = URING_RECV_BUF_SIZE - (size_t)(payload - buf);
+
+        if (!(out->flags & MSG_TRUNC) && out->payloadlen <= room &&
+            out->namelen >= sizeof(struct sockaddr_in6)) {
+            struct sockaddr_in6 src;
+            struct timespec rx_time;
+            memcpy(&src, name, sizeof(src));
+            mdns_socket_parse_timestamp(name + ring->recv_msg.msg_namelen, out->controllen, &rx_time);
+            on_packet(user, payload, out->payloadlen, &src, &rx_time);
+        }
+        provide_buffer(ring, bid);
+    }
+}
+
+int mdns_uring_poll(mdns_uring_t *ring, int timeout_ms, mdns_uring_packet_fn on_packet,
+                    mdns_uring_sent_fn on_sent, void *user) {
+    unsigned head;
+    unsigned tail;
+
+    if (ring == NULL || on_packet == NULL || on_sent == NULL) {
+        return -1;
+    }
+
+    if (!ring->recv_armed && arm_recv(ring) != 0) {
+        return -1;
+    }
+    if (!ring->timeout_armed && timeout_ms > 0 && arm_timeout(ring, timeout_ms) != 0) {
+        return -1;
+    }
+
+    if (submit_and_wait(ring, 1) != 0) {
+        log_error("io_uring_enter failed: %s", strerror(errno));
+        return -1;
+    }
+
+    head = *ring->cq_head;
+    tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    while (head != tail) {
+        const struct io_uring_cqe *cqe = &ring->cqes[head & ring->cq_mask];
+        uint64_t kind = cqe->user_data >> 32;
+
+        if (kind == URING_TAG_RECV) {
+            if (cqe->res == -EINVAL && !(cqe->flags & IORING_CQE_F_MORE)) {
+                // Kernel without multishot recvmsg / provided buffer rings
+                log_error("io_uring multishot recvmsg not supported by this kernel");
+                __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+                return -1;
+            }
+            handle_recv_cqe(ring, cqe, on_packet, user);
+        } else if (kind == URING_TAG_SEND) {
+            unsigned index = (unsigned)(cqe->user_data & 0xFFFFFFFFu);
+            if (index < URING_SEND_SLOTS) {
+                const send_slot_t *slot = &ring->slots[index];
+                on_sent(user, slot->iov.iov_len, cqe->res < 0 ? -cqe->res : 0, slot->cookie);
+                ring->free_slots[ring->free_count++] = index;
+            }
+        } else if (kind == URING_TAG_TIMEOUT) {
+            ring->timeout_armed = 0;
+        }
+
+        head++;
+        // Release each entry as we go so on_packet can keep the CQ from overflowing
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+        tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    }
+
+    return 0;
+}
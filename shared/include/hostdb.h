@@ -36,6 +36,10 @@ int mdns_update_service(const mdns_service_t *svc);
 int mdns_unregister_service(const char *instance_fqdn);
 size_t mdns_list_services(mdns_service_t **out, size_t max_items);
 
+// Generation counter, bumped on every register/update/unregister/cleanup.
+// Callers caching data derived from the service list compare against it.
+uint32_t mdns_services_generation(void);
+
 // Service lookup API
 mdns_service_t *mdns_find_service_by_fqdn(const char *fqdn);
 size_t mdns_find_services_by_type(const char *service_type, const char *domain,
@@ -14,10 +14,37 @@ int log_init(log_level_t level, int use_syslog);
 void log_close(void);
 void log_message(log_level_t level, const char *fmt, ...);
 
-#define log_error(...) log_message(APP_LOG_ERROR, __VA_ARGS__)
-#define log_warn(...)  log_message(APP_LOG_WARN, __VA_ARGS__)
-#define log_info(...)  log_message(APP_LOG_INFO, __VA_ARGS__)
-#define log_debug(...) log_message(APP_LOG_DEBUG, __VA_ARGS__)
+// Async mode: log_message() only captures level, timestamp, format pointer
+// and arguments into a lock-free single-producer ring; a background thread
+// formats and writes them. Only one thread may log while async mode is on.
+// The format string must be a literal (it is read later by the writer).
+// log_close() drains the ring and stops the thread.
+int log_start_async(void);
+
+// Lowest severity compiled in; calls below it are removed entirely.
+// Set from the Makefile with LOG_MIN_LEVEL=ERROR|WARN|INFO|DEBUG.
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL APP_LOG_DEBUG
+#endif
+
+// Runtime verbosity set by log_init(); read inline so disabled calls cost
+// one compare and never evaluate their arguments
+extern log_level_t log_runtime_level;
+
+#define log_enabled(level) \
+    ((level) <= LOG_COMPILE_LEVEL && (level) <= log_runtime_level)
+
+#define log_at(level, ...) \
+    do { \
+        if (log_enabled(level)) { \
+            log_message((level), __VA_ARGS__); \
+        } \
+    } while (0)
+
+#define log_error(...) log_at(APP_LOG_ERROR, __VA_ARGS__)
+#define log_warn(...)  log_at(APP_LOG_WARN, __VA_ARGS__)
+#define log_info(...)  log_at(APP_LOG_INFO, __VA_ARGS__)
+#define log_debug(...) log_at(APP_LOG_DEBUG, __VA_ARGS__)
 
 const char *log_level_name(log_level_t level);
 int parse_log_level(const char *value, log_level_t *level_out);
@@ -8,13 +8,24 @@
 
 #define MDNS_PORT 5353
 #define MDNS_MAX_PACKET 1500
+#define MDNS_MAX_QUESTIONS 16
 
 #define DNS_TYPE_A 1
 #define DNS_TYPE_PTR 12
 #define DNS_TYPE_TXT 16
 #define DNS_TYPE_AAAA 28
 #define DNS_TYPE_SRV 33
+#define DNS_TYPE_NSEC 47
+#define DNS_TYPE_ANY 255
 #define DNS_CLASS_IN 1
+#define DNS_CLASS_CACHE_FLUSH 0x8000       // top class bit in resource records
+#define DNS_CLASS_UNICAST_RESPONSE 0x8000  // top class bit in questions (QU)
+
+// RFC 6762 section 6.7: legacy unicast answers carry TTLs of at most 10 s
+#define MDNS_LEGACY_UNICAST_TTL 10
+
+// Mnemonic of a type above ("AAAA"), or NULL for any other type
+const char *mdns_type_name(uint16_t type);
 
 typedef struct {
     char name[256];
@@ -22,9 +33,59 @@ typedef struct {
     uint16_t qclass;
 } dns_question_t;
 
+// Parse up to max_questions entries of the question section.
+// Returns the number parsed (0 if QDCOUNT is 0), or -1 on malformed input.
+int mdns_parse_questions(const uint8_t *packet, size_t packet_len,
+                         dns_question_t *questions, size_t max_questions);
+
+// Parse the first question only
 int mdns_parse_query(const uint8_t *packet, size_t packet_len, dns_question_t *question);
+
+// Build a query carrying all questions in one packet (names are compressed)
+int mdns_build_query(uint8_t *out, size_t out_len, uint16_t id,
+                     const dns_question_t *questions, size_t question_count);
+
+// Responses are built without a question section (RFC 6762 section 6).
+
+// Build A/AAAA response (both for ANY); when the host lacks the requested address family an
+// NSEC record listing the types it does have is returned instead
 int mdns_build_response(uint8_t *out, size_t out_len, const dns_question_t *question, const host_record_t *record);
 
+// Build negative response (RFC 6762 section 6.1): a single NSEC record for the
+// question name whose type bitmap lists the types that do exist (all < 256)
+int mdns_build_nsec_response(uint8_t *out, size_t out_len, const dns_question_t *question,
+                             const uint16_t *types, size_t type_count, uint32_t ttl);
+
+// Start an empty response, header only; returns its length or -1
+int mdns_begin_response(uint8_t *out, size_t out_len);
+
+// Append the answer records of another response built here: records_len
+// bytes that followed its header, with record_count records. Their
+// compression pointers are re-targeted to the new position. Returns the
+// new packet length, or -1 if they do not fit in packet_cap.
+int mdns_append_answers(uint8_t *packet, size_t packet_len, size_t packet_cap,
+                        const uint8_t *records, size_t records_len, uint16_t record_count);
+
+// Return nonzero to keep a record
+typedef int (*mdns_record_filter_fn)(void *user, const char *name, uint16_t type);
+
+// Copy the answer records of a built response that keep() accepts into a new
+// response in out, re-encoding (and compressing) their names. Returns the
+// new length, or -1.
+int mdns_filter_answers(const uint8_t *packet, size_t packet_len, uint8_t *out, size_t out_len,
+                        mdns_record_filter_fn keep, void *user);
+
+// Read the 16-bit ID of a received message (0 if too short)
+uint16_t mdns_packet_id(const uint8_t *packet, size_t packet_len);
+
+// Rewrite a built response in place for a legacy unicast querier (RFC 6762
+// section 6.7): echo the query ID and questions, clamp every TTL to max_ttl
+// and clear the cache-flush bits. Built responses have no question section;
+// the records move up to make room. Returns the new length (at most
+// packet_cap), or -1.
+int mdns_prepare_legacy_unicast(uint8_t *packet, size_t packet_len, size_t packet_cap, uint16_t id,
+                                const dns_question_t *questions, size_t question_count, uint32_t max_ttl);
+
 // Build service response (SRV + TXT records)
 int mdns_build_service_response(uint8_t *out, size_t out_len, const dns_question_t *question,
                                  mdns_service_t **services, size_t service_count);
@@ -0,0 +1,198 @@
+#ifndef WIRE_H
+#define WIRE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// DNS wire-format codec shared by the server, client and browser: big-endian
+// integers, name encoding (with compression) and decoding, and
+// bounds-checked cursors for reading and writing messages.
+
+#define WIRE_HEADER_LEN 12
+#define WIRE_NAME_MAX 255          // longest uncompressed wire name
+#define WIRE_NAME_TEXT_MAX 256     // its dotted text plus the terminator
+#define WIRE_MAX_JUMPS 127         // compression pointers followed per name
+
+static inline uint16_t wire_read_u16(const uint8_t *ptr) {
+    return (uint16_t)((ptr[0] << 8) | ptr[1]);
+}
+
+static inline uint32_t wire_read_u32(const uint8_t *ptr) {
+    return ((uint32_t)ptr[0] << 24) | ((uint32_t)ptr[1] << 16) | ((uint32_t)ptr[2] << 8) | (uint32_t)ptr[3];
+}
+
+static inline void wire_write_u16(uint8_t *ptr, uint16_t value) {
+    ptr[0] = (uint8_t)(value >> 8);
+    ptr[1] = (uint8_t)(value & 0xFF);
+}
+
+static inline void wire_write_u32(uint8_t *ptr, uint32_t value) {
+    ptr[0] = (uint8_t)(value >> 24);
+    ptr[1] = (uint8_t)((value >> 16) & 0xFF);
+    ptr[2] = (uint8_t)((value >> 8) & 0xFF);
+    ptr[3] = (uint8_t)(value & 0xFF);
+}
+
+// Encode a dotted name as uncompressed labels; *written_out gets the wire length
+int wire_encode_name(const char *name, uint8_t *out, size_t out_len, size_t *written_out);
+
+// Offset just past the name at offset; pointers are not followed
+int wire_skip_name(const uint8_t *packet, size_t packet_len, size_t offset, size_t *next_offset);
+
+// Expand the possibly compressed name at offset into uncompressed labels
+// (at most WIRE_NAME_MAX bytes). Pointers must point backwards.
+// next_offset, if not NULL, gets the offset just past the name in place.
+int wire_expand_name(const uint8_t *packet, size_t packet_len, size_t offset,
+                     uint8_t *out, size_t *written_out, size_t *next_offset);
+
+// Dotted text of an uncompressed name ("." for the root)
+int wire_name_to_text(const uint8_t *wire, size_t wire_len, char *out, size_t out_len);
+
+// Dotted text of the possibly compressed name at offset ("." for the
+// root). Returns the text length, or -1.
+int wire_decode_name(const uint8_t *packet, size_t packet_len, size_t offset,
+                     char *out, size_t out_len, size_t *next_offset);
+
+// Add delta to the compression pointer ending the name at offset, if it has
+// one, after the name's target moved delta bytes further into the packet.
+// 0, or -1 if the name runs past packet_len or the pointer overflows.
+int wire_shift_name_pointer(uint8_t *packet, size_t packet_len, size_t offset, size_t delta);
+
+// Case-insensitive comparison of two uncompressed names
+int wire_names_equal(const uint8_t *a, size_t a_len, const uint8_t *b, size_t b_len);
+
+// Reading cursor over a received message
+typedef struct {
+    const uint8_t *data;
+    size_t len;
+    size_t pos;
+} wire_reader_t;
+
+typedef struct {
+    uint16_t id;
+    uint16_t flags;
+    uint16_t qdcount;
+    uint16_t ancount;
+    uint16_t nscount;
+    uint16_t arcount;
+} wire_header_t;
+
+// One resource record; the owner name and rdata stay in the packet
+typedef struct {
+    size_t name_offset;
+    uint16_t type;
+    uint16_t rrclass;      // including the cache-flush bit
+    uint32_t ttl;
+    uint16_t rdlen;
+    size_t rdata_offset;
+} wire_rr_t;
+
+static inline void wire_reader_init(wire_reader_t *reader, const uint8_t *data, size_t len) {
+    reader->data = data;
+    reader->len = len;
+    reader->pos = 0;
+}
+
+// Each read checks bounds and leaves pos unchanged on failure
+int wire_read_header(wire_reader_t *reader, wire_header_t *header);
+int wire_read_question(wire_reader_t *reader, size_t *name_offset, uint16_t *qtype, uint16_t *qclass);
+int wire_read_rr(wire_reader_t *reader, wire_rr_t *rr);
+
+// Writing cursor. Once a put does not fit, the writer is failed and every
+// later put is a no-op returning -1, so builders may check once at the end.
+// With compression on, names are written as pointers to the longest suffix
+// already in the message.
+#define WIRE_COMPRESS_MAX 64
+
+typedef struct {
+    uint8_t *data;
+    size_t cap;
+    size_t len;
+    int failed;
+    int compress;
+    size_t name_count;
+    uint16_t names[WIRE_COMPRESS_MAX];   // offsets of labels written in full
+} wire_writer_t;
+
+// Saved writer position for wire_writer_rewind()
+typedef struct {
+    size_t len;
+    size_t name_count;
+} wire_mark_t;
+
+void wire_writer_init(wire_writer_t *writer, uint8_t *data, size_t cap, int compress);
+
+static inline wire_mark_t wire_writer_mark(const wire_writer_t *writer) {
+    wire_mark_t mark;
+    mark.len = writer->len;
+    mark.name_count = writer->name_count;
+    return mark;
+}
+
+// Drop everything written since the mark and clear a failure
+static inline void wire_writer_rewind(wire_writer_t *writer, wire_mark_t mark) {
+    writer->len = mark.len;
+    writer->name_count = mark.name_count;
+    writer->failed = 0;
+}
+
+// Claim len bytes to fill in directly; NULL (and the writer failed) if they do not fit
+uint8_t *wire_put_space(wire_writer_t *writer, size_t len);
+
+int wire_put_u8(wire_writer_t *writer, uint8_t value);
+int wire_put_u16(wire_writer_t *writer, uint16_t value);
+int wire_put_u32(wire_writer_t *writer, uint32_t value);
+int wire_put_bytes(wire_writer_t *writer, const void *data, size_t len);
+int wire_put_name(wire_writer_t *writer, const char *name);
+
+// Header with all counts zero; set them with wire_patch_u16() (offsets 4-10)
+int wire_put_header(wire_writer_t *writer, uint16_t id, uint16_t flags);
+int wire_put_question(wire_writer_t *writer, const char *name, uint16_t qtype, uint16_t qclass);
+
+// Owner name, type, class and TTL; *rdlen_pos gets where RDLENGTH goes.
+// Write the rdata next, then call wire_end_rr() with the same position.
+int wire_begin_rr(wire_writer_t *writer, const char *name, uint16_t type, uint16_t rrclass,
+                  uint32_t ttl, size_t *rdlen_pos);
+int wire_end_rr(wire_writer_t *writer, size_t rdlen_pos);
+
+static inline void wire_patch_u16(wire_writer_t *writer, size_t pos, uint16_t value) {
+    if (pos + 2 <= writer->len) {
+        wire_write_u16(&writer->data[pos], value);
+    }
+}
+
+// Length written, or -1 if anything did not fit
+static inline int wire_writer_finish(const wire_writer_t *writer) {
+    return writer->failed ? -1 : (int)writer->len;
+}
+
+// Per-packet name decoder. Every label offset reached while expanding a
+// name is memoized with the uncompressed suffix that starts there, so a
+// compression pointer to a name seen before costs one copy instead of
+// another walk. Entries carry the packet generation, so nothing has to be
+// cleared between packets. Too big for the stack; keep one per thread.
+#define WIRE_DECODER_MAX_PACKET 1500
+#define WIRE_DECODER_ARENA 8192
+
+typedef struct {
+    uint32_t generation;
+    uint16_t arena_pos;
+    uint16_t len;
+} wire_name_memo_t;
+
+typedef struct {
+    const uint8_t *packet;
+    size_t packet_len;
+    uint32_t generation;
+    size_t arena_used;
+    wire_name_memo_t memo[WIRE_DECODER_MAX_PACKET];
+    uint8_t arena[WIRE_DECODER_ARENA];
+} wire_name_decoder_t;
+
+// Start decoding a new packet (at most WIRE_DECODER_MAX_PACKET bytes)
+int wire_name_decoder_reset(wire_name_decoder_t *decoder, const uint8_t *packet, size_t packet_len);
+
+// wire_expand_name() for the packet being decoded, through the memo table
+int wire_name_decoder_expand(wire_name_decoder_t *decoder, size_t offset, uint8_t *out, size_t *written_out);
+
+#endif
@@ -1,6 +1,7 @@
 #include "hostdb.h"
 
 #include <arpa/inet.h>
+#include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -11,6 +12,17 @@
 static mdns_service_t **services = NULL;
 static size_t service_count = 0;
 static size_t service_capacity = 0;
+static uint32_t services_generation = 0;
+
+// Open-addressing index over services by lowercase instance FQDN, kept at
+// most half full so lookups stay O(1) as the service count grows
+typedef struct {
+    uint32_t hash;
+    mdns_service_t *svc;   // NULL = empty
+} fqdn_slot_t;
+
+static fqdn_slot_t *fqdn_index = NULL;
+static size_t fqdn_index_capacity = 0;
 
 static int normalize_local_name(const char *name, char *out, size_t out_len) {
     size_t name_len;
@@ -84,6 +96,16 @@ int hostdb_lookup(const host_record_t *record, const char *qname, host_record_t
         return 1;
     }
 
+    // A bare hostname also owns "<hostname>.local"
+    if (strchr(record->hostname, '.') == NULL) {
+        size_t host_len = strlen(record->hostname);
+        if (strncasecmp(normalized, record->hostname, host_len) == 0 &&
+            strcasecmp(&normalized[host_len], ".local") == 0) {
+            *out = *record;
+            return 1;
+        }
+    }
+
     return 0;
 }
 
@@ -97,18 +119,99 @@ static int construct_service_fqdn(const mdns_service_t *svc, char *fqdn, size_t
     return 0;
 }
 
+// Helper: Case-insensitive FNV-1a hash of a name
+static uint32_t fqdn_hash(const char *name) {
+    uint32_t hash = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *)name; *p != '\0'; p++) {
+        hash ^= (uint32_t)tolower(*p);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Helper: Slot holding the service named normalized, or the empty slot
+// where it would go
+static size_t fqdn_index_probe(const char *normalized, uint32_t hash) {
+    size_t mask = fqdn_index_capacity - 1;
+    size_t slot = hash & mask;
+
+    while (fqdn_index[slot].svc != NULL) {
+        char service_fqdn[512];
+        if (fqdn_index[slot].hash == hash &&
+            construct_service_fqdn(fqdn_index[slot].svc, service_fqdn, sizeof(service_fqdn)) == 0 &&
+            strcasecmp(normalized, service_fqdn) == 0) {
+            break;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+// Helper: Insert into the index, doubling it first if it would pass half full
+static int fqdn_index_insert(mdns_service_t *svc, uint32_t hash) {
+    size_t mask;
+    size_t slot;
+
+    if ((service_count + 1) * 2 > fqdn_index_capacity) {
+        size_t new_capacity = fqdn_index_capacity == 0 ? 16 : fqdn_index_capacity * 2;
+        fqdn_slot_t *new_index = calloc(new_capacity, sizeof(fqdn_slot_t));
+        if (new_index == NULL) {
+            return -1;
+        }
+        for (size_t i = 0; i < fqdn_index_capacity; i++) {
+            if (fqdn_index[i].svc != NULL) {
+                size_t to = fqdn_index[i].hash & (new_capacity - 1);
+                while (new_index[to].svc != NULL) {
+                    to = (to + 1) & (new_capacity - 1);
+                }
+                new_index[to] = fqdn_index[i];
+            }
+        }
+        free(fqdn_index);
+        fqdn_index = new_index;
+        fqdn_index_capacity = new_capacity;
+    }
+
+    mask = fqdn_index_capacity - 1;
+    slot = hash & mask;
+    while (fqdn_index[slot].svc != NULL) {
+        slot = (slot + 1) & mask;
+    }
+    fqdn_index[slot].hash = hash;
+    fqdn_index[slot].svc = svc;
+    return 0;
+}
+
+// Helper: Remove a slot, shifting later members of its probe run back
+static void fqdn_index_remove(size_t slot) {
+    size_t mask = fqdn_index_capacity - 1;
+    size_t next = (slot + 1) & mask;
+
+    while (fqdn_index[next].svc != NULL) {
+        size_t home = fqdn_index[next].hash & mask;
+        // Move next into the hole unless its home lies cyclically in (slot, next]
+        if (((next - home) & mask) >= ((next - slot) & mask)) {
+            fqdn_index[slot] = fqdn_index[next];
+            slot = next;
+        }
+        next = (next + 1) & mask;
+    }
+    fqdn_index[slot].svc = NULL;
+}
+
 // Helper: Find service by exact FQDN match
 mdns_service_t *mdns_find_service_by_fqdn(const char *fqdn) {
-    char service_fqdn[512];
+    char normalized[512];
     
-    for (size_t i = 0; i < service_count; i++) {
-        if (construct_service_fqdn(services[i], service_fqdn, sizeof(service_fqdn)) == 0) {
-            if (strcasecmp(fqdn, service_fqdn) == 0) {
-                return services[i];
-            }
-        }
+    // Question names arrive with a trailing dot
+    if (normalize_local_name(fqdn, normalized, sizeof(normalized)) != 0) {
+        return NULL;
     }
-    return NULL;
+    
+    if (fqdn_index_capacity == 0) {
+        return NULL;
+    }
+    return fqdn_index[fqdn_index_probe(normalized, fqdn_hash(normalized))].svc;
 }
 
 // Helper: Find all services matching service_type.domain
@@ -179,10 +282,11 @@ int mdns_register_service(const mdns_service_t *svc) {
     }
     
     // Check for duplicate
-    if (construct_service_fqdn(svc, fqdn, sizeof(fqdn)) == 0) {
-        if (mdns_find_service_by_fqdn(fqdn) != NULL) {
-            return -1;  // Conflict error
-        }
+    if (construct_service_fqdn(svc, fqdn, sizeof(fqdn)) != 0) {
+        return -1;
+    }
+    if (mdns_find_service_by_fqdn(fqdn) != NULL) {
+        return -1;  // Conflict error
     }
     
     // Allocate new service
@@ -240,8 +344,14 @@ int mdns_register_service(const mdns_service_t *svc) {
         service_capacity = new_capacity;
     }
     
+    if (fqdn_index_insert(new_service, fqdn_hash(fqdn)) != 0) {
+        free_service(new_service);
+        return -1;
+    }
+    
     // Add to list
     services[service_count++] = new_service;
+    services_generation++;
     return 0;
 }
 
@@ -262,6 +372,9 @@ int mdns_update_service(const mdns_service_t *svc) {
         return -1;  // Not found
     }
     
+    // Fields change from here on, even if a later allocation fails
+    services_generation++;
+    
     // Update fields
     existing->priority = svc->priority;
     existing->weight = svc->weight;
@@ -306,28 +419,35 @@ int mdns_update_service(const mdns_service_t *svc) {
 }
 
 int mdns_unregister_service(const char *instance_fqdn) {
-    if (instance_fqdn == NULL) {
+    char normalized[512];
+    size_t slot;
+    mdns_service_t *target;
+    
+    if (instance_fqdn == NULL || fqdn_index_capacity == 0 ||
+        normalize_local_name(instance_fqdn, normalized, sizeof(normalized)) != 0) {
         return -1;
     }
     
+    slot = fqdn_index_probe(normalized, fqdn_hash(normalized));
+    target = fqdn_index[slot].svc;
+    if (target == NULL) {
+        return -1;  // Not found
+    }
+    fqdn_index_remove(slot);
+    
     for (size_t i = 0; i < service_count; i++) {
-        char fqdn[512];
-        if (construct_service_fqdn(services[i], fqdn, sizeof(fqdn)) == 0) {
-            if (strcasecmp(fqdn, instance_fqdn) == 0) {
-                // Free service
-                free_service(services[i]);
-                
-                // Shift remaining services
-                for (size_t j = i; j < service_count - 1; j++) {
-                    services[j] = services[j + 1];
-                }
-                service_count--;
-                return 0;
+        if (services[i] == target) {
+            // Shift remaining services
+            for (size_t j = i; j < service_count - 1; j++) {
+                services[j] = services[j + 1];
             }
+            break;
         }
     }
-    
-    return -1;  // Not found
+    free_service(target);
+    service_count--;
+    services_generation++;
+    return 0;
 }
 
 size_t mdns_list_services(mdns_service_t **out, size_t max_items) {
@@ -350,4 +470,12 @@ void mdns_cleanup_services(void) {
     services = NULL;
     service_count = 0;
     service_capacity = 0;
+    free(fqdn_index);
+    fqdn_index = NULL;
+    fqdn_index_capacity = 0;
+    services_generation++;
+}
+
+uint32_t mdns_services_generation(void) {
+    return services_generation;
 }
@@ -1,15 +1,69 @@
 #include "log.h"
 
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
+#include <sys/types.h>
 #include <time.h>
 #include <syslog.h>
 
-static log_level_t g_level = APP_LOG_WARN;
+log_level_t log_runtime_level = APP_LOG_WARN;
 static int g_use_syslog = 0;
 
+// Async ring: power-of-two slots, each holding one captured call
+#define LOG_ASYNC_SLOTS 1024
+#define LOG_ASYNC_MAX_ARGS 8
+#define LOG_ASYNC_STRINGS 192
+#define LOG_ASYNC_IDLE_NS 2000000L
+// Longest flags/width/precision text replayed; each '*' in it becomes up to
+// 11 characters, so a rebuilt spec needs 1 + LOG_SPEC_TEXT_MAX + 2 * 10 + 4 bytes
+#define LOG_SPEC_TEXT_MAX 16
+#define LOG_SPEC_MAX 48
+
+typedef enum {
+    ARG_SIGNED,
+    ARG_UNSIGNED,
+    ARG_CHAR,
+    ARG_DOUBLE,
+    ARG_STRING,
+    ARG_POINTER
+} log_arg_kind_t;
+
+typedef struct {
+    uint8_t kind;
+    union {
+        long long i;
+        unsigned long long u;
+        double d;
+        const void *p;
+        uint16_t str_off;
+    } v;
+} log_arg_t;
+
+typedef struct {
+    log_level_t level;
+    time_t timestamp;
+    const char *fmt;        // NULL: strings holds the preformatted message
+    uint8_t arg_count;
+    uint16_t strings_len;
+    log_arg_t args[LOG_ASYNC_MAX_ARGS];
+    char strings[LOG_ASYNC_STRINGS];
+} log_record_t;
+
+static void log_stop_async(void);
+
+static log_record_t g_ring[LOG_ASYNC_SLOTS];
+static unsigned g_ring_head = 0;   // consumer position
+static unsigned g_ring_tail = 0;   // producer position
+static unsigned long g_ring_dropped = 0;
+static int g_async = 0;
+static int g_async_stop = 0;
+static pthread_t g_async_thread;
+
 const char *log_level_name(log_level_t level) {
     switch (level) {
         case APP_LOG_ERROR: return "ERROR";
@@ -56,32 +110,399 @@ int parse_log_level(const char *value, log_level_t *level_out) {
 }
 
 int log_init(log_level_t level, int use_syslog) {
-    g_level = level;
+    log_runtime_level = level;
     g_use_syslog = use_syslog;
 
     if (g_use_syslog) {
         openlog("mdns_server", LOG_PID | LOG_NDELAY, LOG_DAEMON);
     }
 
+    if (level > LOG_COMPILE_LEVEL) {
+        log_message(APP_LOG_WARN, "%s logging is compiled out (LOG_MIN_LEVEL=%s)",
+                    log_level_name(level), log_level_name(LOG_COMPILE_LEVEL));
+    }
+
     return 0;
 }
 
 void log_close(void) {
+    log_stop_async();
+
     if (g_use_syslog) {
         closelog();
     }
 }
 
+// Write one finished line to the configured target. ts_text is the console
+// timestamp, already formatted by the caller.
+static void write_line(log_level_t level, const char *ts_text, const char *message) {
+    if (g_use_syslog) {
+        syslog(to_syslog_level(level), "%s", message);
+    } else {
+        fprintf(stderr, "%s [%s] %s\n", ts_text, log_level_name(level), message);
+    }
+}
+
+// Copy a string argument into the record, truncating when space runs out
+static uint16_t capture_string(log_record_t *rec, const char *str) {
+    uint16_t off = rec->strings_len;
+    size_t room = sizeof(rec->strings) - off;
+    size_t len;
+
+    if (room == 0) {
+        return (uint16_t)(sizeof(rec->strings) - 1);  // points at the final NUL
+    }
+    if (str == NULL) {
+        str = "(null)";
+    }
+    len = strlen(str);
+    if (len >= room) {
+        len = room - 1;
+    }
+    memcpy(&rec->strings[off], str, len);
+    rec->strings[off + len] = '\0';
+    rec->strings_len = (uint16_t)(off + len + 1);
+    return off;
+}
+
+// Walk the format and pull each argument with the type its conversion implies.
+// Returns -1 for anything the writer cannot replay (%n, long double, too many
+// args, flags/width/precision longer than LOG_SPEC_TEXT_MAX).
+static int capture_args(log_record_t *rec, const char *fmt, va_list args) {
+    const char *p = fmt;
+    const char *spec_start;
+
+    rec->arg_count = 0;
+    rec->strings_len = 0;
+    rec->strings[sizeof(rec->strings) - 1] = '\0';
+
+    while ((p = strchr(p, '%')) != NULL) {
+        char length[3] = {0, 0, 0};
+        log_arg_t *arg;
+
+        p++;
+        if (*p == '%') {
+            p++;
+            continue;
+        }
+        spec_start = p;
+        while (*p != '\0' && strchr("-+ #0", *p) != NULL) {
+            p++;
+        }
+        for (int part = 0; part < 2; part++) {
+            if (part == 1) {
+                if (*p != '.') {
+                    break;
+                }
+                p++;
+            }
+            if (*p == '*') {
+                if (rec->arg_count == LOG_ASYNC_MAX_ARGS) {
+                    return -1;
+                }
+                arg = &rec->args[rec->arg_count++];
+                arg->kind = ARG_SIGNED;
+                arg->v.i = va_arg(args, int);
+                p++;
+            } else {
+                while (*p >= '0' && *p <= '9') {
+                    p++;
+                }
+            }
+        }
+        if ((size_t)(p - spec_start) > LOG_SPEC_TEXT_MAX) {
+            return -1;
+        }
+        if (*p == 'h' || *p == 'l') {
+            length[0] = *p++;
+            if (*p == length[0]) {
+                length[1] = *p++;
+            }
+        } else if (*p == 'z' || *p == 'j' || *p == 't') {
+            length[0] = *p++;
+        } else if (*p == 'L') {
+            return -1;
+        }
+
+        if (*p == '\0' || rec->arg_count == LOG_ASYNC_MAX_ARGS) {
+            return -1;
+        }
+        arg = &rec->args[rec->arg_count++];
+
+        switch (*p) {
+            case 'd':
+            case 'i':
+                arg->kind = ARG_SIGNED;
+                if (length[0] == 'l' && length[1] == 'l') {
+                    arg->v.i = va_arg(args, long long);
+                } else if (length[0] == 'l') {
+                    arg->v.i = va_arg(args, long);
+                } else if (length[0] == 'z') {
+                    arg->v.i = va_arg(args, ssize_t);
+                } else if (length[0] == 'j') {
+                    arg->v.i = va_arg(args, intmax_t);
+                } else if (length[0] == 't') {
+                    arg->v.i = va_arg(args, ptrdiff_t);
+                } else if (length[0] == 'h' && length[1] == 'h') {
+                    arg->v.i = (signed char)va_arg(args, int);
+                } else if (length[0] == 'h') {
+                    arg->v.i = (short)va_arg(args, int);
+                } else {
+                    arg->v.i = va_arg(args, int);
+                }
+                break;
+            case 'u':
+            case 'o':
+            case 'x':
+            case 'X':
+                arg->kind = ARG_UNSIGNED;
+                if (length[0] == 'l' && length[1] == 'l') {
+                    arg->v.u = va_arg(args, unsigned long long);
+                } else if (length[0] == 'l') {
+                    arg->v.u = va_arg(args, unsigned long);
+                } else if (length[0] == 'z') {
+                    arg->v.u = va_arg(args, size_t);
+                } else if (length[0] == 'j') {
+                    arg->v.u = va_arg(args, uintmax_t);
+                } else if (length[0] == 't') {
+                    arg->v.u = (unsigned long long)va_arg(args, ptrdiff_t);
+                } else if (length[0] == 'h' && length[1] == 'h') {
+                    arg->v.u = (unsigned char)va_arg(args, unsigned int);
+                } else if (length[0] == 'h') {
+                    arg->v.u = (unsigned short)va_arg(args, unsigned int);
+                } else {
+                    arg->v.u = va_arg(args, unsigned int);
+                }
+                break;
+            case 'c':
+                arg->kind = ARG_CHAR;
+                arg->v.i = va_arg(args, int);
+                break;
+            case 'e':
+            case 'E':
+            case 'f':
+            case 'F':
+            case 'g':
+            case 'G':
+            case 'a':
+            case 'A':
+                arg->kind = ARG_DOUBLE;
+                arg->v.d = va_arg(args, double);
+                break;
+            case 's':
+                arg->kind = ARG_STRING;
+                arg->v.str_off = capture_string(rec, va_arg(args, const char *));
+                break;
+            case 'p':
+                arg->kind = ARG_POINTER;
+                arg->v.p = va_arg(args, void *);
+                break;
+            default:
+                return -1;
+        }
+        p++;
+    }
+
+    return 0;
+}
+
+// Replay a captured record through snprintf one conversion at a time
+static void render_record(const log_record_t *rec, char *out, size_t out_len) {
+    const char *p = rec->fmt;
+    size_t used = 0;
+    uint8_t next_arg = 0;
+
+    out[0] = '\0';
+    while (*p != '\0' && used + 1 < out_len) {
+        char spec[LOG_SPEC_MAX];
+        size_t spec_len = 0;
+        const log_arg_t *arg;
+        int written;
+
+        if (*p != '%') {
+            out[used++] = *p++;
+            out[used] = '\0';
+            continue;
+        }
+        if (p[1] == '%') {
+            out[used++] = '%';
+            out[used] = '\0';
+            p += 2;
+            continue;
+        }
+
+        // Rebuild the spec: '*' replaced by its captured value, length
+        // modifiers replaced by "ll" for integers. capture_args() bounded the
+        // text, so it always fits; stop rendering rather than overflow if not.
+        spec[spec_len++] = *p++;
+        while (*p != '\0' && strchr("-+ #0123456789.*", *p) != NULL) {
+            if (spec_len + 11 + 4 > sizeof(spec)) {
+                return;
+            }
+            if (*p == '*') {
+                spec_len += (size_t)snprintf(&spec[spec_len], sizeof(spec) - spec_len, "%d",
+                                             (int)rec->args[next_arg++].v.i);
+            } else {
+                spec[spec_len++] = *p;
+            }
+            p++;
+        }
+        while (*p == 'h' || *p == 'l' || *p == 'z' || *p == 'j' || *p == 't') {
+            p++;
+        }
+
+        arg = &rec->args[next_arg++];
+        if (arg->kind == ARG_SIGNED || arg->kind == ARG_UNSIGNED) {
+            spec[spec_len++] = 'l';
+            spec[spec_len++] = 'l';
+        }
+        spec[spec_len++] = *p++;
+        spec[spec_len] = '\0';
+
+        switch (arg->kind) {
+            case ARG_SIGNED:
+                written = snprintf(&out[used], out_len - used, spec, arg->v.i);
+                break;
+            case ARG_UNSIGNED:
+                written = snprintf(&out[used], out_len - used, spec, arg->v.u);
+                break;
+            case ARG_CHAR:
+                written = snprintf(&out[used], out_len - used, spec, (int)arg->v.i);
+                break;
+            case ARG_DOUBLE:
+                written = snprintf(&out[used], out_len - used, spec, arg->v.d);
+                break;
+            case ARG_STRING:
+                written = snprintf(&out[used], out_len - used, spec, &rec->strings[arg->v.str_off]);
+                break;
+            default:
+                written = snprintf(&out[used], out_len - used, spec, arg->v.p);
+                break;
+        }
+        if (written < 0) {
+            break;
+        }
+        used += (size_t)written;
+        if (used >= out_len) {
+            used = out_len - 1;
+        }
+    }
+}
+
+static void *async_writer(void *unused) {
+    struct timespec idle = {0, LOG_ASYNC_IDLE_NS};
+    time_t cached_second = (time_t)-1;
+    char ts[32] = "";
+    unsigned long reported_drops = 0;
+
+    (void)unused;
+
+    for (;;) {
+        unsigned head = g_ring_head;
+        unsigned tail = __atomic_load_n(&g_ring_tail, __ATOMIC_ACQUIRE);
+        unsigned long drops = __atomic_load_n(&g_ring_dropped, __ATOMIC_RELAXED);
+
+        if (drops != reported_drops) {
+            char msg[64];
+            snprintf(msg, sizeof(msg), "%lu log message(s) dropped (ring full)", drops - reported_drops);
+            write_line(APP_LOG_WARN, ts, msg);
+            reported_drops = drops;
+        }
+
+        if (head == tail) {
+            if (__atomic_load_n(&g_async_stop, __ATOMIC_ACQUIRE)) {
+                break;
+            }
+            nanosleep(&idle, NULL);
+            continue;
+        }
+
+        while (head != tail) {
+            const log_record_t *rec = &g_ring[head & (LOG_ASYNC_SLOTS - 1)];
+            char message[1024];
+
+            // Timestamp text only changes once a second
+            if (!g_use_syslog && rec->timestamp != cached_second) {
+                struct tm tm_now;
+                cached_second = rec->timestamp;
+                localtime_r(&cached_second, &tm_now);
+                strftime(ts, sizeof(ts), "%Y-%m-%d %H:%M:%S", &tm_now);
+            }
+
+            if (rec->fmt == NULL) {
+                write_line(rec->level, ts, rec->strings);
+            } else {
+                render_record(rec, message, sizeof(message));
+                write_line(rec->level, ts, message);
+            }
+            head++;
+        }
+        __atomic_store_n(&g_ring_head, head, __ATOMIC_RELEASE);
+    }
+
+    return NULL;
+}
+
+int log_start_async(void) {
+    if (g_async) {
+        return 0;
+    }
+
+    g_async_stop = 0;
+    if (pthread_create(&g_async_thread, NULL, async_writer, NULL) != 0) {
+        return -1;
+    }
+    g_async = 1;
+    return 0;
+}
+
+static void log_stop_async(void) {
+    if (!g_async) {
+        return;
+    }
+    __atomic_store_n(&g_async_stop, 1, __ATOMIC_RELEASE);
+    pthread_join(g_async_thread, NULL);
+    g_async = 0;
+}
+
+static void enqueue_record(log_level_t level, const char *fmt, va_list args) {
+    unsigned tail = g_ring_tail;
+    log_record_t *rec;
+    va_list copy;
+
+    if (tail - __atomic_load_n(&g_ring_head, __ATOMIC_ACQUIRE) >= LOG_ASYNC_SLOTS) {
+        __atomic_fetch_add(&g_ring_dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    rec = &g_ring[tail & (LOG_ASYNC_SLOTS - 1)];
+    rec->level = level;
+    rec->timestamp = time(NULL);
+    rec->fmt = fmt;
+
+    va_copy(copy, args);
+    if (capture_args(rec, fmt, copy) != 0) {
+        // Not replayable: pay for formatting here instead
+        rec->fmt = NULL;
+        vsnprintf(rec->strings, sizeof(rec->strings), fmt, args);
+    }
+    va_end(copy);
+
+    __atomic_store_n(&g_ring_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
 void log_message(log_level_t level, const char *fmt, ...) {
     va_list args;
 
-    if (level > g_level) {
+    if (level > log_runtime_level) {
         return;
     }
 
     va_start(args, fmt);
 
-    if (g_use_syslog) {
+    if (g_async) {
+        enqueue_record(level, fmt, args);
+    } else if (g_use_syslog) {
         char buffer[1024];
         vsnprintf(buffer, sizeof(buffer), fmt, args);
         syslog(to_syslog_level(level), "%s", buffer);
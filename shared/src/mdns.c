@@ -4,357 +4,472 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "wire.h"
+
 #define DNS_FLAG_QR_RESPONSE 0x8000
 #define DNS_FLAG_AA 0x0400
 
-static uint16_t read_u16(const uint8_t *ptr) {
-    return (uint16_t)((ptr[0] << 8) | ptr[1]);
-}
-
-static void write_u16(uint8_t *ptr, uint16_t value) {
-    ptr[0] = (uint8_t)((value >> 8) & 0xFF);
-    ptr[1] = (uint8_t)(value & 0xFF);
-}
-
-static void write_u32(uint8_t *ptr, uint32_t value) {
-    ptr[0] = (uint8_t)((value >> 24) & 0xFF);
-    ptr[1] = (uint8_t)((value >> 16) & 0xFF);
-    ptr[2] = (uint8_t)((value >> 8) & 0xFF);
-    ptr[3] = (uint8_t)(value & 0xFF);
+const char *mdns_type_name(uint16_t type) {
+    switch (type) {
+        case DNS_TYPE_A: return "A";
+        case DNS_TYPE_PTR: return "PTR";
+        case DNS_TYPE_TXT: return "TXT";
+        case DNS_TYPE_AAAA: return "AAAA";
+        case DNS_TYPE_SRV: return "SRV";
+        case DNS_TYPE_NSEC: return "NSEC";
+        case DNS_TYPE_ANY: return "ANY";
+        default: return NULL;
+    }
 }
 
-static int parse_qname(const uint8_t *packet, size_t packet_len, size_t *offset, char *out, size_t out_len) {
-    size_t pos = *offset;
-    size_t written = 0;
+int mdns_parse_questions(const uint8_t *packet, size_t packet_len,
+                         dns_question_t *questions, size_t max_questions) {
+    uint16_t qdcount;
+    size_t offset = WIRE_HEADER_LEN;
+    size_t parsed = 0;
 
-    if (pos >= packet_len) {
+    if (packet == NULL || questions == NULL || packet_len < WIRE_HEADER_LEN) {
         return -1;
     }
 
-    while (pos < packet_len) {
-        uint8_t label_len = packet[pos++];
-
-        if (label_len == 0) {
-            if (written == 0) {
-                return -1;
-            }
-            out[written] = '\0';
-            *offset = pos;
-            return 0;
-        }
-
-        if ((label_len & 0xC0) != 0) {
-            return -1;
-        }
-
-        if (pos + label_len > packet_len) {
-            return -1;
-        }
+    // Decoding the name also finds its end, so questions take one pass
+    qdcount = wire_read_u16(&packet[4]);
+    while (parsed < qdcount && parsed < max_questions) {
+        dns_question_t *question = &questions[parsed];
+        int name_len = wire_decode_name(packet, packet_len, offset, question->name, sizeof(question->name) - 1,
+                                        &offset);
 
-        if (written + label_len + 1 >= out_len) {
+        // The root name is not a question; others keep their trailing dot
+        if (name_len < 0 || (name_len == 1 && question->name[0] == '.') || offset + 4 > packet_len) {
             return -1;
         }
+        question->name[name_len] = '.';
+        question->name[name_len + 1] = '\0';
 
-        memcpy(&out[written], &packet[pos], label_len);
-        written += label_len;
-        pos += label_len;
-
-        out[written++] = '.';
+        question->qtype = wire_read_u16(&packet[offset]);
+        question->qclass = wire_read_u16(&packet[offset + 2]);
+        offset += 4;
+        parsed++;
     }
 
-    return -1;
+    return (int)parsed;
 }
 
-static int encode_qname(const char *name, uint8_t *out, size_t out_len, size_t *written_out) {
-    const char *cursor = name;
-    size_t written = 0;
-
-    while (*cursor != '\0') {
-        const char *dot = strchr(cursor, '.');
-        size_t label_len = dot ? (size_t)(dot - cursor) : strlen(cursor);
-
-        if (label_len == 0 || label_len > 63) {
-            return -1;
-        }
-        if (written + 1 + label_len >= out_len) {
-            return -1;
-        }
-
-        out[written++] = (uint8_t)label_len;
-        memcpy(&out[written], cursor, label_len);
-        written += label_len;
-
-        if (dot == NULL) {
-            break;
-        }
-        cursor = dot + 1;
-    }
-
-    if (written >= out_len) {
-        return -1;
-    }
-    out[written++] = 0;
-
-    *written_out = written;
-    return 0;
+int mdns_parse_query(const uint8_t *packet, size_t packet_len, dns_question_t *question) {
+    return mdns_parse_questions(packet, packet_len, question, 1);
 }
 
-int mdns_parse_query(const uint8_t *packet, size_t packet_len, dns_question_t *question) {
-    uint16_t qdcount;
-    size_t offset;
+int mdns_build_query(uint8_t *out, size_t out_len, uint16_t id,
+                     const dns_question_t *questions, size_t question_count) {
+    wire_writer_t writer;
 
-    if (packet == NULL || question == NULL || packet_len < 12) {
+    if (out == NULL || questions == NULL || question_count == 0 || question_count > MDNS_MAX_QUESTIONS) {
         return -1;
     }
 
-    qdcount = read_u16(&packet[4]);
-    if (qdcount == 0) {
-        return 0;
+    // Repeated names (A + AAAA for one host) and shared suffixes compress
+    wire_writer_init(&writer, out, out_len, 1);
+    wire_put_header(&writer, id, 0);
+    for (size_t i = 0; i < question_count; i++) {
+        wire_put_question(&writer, questions[i].name, questions[i].qtype, questions[i].qclass);
     }
+    wire_patch_u16(&writer, 4, (uint16_t)question_count);
 
-    offset = 12;
-    if (parse_qname(packet, packet_len, &offset, question->name, sizeof(question->name)) != 0) {
-        return -1;
-    }
+    return wire_writer_finish(&writer);
+}
 
-    if (offset + 4 > packet_len) {
-        return -1;
-    }
+// Helper: Write the DNS header of a response. RFC 6762 section 6: multicast
+// responses carry no question section; mdns_prepare_legacy_unicast() adds
+// one for legacy queriers.
+static void write_response_header(wire_writer_t *writer) {
+    wire_put_header(writer, 0, DNS_FLAG_QR_RESPONSE | DNS_FLAG_AA);
+}
 
-    question->qtype = read_u16(&packet[offset]);
-    question->qclass = read_u16(&packet[offset + 2]);
+// Helper: Append an A or AAAA answer owned by name
+static void write_address_answer(wire_writer_t *writer, const char *name, uint16_t type,
+                                 const host_record_t *record) {
+    size_t rdlength_pos;
 
-    return 1;
+    wire_begin_rr(writer, name, type, DNS_CLASS_IN, 120, &rdlength_pos);
+    if (type == DNS_TYPE_A) {
+        wire_put_bytes(writer, &record->ipv4, 4);
+    } else {
+        wire_put_bytes(writer, &record->ipv6, 16);
+    }
+    wire_end_rr(writer, rdlength_pos);
 }
 
 int mdns_build_response(uint8_t *out, size_t out_len, const dns_question_t *question, const host_record_t *record) {
-    size_t qname_len;
-    size_t offset;
+    wire_writer_t writer;
     uint16_t answers = 0;
+    int want_a;
+    int want_aaaa;
 
-    if (out == NULL || question == NULL || record == NULL || out_len < 12) {
+    if (out == NULL || question == NULL || record == NULL) {
         return -1;
     }
 
-    memset(out, 0, out_len);
-    write_u16(&out[0], 0);
-    write_u16(&out[2], DNS_FLAG_QR_RESPONSE | DNS_FLAG_AA);
-    write_u16(&out[4], 1);
+    // The AAAA owner name compresses against the A record's
+    wire_writer_init(&writer, out, out_len, 1);
+    write_response_header(&writer);
 
-    offset = 12;
-    if (encode_qname(question->name, &out[offset], out_len - offset, &qname_len) != 0) {
-        return -1;
-    }
-    offset += qname_len;
+    // ANY gets everything we own for the name in one packet
+    want_a = question->qtype == DNS_TYPE_A || question->qtype == DNS_TYPE_ANY;
+    want_aaaa = question->qtype == DNS_TYPE_AAAA || question->qtype == DNS_TYPE_ANY;
 
-    if (offset + 4 > out_len) {
-        return -1;
+    if (want_a && record->has_ipv4) {
+        write_address_answer(&writer, question->name, DNS_TYPE_A, record);
+        answers++;
+    }
+    if (want_aaaa && record->has_ipv6) {
+        write_address_answer(&writer, question->name, DNS_TYPE_AAAA, record);
+        answers++;
     }
-    write_u16(&out[offset], question->qtype);
-    write_u16(&out[offset + 2], DNS_CLASS_IN);
-    offset += 4;
 
-    if (question->qtype == DNS_TYPE_A && record->has_ipv4) {
-        if (offset + 2 + 2 + 2 + 4 + 2 + 4 > out_len) {
-            return -1;
+    if (answers == 0) {
+        uint16_t types[2];
+        size_t type_count = 0;
+
+        // Nothing at all to say about the name
+        if (question->qtype == DNS_TYPE_ANY) {
+            return 0;
         }
-        write_u16(&out[offset], 0xC00C);
-        write_u16(&out[offset + 2], DNS_TYPE_A);
-        write_u16(&out[offset + 4], DNS_CLASS_IN);
-        write_u32(&out[offset + 6], 120);
-        write_u16(&out[offset + 10], 4);
-        memcpy(&out[offset + 12], &record->ipv4, 4);
-        offset += 16;
-        answers = 1;
-    } else if (question->qtype == DNS_TYPE_AAAA && record->has_ipv6) {
-        if (offset + 2 + 2 + 2 + 4 + 2 + 16 > out_len) {
-            return -1;
+        if (record->has_ipv4) {
+            types[type_count++] = DNS_TYPE_A;
         }
-        write_u16(&out[offset], 0xC00C);
-        write_u16(&out[offset + 2], DNS_TYPE_AAAA);
-        write_u16(&out[offset + 4], DNS_CLASS_IN);
-        write_u32(&out[offset + 6], 120);
-        write_u16(&out[offset + 10], 16);
-        memcpy(&out[offset + 12], &record->ipv6, 16);
-        offset += 28;
-        answers = 1;
-    } else {
-        return 0;
+        if (record->has_ipv6) {
+            types[type_count++] = DNS_TYPE_AAAA;
+        }
+        return mdns_build_nsec_response(out, out_len, question, types, type_count, record->ttl);
     }
 
-    write_u16(&out[6], answers);
+    wire_patch_u16(&writer, 6, answers);
 
-    return (int)offset;
+    return wire_writer_finish(&writer);
 }
 
-// Helper: Write answer header (name, type, class, ttl, rdlength placeholder)
-// Returns offset to write RDATA, or -1 on error
-static int write_answer_header(uint8_t *out, size_t out_len, size_t *offset,
-                                const char *name, uint16_t type, uint32_t ttl) {
-    size_t qname_len;
-    
-    // Write name
-    if (encode_qname(name, &out[*offset], out_len - *offset, &qname_len) != 0) {
+int mdns_build_nsec_response(uint8_t *out, size_t out_len, const dns_question_t *question,
+                             const uint16_t *types, size_t type_count, uint32_t ttl) {
+    wire_writer_t writer;
+    uint8_t bitmap[32];
+    size_t bitmap_len = 0;
+    size_t rdlength_pos;
+
+    if (out == NULL || question == NULL || (type_count > 0 && types == NULL)) {
         return -1;
     }
-    *offset += qname_len;
-    
-    // Write TYPE, CLASS, TTL, RDLENGTH placeholder
-    if (*offset + 10 > out_len) {
-        return -1;
+
+    // Restricted form: window block 0 only, so every type must be below 256
+    memset(bitmap, 0, sizeof(bitmap));
+    for (size_t i = 0; i < type_count; i++) {
+        if (types[i] == 0 || types[i] > 255) {
+            return -1;
+        }
+        bitmap[types[i] / 8] |= (uint8_t)(0x80 >> (types[i] % 8));
+        if ((size_t)(types[i] / 8) + 1 > bitmap_len) {
+            bitmap_len = (size_t)(types[i] / 8) + 1;
+        }
     }
-    
-    write_u16(&out[*offset], type);
-    write_u16(&out[*offset + 2], DNS_CLASS_IN);
-    write_u32(&out[*offset + 4], ttl);
-    *offset += 8;
-    
-    // Return position for RDLENGTH
-    return (int)*offset;
-}
 
-// Helper: Encode SRV record RDATA
-static int encode_srv_rdata(uint8_t *out, size_t out_len, size_t *offset,
-                             const mdns_service_t *svc) {
-    size_t target_len;
-    
-    // Check space for priority, weight, port
-    if (*offset + 6 > out_len) {
-        return -1;
+    wire_writer_init(&writer, out, out_len, 1);
+    write_response_header(&writer);
+
+    // The next domain name is the owner name again, compressed to a pointer;
+    // an empty window is omitted entirely when no types exist
+    wire_begin_rr(&writer, question->name, DNS_TYPE_NSEC, DNS_CLASS_CACHE_FLUSH | DNS_CLASS_IN, ttl,
+                  &rdlength_pos);
+    wire_put_name(&writer, question->name);
+    if (bitmap_len > 0) {
+        wire_put_u8(&writer, 0);
+        wire_put_u8(&writer, (uint8_t)bitmap_len);
+        wire_put_bytes(&writer, bitmap, bitmap_len);
     }
-    
-    write_u16(&out[*offset], svc->priority);
-    write_u16(&out[*offset + 2], svc->weight);
-    write_u16(&out[*offset + 4], svc->port);
-    *offset += 6;
-    
-    // Encode target hostname
-    if (encode_qname(svc->target_host, &out[*offset], out_len - *offset, &target_len) != 0) {
-        return -1;
+    wire_end_rr(&writer, rdlength_pos);
+
+    wire_patch_u16(&writer, 6, 1);
+
+    return wire_writer_finish(&writer);
+}
+
+// Helper: Encode SRV record RDATA (mDNS allows the target to be compressed)
+static void encode_srv_rdata(wire_writer_t *writer, const mdns_service_t *svc) {
+    uint8_t *fixed = wire_put_space(writer, 6);
+
+    if (fixed == NULL) {
+        return;
     }
-    *offset += target_len;
-    
-    return 0;
+    wire_write_u16(fixed, svc->priority);
+    wire_write_u16(fixed + 2, svc->weight);
+    wire_write_u16(fixed + 4, svc->port);
+    wire_put_name(writer, svc->target_host);
 }
 
 // Helper: Encode TXT record RDATA
-static int encode_txt_rdata(uint8_t *out, size_t out_len, size_t *offset,
-                             const mdns_service_t *svc) {
+static void encode_txt_rdata(wire_writer_t *writer, const mdns_service_t *svc) {
     // If no TXT records, write a single empty string (length 0)
     if (svc->txt_kv_count == 0 || svc->txt_kv == NULL) {
-        if (*offset + 1 > out_len) {
-            return -1;
-        }
-        out[(*offset)++] = 0;
-        return 0;
+        wire_put_u8(writer, 0);
+        return;
     }
-    
+
     // Write each TXT record as length-prefixed string
     for (size_t i = 0; i < svc->txt_kv_count; i++) {
         size_t txt_len = strlen(svc->txt_kv[i]);
         if (txt_len > 255) {
             txt_len = 255;  // Truncate if too long
         }
-        
-        if (*offset + 1 + txt_len > out_len) {
-            return -1;
-        }
-        
-        out[(*offset)++] = (uint8_t)txt_len;
-        memcpy(&out[*offset], svc->txt_kv[i], txt_len);
-        *offset += txt_len;
+
+        wire_put_u8(writer, (uint8_t)txt_len);
+        wire_put_bytes(writer, svc->txt_kv[i], txt_len);
     }
-    
-    return 0;
 }
 
 // Build service response with SRV + TXT records for each service
 int mdns_build_service_response(uint8_t *out, size_t out_len, const dns_question_t *question,
                                  mdns_service_t **services, size_t service_count) {
-    size_t qname_len;
-    size_t offset;
+    wire_writer_t writer;
     uint16_t answer_count = 0;
-    
-    if (out == NULL || question == NULL || out_len < 12) {
+
+    if (out == NULL || question == NULL) {
         return -1;
     }
-    
+
     if (service_count == 0 || services == NULL) {
         return 0;  // No services to return
     }
-    
-    // DNS header
-    memset(out, 0, out_len);
-    write_u16(&out[0], 0);  // ID
-    write_u16(&out[2], DNS_FLAG_QR_RESPONSE | DNS_FLAG_AA);
-    write_u16(&out[4], 1);  // QDCOUNT
-    
-    // Question section
-    offset = 12;
-    if (encode_qname(question->name, &out[offset], out_len - offset, &qname_len) != 0) {
-        return -1;
-    }
-    offset += qname_len;
-    
-    if (offset + 4 > out_len) {
+
+    // Owner names and SRV targets compress against each other
+    wire_writer_init(&writer, out, out_len, 1);
+    write_response_header(&writer);
+    if (writer.failed) {
         return -1;
     }
-    write_u16(&out[offset], question->qtype);
-    write_u16(&out[offset + 2], DNS_CLASS_IN);
-    offset += 4;
-    
-    // Answer section: SRV + TXT for each service
+
+    // Answer section: SRV + TXT for each service, stopping at the first
+    // pair that does not fit
     for (size_t i = 0; i < service_count; i++) {
         mdns_service_t *svc = services[i];
         char service_fqdn[512];
-        int rdlength_pos;
-        size_t rdata_start;
-        size_t rdata_len;
-        
+        wire_mark_t mark = wire_writer_mark(&writer);
+        size_t rdlength_pos;
+
         // Construct service FQDN
         int written = snprintf(service_fqdn, sizeof(service_fqdn), "%s.%s.%s",
                               svc->instance, svc->service_type, svc->domain);
         if (written < 0 || (size_t)written >= sizeof(service_fqdn)) {
             continue;  // Skip this service
         }
-        
-        // Write SRV record
-        rdlength_pos = write_answer_header(out, out_len, &offset, service_fqdn,
-                                           DNS_TYPE_SRV, svc->ttl);
-        if (rdlength_pos < 0) {
+
+        wire_begin_rr(&writer, service_fqdn, DNS_TYPE_SRV, DNS_CLASS_IN, svc->ttl, &rdlength_pos);
+        encode_srv_rdata(&writer, svc);
+        wire_end_rr(&writer, rdlength_pos);
+
+        wire_begin_rr(&writer, service_fqdn, DNS_TYPE_TXT, DNS_CLASS_IN, svc->ttl, &rdlength_pos);
+        encode_txt_rdata(&writer, svc);
+        if (wire_end_rr(&writer, rdlength_pos) != 0) {
+            wire_writer_rewind(&writer, mark);
             break;  // Out of space
         }
-        
-        rdata_start = offset;
-        if (encode_srv_rdata(out, out_len, &offset, svc) != 0) {
-            break;  // Out of space
+        answer_count += 2;
+    }
+
+    // Update ANCOUNT
+    wire_patch_u16(&writer, 6, answer_count);
+
+    return answer_count > 0 ? (int)writer.len : 0;
+}
+
+uint16_t mdns_packet_id(const uint8_t *packet, size_t packet_len) {
+    if (packet == NULL || packet_len < 2) {
+        return 0;
+    }
+    return wire_read_u16(packet);
+}
+
+// Helper: Add delta to the compression pointers of record_count records
+// starting at offset (owner names, and the names inside SRV, PTR and NSEC
+// rdata), after they have been moved delta bytes further into the packet
+static int shift_record_pointers(uint8_t *packet, size_t packet_len, size_t offset,
+                                 uint32_t record_count, size_t delta) {
+    wire_reader_t reader;
+
+    wire_reader_init(&reader, packet, packet_len);
+    reader.pos = offset;
+    for (uint32_t i = 0; i < record_count; i++) {
+        wire_rr_t rr;
+        int shifted;
+
+        if (wire_read_rr(&reader, &rr) != 0) {
+            return -1;
         }
-        
-        // Fill in RDLENGTH
-        rdata_len = offset - rdata_start;
-        write_u16(&out[rdlength_pos], (uint16_t)rdata_len);
-        answer_count++;
-        
-        // Write TXT record
-        rdlength_pos = write_answer_header(out, out_len, &offset, service_fqdn,
-                                           DNS_TYPE_TXT, svc->ttl);
-        if (rdlength_pos < 0) {
-            break;  // Out of space
+        shifted = wire_shift_name_pointer(packet, packet_len, rr.name_offset, delta);
+        if (shifted == 0 && rr.type == DNS_TYPE_SRV && rr.rdlen > 6) {
+            shifted = wire_shift_name_pointer(packet, rr.rdata_offset + rr.rdlen, rr.rdata_offset + 6, delta);
+        } else if (shifted == 0 && (rr.type == DNS_TYPE_PTR || rr.type == DNS_TYPE_NSEC) && rr.rdlen > 0) {
+            shifted = wire_shift_name_pointer(packet, rr.rdata_offset + rr.rdlen, rr.rdata_offset, delta);
         }
-        
-        rdata_start = offset;
-        if (encode_txt_rdata(out, out_len, &offset, svc) != 0) {
-            break;  // Out of space
+        if (shifted != 0) {
+            return -1;
         }
-        
-        // Fill in RDLENGTH
-        rdata_len = offset - rdata_start;
-        write_u16(&out[rdlength_pos], (uint16_t)rdata_len);
-        answer_count++;
     }
-    
-    // Update ANCOUNT
-    write_u16(&out[6], answer_count);
-    
-    return answer_count > 0 ? (int)offset : 0;
+    return 0;
+}
+
+int mdns_begin_response(uint8_t *out, size_t out_len) {
+    wire_writer_t writer;
+
+    if (out == NULL) {
+        return -1;
+    }
+    wire_writer_init(&writer, out, out_len, 0);
+    write_response_header(&writer);
+    return wire_writer_finish(&writer);
+}
+
+int mdns_append_answers(uint8_t *packet, size_t packet_len, size_t packet_cap,
+                        const uint8_t *records, size_t records_len, uint16_t record_count) {
+    uint16_t ancount;
+
+    if (packet == NULL || packet_len < WIRE_HEADER_LEN || (records_len > 0 && records == NULL) ||
+        records_len > packet_cap - packet_len) {
+        return -1;
+    }
+    ancount = wire_read_u16(&packet[6]);
+    if ((uint32_t)ancount + record_count > 0xFFFF) {
+        return -1;
+    }
+
+    // The records were built right after a header, so their pointers are
+    // off by how far past that they now start
+    memcpy(&packet[packet_len], records, records_len);
+    if (shift_record_pointers(packet, packet_len + records_len, packet_len, record_count,
+                              packet_len - WIRE_HEADER_LEN) != 0) {
+        return -1;
+    }
+    wire_write_u16(&packet[6], (uint16_t)(ancount + record_count));
+    return (int)(packet_len + records_len);
+}
+
+// Helper: Copy the rdata of a record, writing the names inside SRV, PTR and
+// NSEC rdata through the writer so they compress against its message
+static int copy_rdata(wire_writer_t *writer, const uint8_t *packet, const wire_rr_t *rr) {
+    char name[WIRE_NAME_TEXT_MAX];
+    size_t rdata_end = rr->rdata_offset + rr->rdlen;
+    size_t name_offset = rr->rdata_offset;
+    size_t name_end;
+
+    if (rr->type == DNS_TYPE_SRV) {
+        if (rr->rdlen < 7) {
+            return -1;
+        }
+        wire_put_bytes(writer, &packet[rr->rdata_offset], 6);
+        name_offset += 6;
+    } else if (rr->type != DNS_TYPE_PTR && rr->type != DNS_TYPE_NSEC) {
+        return wire_put_bytes(writer, &packet[rr->rdata_offset], rr->rdlen);
+    }
+
+    if (wire_decode_name(packet, rdata_end, name_offset, name, sizeof(name), &name_end) < 0) {
+        return -1;
+    }
+    wire_put_name(writer, name);
+    return wire_put_bytes(writer, &packet[name_end], rdata_end - name_end);
+}
+
+int mdns_filter_answers(const uint8_t *packet, size_t packet_len, uint8_t *out, size_t out_len,
+                        mdns_record_filter_fn keep, void *user) {
+    wire_reader_t reader;
+    wire_header_t header;
+    wire_writer_t writer;
+    uint16_t kept = 0;
+
+    if (packet == NULL || out == NULL || keep == NULL) {
+        return -1;
+    }
+
+    wire_reader_init(&reader, packet, packet_len);
+    if (wire_read_header(&reader, &header) != 0 || header.qdcount != 0) {
+        return -1;
+    }
+
+    wire_writer_init(&writer, out, out_len, 1);
+    write_response_header(&writer);
+    for (uint16_t i = 0; i < header.ancount; i++) {
+        char name[WIRE_NAME_TEXT_MAX];
+        size_t rdlength_pos;
+        wire_rr_t rr;
+
+        if (wire_read_rr(&reader, &rr) != 0 ||
+            wire_decode_name(packet, packet_len, rr.name_offset, name, sizeof(name), NULL) < 0) {
+            return -1;
+        }
+        if (!keep(user, name, rr.type)) {
+            continue;
+        }
+        wire_begin_rr(&writer, name, rr.type, rr.rrclass, rr.ttl, &rdlength_pos);
+        if (copy_rdata(&writer, packet, &rr) != 0 || wire_end_rr(&writer, rdlength_pos) != 0) {
+            return -1;
+        }
+        kept++;
+    }
+    wire_patch_u16(&writer, 6, kept);
+
+    return wire_writer_finish(&writer);
+}
+
+int mdns_prepare_legacy_unicast(uint8_t *packet, size_t packet_len, size_t packet_cap, uint16_t id,
+                                const dns_question_t *questions, size_t question_count, uint32_t max_ttl) {
+    uint8_t question_wire[MDNS_MAX_PACKET];
+    wire_writer_t writer;
+    wire_reader_t reader;
+    wire_header_t header;
+    uint32_t rr_total;
+    size_t question_len;
+
+    if (packet == NULL || (question_count > 0 && questions == NULL)) {
+        return -1;
+    }
+
+    wire_reader_init(&reader, packet, packet_len);
+    if (wire_read_header(&reader, &header) != 0 || header.qdcount != 0) {
+        return -1;
+    }
+
+    // Legacy resolvers match the answer to their query by ID and question
+    wire_writer_init(&writer, question_wire, sizeof(question_wire), 0);
+    for (size_t i = 0; i < question_count; i++) {
+        wire_put_question(&writer, questions[i].name, questions[i].qtype, DNS_CLASS_IN);
+    }
+    if (writer.failed || packet_len + writer.len > packet_cap) {
+        return -1;
+    }
+    question_len = writer.len;
+    rr_total = (uint32_t)header.ancount + header.nscount + header.arcount;
+
+    memmove(&packet[WIRE_HEADER_LEN + question_len], &packet[WIRE_HEADER_LEN], packet_len - WIRE_HEADER_LEN);
+    memcpy(&packet[WIRE_HEADER_LEN], question_wire, question_len);
+    packet_len += question_len;
+    if (shift_record_pointers(packet, packet_len, WIRE_HEADER_LEN + question_len, rr_total, question_len) != 0) {
+        return -1;
+    }
+    wire_write_u16(&packet[0], id);
+    wire_write_u16(&packet[4], (uint16_t)question_count);
+
+    wire_reader_init(&reader, packet, packet_len);
+    reader.pos = WIRE_HEADER_LEN + question_len;
+    for (uint32_t i = 0; i < rr_total; i++) {
+        wire_rr_t rr;
+        uint8_t *fixed;
+
+        if (wire_read_rr(&reader, &rr) != 0) {
+            return -1;
+        }
+        // Class and TTL sit 8 and 6 bytes before the rdata
+        fixed = &packet[rr.rdata_offset - 10];
+        wire_write_u16(&fixed[2], (uint16_t)(rr.rrclass & ~DNS_CLASS_CACHE_FLUSH));
+        if (rr.ttl > max_ttl) {
+            wire_write_u32(&fixed[4], max_ttl);
+        }
+    }
+
+    return (int)packet_len;
 }
@@ -0,0 +1,578 @@
+#include "wire.h"
+
+#include <string.h>
+
+int wire_encode_name(const char *name, uint8_t *out, size_t out_len, size_t *written_out) {
+    const char *cursor = name;
+    size_t written = 0;
+
+    while (*cursor != '\0') {
+        const char *dot = strchr(cursor, '.');
+        size_t label_len = dot ? (size_t)(dot - cursor) : strlen(cursor);
+
+        if (label_len == 0 || label_len > 63) {
+            return -1;
+        }
+        if (written + 1 + label_len >= out_len) {
+            return -1;
+        }
+
+        out[written++] = (uint8_t)label_len;
+        memcpy(&out[written], cursor, label_len);
+        written += label_len;
+
+        if (dot == NULL) {
+            break;
+        }
+        cursor = dot + 1;
+    }
+
+    if (written >= out_len) {
+        return -1;
+    }
+    out[written++] = 0;
+
+    *written_out = written;
+    return 0;
+}
+
+int wire_skip_name(const uint8_t *packet, size_t packet_len, size_t offset, size_t *next_offset) {
+    while (offset < packet_len) {
+        uint8_t len = packet[offset];
+
+        if ((len & 0xC0) == 0xC0) {
+            if (offset + 1 >= packet_len) {
+                return -1;
+            }
+            *next_offset = offset + 2;
+            return 0;
+        }
+        if ((len & 0xC0) != 0) {
+            return -1;
+        }
+        offset += (size_t)len + 1;
+        if (len == 0) {
+            *next_offset = offset;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int wire_shift_name_pointer(uint8_t *packet, size_t packet_len, size_t offset, size_t delta) {
+    while (offset < packet_len) {
+        uint8_t len = packet[offset];
+
+        if ((len & 0xC0) == 0xC0) {
+            size_t target;
+
+            if (offset + 1 >= packet_len) {
+                return -1;
+            }
+            target = (size_t)(wire_read_u16(&packet[offset]) & 0x3FFF) + delta;
+            if (target > 0x3FFF) {
+                return -1;
+            }
+            wire_write_u16(&packet[offset], (uint16_t)(0xC000 | target));
+            return 0;
+        }
+        if ((len & 0xC0) != 0) {
+            return -1;
+        }
+        if (len == 0) {
+            return 0;
+        }
+        offset += (size_t)len + 1;
+    }
+    return -1;
+}
+
+int wire_expand_name(const uint8_t *packet, size_t packet_len, size_t offset,
+                     uint8_t *out, size_t *written_out, size_t *next_offset) {
+    size_t pos = offset;
+    size_t written = 0;
+    size_t jumps = 0;
+    size_t next = 0;
+
+    for (;;) {
+        uint8_t len;
+
+        if (pos >= packet_len) {
+            return -1;
+        }
+        len = packet[pos];
+        if ((len & 0xC0) == 0xC0) {
+            size_t target;
+
+            if (pos + 1 >= packet_len || ++jumps > WIRE_MAX_JUMPS) {
+                return -1;
+            }
+            target = (size_t)(((len & 0x3F) << 8) | packet[pos + 1]);
+            if (target >= pos) {
+                return -1;
+            }
+            if (next == 0) {
+                next = pos + 2;
+            }
+            pos = target;
+            continue;
+        }
+        if ((len & 0xC0) != 0 || pos + 1 + len > packet_len || written + 1 + len > WIRE_NAME_MAX) {
+            return -1;
+        }
+        // The length octet goes separately so the copy below is known to
+        // be at most 63 bytes
+        out[written] = len;
+        if (len == 0) {
+            written++;
+            break;
+        }
+        memcpy(&out[written + 1], &packet[pos + 1], len);
+        written += (size_t)len + 1;
+        pos += (size_t)len + 1;
+    }
+
+    *written_out = written;
+    if (next_offset != NULL) {
+        *next_offset = next != 0 ? next : pos + 1;
+    }
+    return 0;
+}
+
+int wire_name_to_text(const uint8_t *wire, size_t wire_len, char *out, size_t out_len) {
+    size_t copied;
+
+    if (wire_len == 0 || wire[0] > 63 || out_len < 2) {
+        return -1;
+    }
+    if (wire[0] == 0) {
+        out[0] = '.';
+        out[1] = '\0';
+        return 0;
+    }
+
+    // Label bytes shift down by one; each later length octet becomes a dot
+    // and the root label's 0 terminates the string. Checking the lengths on
+    // the way saves a separate validation pass.
+    copied = wire_len - 1 < out_len ? wire_len - 1 : out_len;
+    memcpy(out, wire + 1, copied);
+    for (size_t pos = wire[0]; pos < copied; ) {
+        uint8_t len = (uint8_t)out[pos];
+
+        if (len == 0) {
+            return 0;
+        }
+        if (len > 63) {
+            return -1;
+        }
+        out[pos] = '.';
+        pos += (size_t)len + 1;
+    }
+    return -1;
+}
+
+int wire_decode_name(const uint8_t *packet, size_t packet_len, size_t offset,
+                     char *out, size_t out_len, size_t *next_offset) {
+    size_t pos = offset;
+    size_t text_len = 0;
+    size_t jumps = 0;
+    size_t next = 0;
+
+    // One pass straight into text: each label is followed by a dot, and the
+    // last dot becomes the terminator
+    for (;;) {
+        uint8_t len;
+
+        if (pos >= packet_len) {
+            return -1;
+        }
+        len = packet[pos];
+        if ((len & 0xC0) == 0xC0) {
+            size_t target;
+
+            if (pos + 1 >= packet_len || ++jumps > WIRE_MAX_JUMPS) {
+                return -1;
+            }
+            target = (size_t)(((len & 0x3F) << 8) | packet[pos + 1]);
+            if (target >= pos) {
+                return -1;
+            }
+            if (next == 0) {
+                next = pos + 2;
+            }
+            pos = target;
+            continue;
+        }
+        if ((len & 0xC0) != 0 || pos + 1 + len > packet_len) {
+            return -1;
+        }
+        if (len == 0) {
+            break;
+        }
+        // text_len + 1 is the wire length so far
+        if (text_len + len + 1 >= out_len || text_len + len + 2 > WIRE_NAME_MAX) {
+            return -1;
+        }
+        memcpy(&out[text_len], &packet[pos + 1], len);
+        text_len += len;
+        out[text_len++] = '.';
+        pos += (size_t)len + 1;
+    }
+
+    if (next_offset != NULL) {
+        *next_offset = next != 0 ? next : pos + 1;
+    }
+    if (text_len == 0) {
+        if (out_len < 2) {
+            return -1;
+        }
+        out[0] = '.';
+        out[1] = '\0';
+        return 1;
+    }
+    out[--text_len] = '\0';
+    return (int)text_len;
+}
+
+// DNS names compare case-insensitively in ASCII only
+static inline uint8_t fold(uint8_t c) {
+    return (uint8_t)(c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c);
+}
+
+// Length octets are below 64, so folding ASCII letters never changes them
+int wire_names_equal(const uint8_t *a, size_t a_len, const uint8_t *b, size_t b_len) {
+    if (a_len != b_len) {
+        return 0;
+    }
+    for (size_t i = 0; i < a_len; i++) {
+        if (a[i] != b[i] && fold(a[i]) != fold(b[i])) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int wire_read_header(wire_reader_t *reader, wire_header_t *header) {
+    const uint8_t *ptr = reader->data;
+
+    if (reader->pos != 0 || reader->len < WIRE_HEADER_LEN) {
+        return -1;
+    }
+    header->id = wire_read_u16(ptr);
+    header->flags = wire_read_u16(ptr + 2);
+    header->qdcount = wire_read_u16(ptr + 4);
+    header->ancount = wire_read_u16(ptr + 6);
+    header->nscount = wire_read_u16(ptr + 8);
+    header->arcount = wire_read_u16(ptr + 10);
+    reader->pos = WIRE_HEADER_LEN;
+    return 0;
+}
+
+int wire_read_question(wire_reader_t *reader, size_t *name_offset, uint16_t *qtype, uint16_t *qclass) {
+    size_t pos;
+
+    if (wire_skip_name(reader->data, reader->len, reader->pos, &pos) != 0 || pos + 4 > reader->len) {
+        return -1;
+    }
+    *name_offset = reader->pos;
+    *qtype = wire_read_u16(&reader->data[pos]);
+    *qclass = wire_read_u16(&reader->data[pos + 2]);
+    reader->pos = pos + 4;
+    return 0;
+}
+
+int wire_read_rr(wire_reader_t *reader, wire_rr_t *rr) {
+    const uint8_t *data = reader->data;
+    size_t pos;
+    uint16_t rdlen;
+
+    if (wire_skip_name(data, reader->len, reader->pos, &pos) != 0 || pos + 10 > reader->len) {
+        return -1;
+    }
+    rdlen = wire_read_u16(&data[pos + 8]);
+    if (pos + 10 + rdlen > reader->len) {
+        return -1;
+    }
+    rr->name_offset = reader->pos;
+    rr->type = wire_read_u16(&data[pos]);
+    rr->rrclass = wire_read_u16(&data[pos + 2]);
+    rr->ttl = wire_read_u32(&data[pos + 4]);
+    rr->rdlen = rdlen;
+    rr->rdata_offset = pos + 10;
+    reader->pos = pos + 10 + rdlen;
+    return 0;
+}
+
+void wire_writer_init(wire_writer_t *writer, uint8_t *data, size_t cap, int compress) {
+    writer->data = data;
+    writer->cap = cap;
+    writer->len = 0;
+    writer->failed = 0;
+    writer->compress = compress;
+    writer->name_count = 0;
+}
+
+uint8_t *wire_put_space(wire_writer_t *writer, size_t len) {
+    uint8_t *space;
+
+    if (writer->failed || len > writer->cap - writer->len) {
+        writer->failed = 1;
+        return NULL;
+    }
+    space = &writer->data[writer->len];
+    writer->len += len;
+    return space;
+}
+
+int wire_put_u8(wire_writer_t *writer, uint8_t value) {
+    uint8_t *space = wire_put_space(writer, 1);
+
+    if (space == NULL) {
+        return -1;
+    }
+    space[0] = value;
+    return 0;
+}
+
+int wire_put_u16(wire_writer_t *writer, uint16_t value) {
+    uint8_t *space = wire_put_space(writer, 2);
+
+    if (space == NULL) {
+        return -1;
+    }
+    wire_write_u16(space, value);
+    return 0;
+}
+
+int wire_put_u32(wire_writer_t *writer, uint32_t value) {
+    uint8_t *space = wire_put_space(writer, 4);
+
+    if (space == NULL) {
+        return -1;
+    }
+    wire_write_u32(space, value);
+    return 0;
+}
+
+int wire_put_bytes(wire_writer_t *writer, const void *data, size_t len) {
+    uint8_t *space = wire_put_space(writer, len);
+
+    if (space == NULL) {
+        return -1;
+    }
+    memcpy(space, data, len);
+    return 0;
+}
+
+// Does the name at pos in the message (our own output, so every pointer is
+// valid and points backwards) equal the uncompressed name?
+static int written_name_equals(const uint8_t *data, size_t pos, const uint8_t *wire) {
+    for (;;) {
+        uint8_t len = data[pos];
+
+        if ((len & 0xC0) == 0xC0) {
+            pos = (size_t)(((len & 0x3F) << 8) | data[pos + 1]);
+            continue;
+        }
+        if (len != wire[0]) {
+            return 0;
+        }
+        if (len == 0) {
+            return 1;
+        }
+        // Names nearly always repeat with the same case
+        if (memcmp(&data[pos + 1], &wire[1], len) != 0) {
+            for (size_t i = 1; i <= len; i++) {
+                if (fold(data[pos + i]) != fold(wire[i])) {
+                    return 0;
+                }
+            }
+        }
+        pos += (size_t)len + 1;
+        wire += len + 1;
+    }
+}
+
+int wire_put_name(wire_writer_t *writer, const char *name) {
+    uint8_t *wire;
+    size_t wire_len;
+
+    if (writer->failed) {
+        return -1;
+    }
+    // Encode in place, then replace the longest suffix already in the
+    // message with a pointer to it
+    wire = &writer->data[writer->len];
+    if (wire_encode_name(name, wire, writer->cap - writer->len, &wire_len) != 0) {
+        writer->failed = 1;
+        return -1;
+    }
+    if (!writer->compress) {
+        writer->len += wire_len;
+        return 0;
+    }
+
+    for (size_t pos = 0; wire[pos] != 0; pos += (size_t)wire[pos] + 1) {
+        for (size_t i = 0; i < writer->name_count; i++) {
+            size_t target = writer->names[i];
+
+            if (writer->data[target] == wire[pos] && written_name_equals(writer->data, target, &wire[pos])) {
+                // A suffix has at least one label, so the pointer fits in its place
+                wire_write_u16(&wire[pos], (uint16_t)(0xC000 | target));
+                writer->len += pos + 2;
+                return 0;
+            }
+        }
+        if (writer->name_count < WIRE_COMPRESS_MAX && writer->len + pos <= 0x3FFF) {
+            writer->names[writer->name_count++] = (uint16_t)(writer->len + pos);
+        }
+    }
+    writer->len += wire_len;
+    return 0;
+}
+
+int wire_put_header(wire_writer_t *writer, uint16_t id, uint16_t flags) {
+    uint8_t *space = wire_put_space(writer, WIRE_HEADER_LEN);
+
+    if (space == NULL) {
+        return -1;
+    }
+    wire_write_u16(space, id);
+    wire_write_u16(space + 2, flags);
+    memset(space + 4, 0, WIRE_HEADER_LEN - 4);
+    return 0;
+}
+
+int wire_put_question(wire_writer_t *writer, const char *name, uint16_t qtype, uint16_t qclass) {
+    uint8_t *space;
+
+    wire_put_name(writer, name);
+    space = wire_put_space(writer, 4);
+    if (space == NULL) {
+        return -1;
+    }
+    wire_write_u16(space, qtype);
+    wire_write_u16(space + 2, qclass);
+    return 0;
+}
+
+int wire_begin_rr(wire_writer_t *writer, const char *name, uint16_t type, uint16_t rrclass,
+                  uint32_t ttl, size_t *rdlen_pos) {
+    uint8_t *space;
+
+    wire_put_name(writer, name);
+    space = wire_put_space(writer, 10);
+    if (space == NULL) {
+        return -1;
+    }
+    wire_write_u16(space, type);
+    wire_write_u16(space + 2, rrclass);
+    wire_write_u32(space + 4, ttl);
+    wire_write_u16(space + 8, 0);
+    *rdlen_pos = writer->len - 2;
+    return 0;
+}
+
+int wire_end_rr(wire_writer_t *writer, size_t rdlen_pos) {
+    if (writer->failed) {
+        return -1;
+    }
+    wire_patch_u16(writer, rdlen_pos, (uint16_t)(writer->len - rdlen_pos - 2));
+    return 0;
+}
+
+int wire_name_decoder_reset(wire_name_decoder_t *decoder, const uint8_t *packet, size_t packet_len) {
+    if (packet_len > WIRE_DECODER_MAX_PACKET) {
+        return -1;
+    }
+    decoder->packet = packet;
+    decoder->packet_len = packet_len;
+    decoder->arena_used = 0;
+    // Generation 0 marks entries never written
+    if (++decoder->generation == 0) {
+        memset(decoder->memo, 0, sizeof(decoder->memo));
+        decoder->generation = 1;
+    }
+    return 0;
+}
+
+int wire_name_decoder_expand(wire_name_decoder_t *decoder, size_t offset, uint8_t *out, size_t *written_out) {
+    // Locals, since stores through out could otherwise alias the decoder
+    const uint8_t *packet = decoder->packet;
+    const size_t packet_len = decoder->packet_len;
+    const uint32_t generation = decoder->generation;
+    const wire_name_memo_t *memos = decoder->memo;
+    size_t starts[WIRE_NAME_MAX / 2 + 1];   // packet offset of each label copied
+    size_t first_pos = 0;                   // where the first of them went in out
+    size_t labels = 0;
+    size_t written = 0;
+    size_t jumps = 0;
+    size_t pos = offset;
+
+    for (;;) {
+        uint8_t len;
+
+        if (pos >= packet_len) {
+            return -1;
+        }
+        if (memos[pos].generation == generation) {
+            size_t memo_len = memos[pos].len;
+            if (written + memo_len > WIRE_NAME_MAX) {
+                return -1;
+            }
+            memcpy(&out[written], &decoder->arena[memos[pos].arena_pos], memo_len);
+            written += memo_len;
+            break;
+        }
+
+        len = packet[pos];
+        if ((len & 0xC0) == 0xC0) {
+            size_t target;
+
+            if (pos + 1 >= packet_len || ++jumps > WIRE_MAX_JUMPS) {
+                return -1;
+            }
+            target = (size_t)(((len & 0x3F) << 8) | packet[pos + 1]);
+            if (target >= pos) {
+                return -1;
+            }
+            pos = target;
+            continue;
+        }
+        if ((len & 0xC0) != 0 || pos + 1 + len > packet_len || written + 1 + len > WIRE_NAME_MAX) {
+            return -1;
+        }
+        out[written] = len;
+        if (len == 0) {
+            written++;
+            break;
+        }
+        if (labels == 0) {
+            first_pos = written;
+        }
+        starts[labels++] = pos;
+        memcpy(&out[written + 1], &packet[pos + 1], len);
+        written += (size_t)len + 1;
+        pos += (size_t)len + 1;
+    }
+
+    // Every copied label starts a suffix of the first one's, so one arena
+    // copy serves all of them
+    if (labels > 0 && decoder->arena_used + (written - first_pos) <= WIRE_DECODER_ARENA) {
+        size_t base = decoder->arena_used;
+        size_t label_pos = first_pos;
+
+        memcpy(&decoder->arena[base], &out[first_pos], written - first_pos);
+        decoder->arena_used += written - first_pos;
+        for (size_t i = 0; i < labels; i++) {
+            wire_name_memo_t *memo = &decoder->memo[starts[i]];
+            memo->generation = generation;
+            memo->arena_pos = (uint16_t)(base + (label_pos - first_pos));
+            memo->len = (uint16_t)(written - label_pos);
+            label_pos += (size_t)out[label_pos] + 1;
+        }
+    }
+
+    *written_out = written;
+    return 0;
+}
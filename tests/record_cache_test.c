@@ -0,0 +1,127 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "record_cache.h"
+
+// Checks for the record cache's RFC 6762 cache-flush handling. Exits nonzero
+// on the first failure.
+
+#define CHECK(cond)                                                                 \
+    do {                                                                            \
+        if (!(cond)) {                                                              \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            return 1;                                                               \
+        }                                                                           \
+    } while (0)
+
+#define TYPE_A 1
+
+typedef struct {
+    int added;
+    int changed;
+    int removed;
+} event_counts_t;
+
+static void count_event(void *user, record_event_t event, const cached_record_t *record,
+                        const cached_record_t *previous) {
+    event_counts_t *counts = user;
+
+    (void)record;
+    (void)previous;
+    switch (event) {
+        case RECORD_ADDED:
+            counts->added++;
+            break;
+        case RECORD_CHANGED:
+            counts->changed++;
+            break;
+        case RECORD_REMOVED:
+            counts->removed++;
+            break;
+        case RECORD_REFRESH:
+            break;
+    }
+}
+
+static int has_address(const record_cache_t *cache, const uint8_t *address) {
+    const cached_record_t *found[4];
+    size_t count = record_cache_lookup(cache, "host.local", TYPE_A, found, 4);
+
+    for (size_t i = 0; i < count; i++) {
+        if (found[i]->rdlen == 4 && memcmp(found[i]->rdata, address, 4) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// {A1, A2} cached; A1 announced again with cache-flush 2 s later must drop A2
+static int test_flush_on_renewal(void) {
+    static const uint8_t a1[4] = {192, 0, 2, 1};
+    static const uint8_t a2[4] = {192, 0, 2, 2};
+    event_counts_t counts = {0, 0, 0};
+    record_cache_t *cache = record_cache_create(count_event, &counts, 0);
+
+    CHECK(cache != NULL);
+    CHECK(record_cache_update(cache, "host.local", TYPE_A, 0, a1, 4, 120, 0) == 0);
+    CHECK(record_cache_update(cache, "host.local", TYPE_A, 0, a2, 4, 120, 0) == 0);
+    CHECK(record_cache_count(cache) == 2);
+
+    CHECK(record_cache_update(cache, "host.local", TYPE_A, 1, a1, 4, 120, 2000) == 0);
+    CHECK(record_cache_count(cache) == 1);
+    CHECK(has_address(cache, a1));
+    CHECK(!has_address(cache, a2));
+    CHECK(counts.added == 2 && counts.changed == 0 && counts.removed == 1);
+
+    record_cache_destroy(cache);
+    return 0;
+}
+
+// Records of one announcement (within a second) must not flush each other
+static int test_no_flush_within_one_second(void) {
+    static const uint8_t a1[4] = {192, 0, 2, 1};
+    static const uint8_t a2[4] = {192, 0, 2, 2};
+    event_counts_t counts = {0, 0, 0};
+    record_cache_t *cache = record_cache_create(count_event, &counts, 0);
+
+    CHECK(cache != NULL);
+    CHECK(record_cache_update(cache, "host.local", TYPE_A, 1, a1, 4, 120, 0) == 0);
+    CHECK(record_cache_update(cache, "host.local", TYPE_A, 1, a2, 4, 120, 500) == 0);
+    CHECK(record_cache_update(cache, "host.local", TYPE_A, 1, a1, 4, 120, 900) == 0);
+    CHECK(record_cache_count(cache) == 2);
+    CHECK(counts.removed == 0);
+
+    record_cache_destroy(cache);
+    return 0;
+}
+
+// New rdata with cache-flush replaces the old: one CHANGED event
+static int test_flush_on_new_rdata(void) {
+    static const uint8_t a1[4] = {192, 0, 2, 1};
+    static const uint8_t a2[4] = {192, 0, 2, 2};
+    event_counts_t counts = {0, 0, 0};
+    record_cache_t *cache = record_cache_create(count_event, &counts, 0);
+
+    CHECK(cache != NULL);
+    CHECK(record_cache_update(cache, "host.local", TYPE_A, 1, a1, 4, 120, 0) == 0);
+    CHECK(record_cache_update(cache, "HOST.local", TYPE_A, 1, a2, 4, 120, 2000) == 0);
+    CHECK(record_cache_count(cache) == 1);
+    CHECK(has_address(cache, a2));
+    CHECK(counts.added == 1 && counts.changed == 1 && counts.removed == 0);
+
+    record_cache_destroy(cache);
+    return 0;
+}
+
+int main(void) {
+    int failed = 0;
+
+    failed |= test_flush_on_renewal();
+    failed |= test_no_flush_within_one_second();
+    failed |= test_flush_on_new_rdata();
+    if (failed) {
+        return 1;
+    }
+    printf("record_cache_test: ok\n");
+    return 0;
+}
@@ -0,0 +1,75 @@
+#include <getopt.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "args.h"
+
+// Checks for mdns_server's option parsing: every option must keep its value
+// whichever options follow it. Exits nonzero on the first failure.
+
+#define CHECK(cond)                                                                 \
+    do {                                                                            \
+        if (!(cond)) {                                                              \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            return 1;                                                               \
+        }                                                                           \
+    } while (0)
+
+#define ARG_COUNT(args) ((int)(sizeof(args) / sizeof((args)[0])))
+
+// getopt keeps its position between calls
+static int parse(int argc, char **argv, app_config_t *cfg) {
+    optind = 1;
+    return parse_args(argc, argv, cfg);
+}
+
+// -a and -m before -b select must survive it
+static int test_backend_keeps_other_options(void) {
+    char *argv[] = {"mdns_server", "-i", "lo", "-a", "-m", "/tmp/m.prom", "-b", "select", "-n"};
+    app_config_t cfg;
+
+    CHECK(parse(ARG_COUNT(argv), argv, &cfg) == 0);
+    CHECK(cfg.io_backend == IO_BACKEND_SELECT);
+    CHECK(cfg.async_log == 1);
+    CHECK(cfg.metrics_path != NULL && strcmp(cfg.metrics_path, "/tmp/m.prom") == 0);
+    CHECK(cfg.rate_limit == 0);
+    return 0;
+}
+
+// The same options in the other order give the same result
+static int test_backend_first(void) {
+    char *argv[] = {"mdns_server", "-b", "io_uring", "-a", "-m", "/tmp/m.prom", "-i", "lo"};
+    app_config_t cfg;
+
+    CHECK(parse(ARG_COUNT(argv), argv, &cfg) == 0);
+    CHECK(cfg.io_backend == IO_BACKEND_URING);
+    CHECK(cfg.async_log == 1);
+    CHECK(cfg.metrics_path != NULL && strcmp(cfg.metrics_path, "/tmp/m.prom") == 0);
+    CHECK(cfg.rate_limit == 1);
+    return 0;
+}
+
+static int test_defaults(void) {
+    char *argv[] = {"mdns_server", "-i", "lo"};
+    app_config_t cfg;
+
+    CHECK(parse(ARG_COUNT(argv), argv, &cfg) == 0);
+    CHECK(cfg.io_backend == IO_BACKEND_SELECT);
+    CHECK(cfg.async_log == 0);
+    CHECK(cfg.metrics_path == NULL);
+    CHECK(cfg.rate_limit == 1);
+    return 0;
+}
+
+int main(void) {
+    int failed = 0;
+
+    failed |= test_backend_keeps_other_options();
+    failed |= test_backend_first();
+    failed |= test_defaults();
+    if (failed) {
+        return 1;
+    }
+    printf("server_args_test: ok\n");
+    return 0;
+}